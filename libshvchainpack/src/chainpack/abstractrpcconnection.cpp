@@ -1,9 +1,20 @@
 #include "abstractrpcconnection.h"
 #include "exception.h"
 
+#include <atomic>
+
 namespace shv {
 namespace chainpack {
 
+AbstractRpcConnection::AbstractRpcConnection()
+	: m_callHandle(std::make_shared<AbstractRpcConnection*>(this))
+{
+}
+
+AbstractRpcConnection::~AbstractRpcConnection()
+{
+}
+
 void AbstractRpcConnection::sendNotify(std::string method, const RpcValue &params)
 {
 	sendShvNotify(std::string(), std::move(method), params);
@@ -35,9 +46,9 @@ void AbstractRpcConnection::sendError(const RpcValue &request_id, const RpcRespo
 	sendMessage(resp);
 }
 
-static unsigned next_rqid()
+unsigned AbstractRpcConnection::nextRequestId()
 {
-	static unsigned n = 0;
+	static std::atomic<unsigned> n(0);
 	return ++n;
 }
 
@@ -48,7 +59,7 @@ unsigned AbstractRpcConnection::callMethod(std::string method, const RpcValue &p
 
 unsigned AbstractRpcConnection::callShvMethod(const std::string &shv_path, std::string method, const RpcValue &params)
 {
-	unsigned id = next_rqid();
+	unsigned id = nextRequestId();
 	RpcRequest rq;
 	rq.setRequestId(id);
 	rq.setMethod(std::move(method));
@@ -67,7 +78,7 @@ RpcResponse AbstractRpcConnection::callMethodSync(const std::string &method, con
 RpcResponse AbstractRpcConnection::callShvMethodSync(const std::string &shv_path, const std::string &method, const RpcValue &params, int rpc_timeout)
 {
 	RpcRequest rq;
-	rq.setRequestId(next_rqid());
+	rq.setRequestId(nextRequestId());
 	rq.setMethod(method);
 	rq.setParams(params);
 	if(!shv_path.empty())
@@ -80,6 +91,34 @@ RpcResponse AbstractRpcConnection::callShvMethodSync(const std::string &shv_path
 	return RpcResponse(ret);
 }
 
+unsigned AbstractRpcConnection::callMethodAsync(std::string method, const RpcValue &params, ResponseCallback &&callback, int rpc_timeout)
+{
+	return callShvMethodAsync(std::string(), std::move(method), params, std::move(callback), rpc_timeout);
+}
+
+unsigned AbstractRpcConnection::callShvMethodAsync(const std::string &shv_path, std::string method, const RpcValue &params, ResponseCallback &&callback, int rpc_timeout)
+{
+	unsigned id = nextRequestId();
+	RpcRequest rq;
+	rq.setRequestId(id);
+	rq.setMethod(std::move(method));
+	rq.setParams(params);
+	if(!shv_path.empty())
+		rq.setShvPath(shv_path);
+	sendMessageAsync(rq, std::move(callback), rpc_timeout);
+	return id;
+}
+
+std::shared_ptr<RpcBatchCall> AbstractRpcConnection::callShvMethodsAsync(std::vector<RpcBatchCall::Request> &&requests, RpcBatchCall::FinishedCallback &&callback, size_t max_in_flight, int rpc_timeout)
+{
+	std::shared_ptr<RpcBatchCall> batch = RpcBatchCall::create(this, std::move(requests));
+	batch->setMaxInFlight(max_in_flight);
+	batch->setTimeout(rpc_timeout);
+	batch->setFinishedCallback(std::move(callback));
+	batch->start();
+	return batch;
+}
+
 static int s_defaultRpcTimeout = 5000;
 
 int AbstractRpcConnection::defaultRpcTimeout()
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "rpcmessage.h"
+#include "rpccall.h"
+#include "rpcbatchcall.h"
+
+#include <functional>
+#include <memory>
 
 namespace shv {
 namespace chainpack {
@@ -13,6 +18,11 @@ public:
 
 	static constexpr int DEFAULT_RPC_BROKER_PORT = 3755;
 public:
+	AbstractRpcConnection();
+	AbstractRpcConnection(const AbstractRpcConnection &) = delete;
+	AbstractRpcConnection& operator=(const AbstractRpcConnection &) = delete;
+	virtual ~AbstractRpcConnection();
+
 	virtual void close() = 0;
 	virtual void abort() = 0;
 
@@ -20,6 +30,12 @@ public:
 	virtual RpcResponse sendMessageSync(const shv::chainpack::RpcRequest &rpc_request, int time_out_ms = DEFAULT_RPC_TIMEOUT) = 0;
 	virtual void onRpcMessageReceived(const shv::chainpack::RpcMessage &msg) = 0;
 
+	using ResponseCallback = std::function<void (const RpcResponse &response)>;
+	/// send request without blocking, callback is called exactly once in connection thread,
+	/// with response or with error on timeout, disconnection or cancelMessageAsync()
+	virtual void sendMessageAsync(const shv::chainpack::RpcRequest &rpc_request, ResponseCallback &&callback, int time_out_ms = DEFAULT_RPC_TIMEOUT) = 0;
+	virtual void cancelMessageAsync(unsigned request_id) = 0;
+
 	void sendNotify(std::string method, const shv::chainpack::RpcValue &params = shv::chainpack::RpcValue());
 	void sendShvNotify(const std::string &shv_path, std::string method, const shv::chainpack::RpcValue &params = shv::chainpack::RpcValue());
 	void sendResponse(const shv::chainpack::RpcValue &request_id, const shv::chainpack::RpcValue &result);
@@ -28,9 +44,35 @@ public:
 	unsigned callShvMethod(const std::string &shv_path, std::string method, const shv::chainpack::RpcValue &params = shv::chainpack::RpcValue());
 	RpcResponse callMethodSync(const std::string &method, const shv::chainpack::RpcValue &params = shv::chainpack::RpcValue(), int rpc_timeout = DEFAULT_RPC_TIMEOUT);
 	RpcResponse callShvMethodSync(const std::string &shv_path, const std::string &method, const shv::chainpack::RpcValue &params = shv::chainpack::RpcValue(), int rpc_timeout = DEFAULT_RPC_TIMEOUT);
+	unsigned callMethodAsync(std::string method, const shv::chainpack::RpcValue &params, ResponseCallback &&callback, int rpc_timeout = DEFAULT_RPC_TIMEOUT);
+	unsigned callShvMethodAsync(const std::string &shv_path, std::string method, const shv::chainpack::RpcValue &params, ResponseCallback &&callback, int rpc_timeout = DEFAULT_RPC_TIMEOUT);
+	/// pipelined calls of all the requests, callback is called when all of them are finished
+	std::shared_ptr<RpcBatchCall> callShvMethodsAsync(std::vector<RpcBatchCall::Request> &&requests, RpcBatchCall::FinishedCallback &&callback
+													   , size_t max_in_flight = RpcBatchCall::DEFAULT_MAX_IN_FLIGHT, int rpc_timeout = DEFAULT_RPC_TIMEOUT);
+#ifdef SHVCHAINPACK_HAS_COROUTINES
+	/// co_await conn.call(shv_path, method, params)
+	/// RpcCall can outlive the connection, it must be destroyed in the connection thread then
+	RpcCall call(const std::string &shv_path, std::string method, const shv::chainpack::RpcValue &params = shv::chainpack::RpcValue(), int rpc_timeout = DEFAULT_RPC_TIMEOUT)
+	{
+		std::weak_ptr<AbstractRpcConnection*> connection = m_callHandle;
+		return RpcCall([&](ResponseCallback &&callback) {
+			return callShvMethodAsync(shv_path, std::move(method), params, std::move(callback), rpc_timeout);
+		}, [connection](unsigned request_id) {
+			if(std::shared_ptr<AbstractRpcConnection*> conn = connection.lock())
+				(*conn)->cancelMessageAsync(request_id);
+		});
+	}
+#endif
 
+	static unsigned nextRequestId();
 	static int defaultRpcTimeout();
 	static int setDefaultRpcTimeout(int rpc_timeout);
+protected:
+	/// RpcCall-s returned by call() do not cancel requests through connection anymore,
+	/// subclass destructor should call it first, cancelMessageAsync() must not be called on partly destroyed connection
+	void releaseCallHandle() {m_callHandle.reset();}
+private:
+	std::shared_ptr<AbstractRpcConnection*> m_callHandle;
 };
 
 } // namespace chainpack
@@ -10,12 +10,20 @@ SOURCES += \
     $$PWD/abstractstreamwriter.cpp \
     $$PWD/cponwriter.cpp \
     $$PWD/cponreader.cpp \
+    $$PWD/cponbufferreader.cpp \
+    $$PWD/jsonrpctranscoder.cpp \
+    $$PWD/datatranscoder.cpp \
+    $$PWD/encodedmessage.cpp \
     $$PWD/chainpackwriter.cpp \
     $$PWD/cpon.cpp \
     $$PWD/chainpack.cpp \
     $$PWD/chainpackreader.cpp \
     $$PWD/abstractrpcconnection.cpp \
-    $$PWD/metamethod.cpp
+    $$PWD/metamethod.cpp \
+    $$PWD/timerwheel.cpp \
+    $$PWD/rpcbatchcall.cpp \
+    $$PWD/pendingrpcrequests.cpp \
+    $$PWD/rpcmetrics.cpp
 
 HEADERS += \
     $$PWD/rpc.h \
@@ -23,18 +31,30 @@ HEADERS += \
     $$PWD/rpcvalue.h \
     $$PWD/rpcdriver.h \
     $$PWD/metatypes.h \
+    $$PWD/metastruct.h \
     $$PWD/exception.h \
     $$PWD/utils.h \
     $$PWD/abstractstreamreader.h \
     $$PWD/abstractstreamwriter.h \
     $$PWD/cponwriter.h \
     $$PWD/cponreader.h \
+    $$PWD/cponbufferreader.h \
+    $$PWD/jsonrpctranscoder.h \
+    $$PWD/datatranscoder.h \
+    $$PWD/encodedmessage.h \
     $$PWD/chainpackwriter.h \
     $$PWD/cpon.h \
     $$PWD/chainpack.h \
     $$PWD/chainpackreader.h \
     $$PWD/abstractrpcconnection.h \
-    $$PWD/metamethod.h
+    $$PWD/metamethod.h \
+    $$PWD/timerwheel.h \
+    $$PWD/pendingrpcrequests.h \
+    $$PWD/rpccall.h \
+    $$PWD/rpcbatchcall.h \
+    $$PWD/rpcmetrics.h \
+    $$PWD/rpclog.h \
+    $$PWD/stringoutbuf.h
 
 unix {
 SOURCES += \
@@ -199,6 +199,131 @@ uint64_t ChainPackReader::readUIntData(std::istream &data, bool *ok)
 	return ret;
 }
 
+uint8_t ChainPackReader::getByte()
+{
+	int b = m_in.get();
+	if(b < 0)
+		SHVCHP_EXCEPTION("Unexpected EOF!");
+	return static_cast<uint8_t>(b);
+}
+
+uint64_t ChainPackReader::readUInt()
+{
+	uint8_t type = getByte();
+	if(type < 128) {
+		// tiny UInt or tiny Int, both are not negative
+		return type & 63;
+	}
+	if(type == ChainPack::TypeInfo::UInt)
+		return readData_UInt<uint64_t>(m_in);
+	if(type == ChainPack::TypeInfo::Int) {
+		int64_t n = readData_Int<int64_t>(m_in);
+		if(n >= 0)
+			return static_cast<uint64_t>(n);
+	}
+	SHVCHP_EXCEPTION("UInt expected, type info: " + Utils::toString((int)type));
+}
+
+int64_t ChainPackReader::readInt()
+{
+	uint8_t type = getByte();
+	if(type < 128)
+		return type & 63;
+	if(type == ChainPack::TypeInfo::Int)
+		return readData_Int<int64_t>(m_in);
+	if(type == ChainPack::TypeInfo::UInt)
+		return static_cast<int64_t>(readData_UInt<uint64_t>(m_in));
+	SHVCHP_EXCEPTION("Int expected, type info: " + Utils::toString((int)type));
+}
+
+bool ChainPackReader::readBool()
+{
+	uint8_t type = getByte();
+	if(type == ChainPack::TypeInfo::TRUE)
+		return true;
+	if(type == ChainPack::TypeInfo::FALSE)
+		return false;
+	if(type == ChainPack::TypeInfo::Bool)
+		return getByte() != 0;
+	SHVCHP_EXCEPTION("Bool expected, type info: " + Utils::toString((int)type));
+}
+
+std::string ChainPackReader::readString()
+{
+	uint8_t type = getByte();
+	if(type != ChainPack::TypeInfo::String)
+		SHVCHP_EXCEPTION("String expected, type info: " + Utils::toString((int)type));
+	size_t len = readData_UInt<size_t>(m_in);
+	std::string ret(len, '\0');
+	if(len > 0 && !m_in.read(&ret[0], static_cast<std::streamsize>(len)))
+		SHVCHP_EXCEPTION("Unexpected EOF!");
+	return ret;
+}
+
+void ChainPackReader::readUIntArray(std::vector<RpcValue::UInt> &array)
+{
+	array.clear();
+	if(m_in.peek() != (ChainPack::TypeInfo::UInt | ChainPack::ARRAY_FLAG_MASK)) {
+		array.push_back(static_cast<RpcValue::UInt>(readUInt()));
+		return;
+	}
+	m_in.get();
+	size_t size = readData_UInt<size_t>(m_in);
+	array.reserve(size);
+	for (size_t i = 0; i < size; ++i)
+		array.push_back(readData_UInt<RpcValue::UInt>(m_in));
+}
+
+bool ChainPackReader::readMetaDataBegin()
+{
+	while(true) {
+		int type = m_in.peek();
+		if(type == ChainPack::TypeInfo::MetaIMap) {
+			m_in.get();
+			return true;
+		}
+		if(type != ChainPack::TypeInfo::MetaSMap)
+			return false;
+		m_in.get();
+		readData_Map();
+	}
+}
+
+void ChainPackReader::skipMetaData()
+{
+	int type = m_in.peek();
+	if(type == ChainPack::TypeInfo::MetaIMap || type == ChainPack::TypeInfo::MetaSMap) {
+		RpcValue::MetaData md;
+		read(md);
+	}
+}
+
+void ChainPackReader::readContainerBegin(RpcValue::Type container_type)
+{
+	uint8_t type = getByte();
+	bool ok = (container_type == RpcValue::Type::List && type == ChainPack::TypeInfo::List)
+			|| (container_type == RpcValue::Type::Map && type == ChainPack::TypeInfo::Map)
+			|| (container_type == RpcValue::Type::IMap && type == ChainPack::TypeInfo::IMap);
+	if(!ok)
+		SHVCHP_EXCEPTION(std::string(RpcValue::typeToName(container_type)) + " expected, type info: " + Utils::toString((int)type));
+}
+
+bool ChainPackReader::readContainerEnd()
+{
+	int b = m_in.peek();
+	if(b < 0)
+		SHVCHP_EXCEPTION("Unexpected EOF!");
+	if(b != ChainPack::TypeInfo::TERM)
+		return false;
+	m_in.get();
+	return true;
+}
+
+RpcValue::UInt ChainPackReader::readIMapKey()
+{
+	return readData_UInt<RpcValue::UInt>(m_in);
+}
+
 RpcValue ChainPackReader::readData(ChainPack::TypeInfo::Enum type_info, bool is_array)
 {
 	RpcValue ret;
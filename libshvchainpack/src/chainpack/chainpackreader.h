@@ -3,6 +3,8 @@
 #include "abstractstreamreader.h"
 #include "chainpack.h"
 
+#include <vector>
+
 namespace shv {
 namespace chainpack {
 
@@ -17,7 +19,27 @@ public:
 	void read(RpcValue &val) override;
 
 	static uint64_t readUIntData(std::istream &data, bool *ok = nullptr);
+
+	/// typed reads of values without meta data, RpcValue is not constructed
+	/// @throw Exception if value of other type is read
+	uint64_t readUInt();
+	int64_t readInt();
+	bool readBool();
+	std::string readString();
+	/// reads UInt array, single UInt is read as array of one element
+	void readUIntArray(std::vector<RpcValue::UInt> &array);
+
+	/// meta data maps with string keys are skipped till next meta data IMap
+	/// @return true if meta data IMap was read, its entries are read by readIMapKey() and read() then
+	bool readMetaDataBegin();
+	/// skips meta data of value if any
+	void skipMetaData();
+	void readContainerBegin(RpcValue::Type container_type);
+	/// @return true if container end was read
+	bool readContainerEnd();
+	RpcValue::UInt readIMapKey();
 private:
+	uint8_t getByte();
 	RpcValue readData(ChainPack::TypeInfo::Enum type_info, bool is_array);
 
 	RpcValue::List readData_List();
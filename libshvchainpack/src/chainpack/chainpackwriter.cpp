@@ -154,7 +154,7 @@ void writeData_Blob(std::ostream &out, const T &blob)
 		out << (uint8_t)blob[i];
 }
 
-void writeData_DateTime(std::ostream &out, const RpcValue::DateTime &dt)
+int64_t packedDateTime(const RpcValue::DateTime &dt)
 {
 	int64_t msecs = dt.msecsSinceEpoch() - RpcValue::DateTime::SHV_EPOCH_MSEC;
 	int offset = (dt.offsetFromUtc() / 15) & 0b01111111;
@@ -170,7 +170,33 @@ void writeData_DateTime(std::ostream &out, const RpcValue::DateTime &dt)
 		msecs |= 1;
 	if(ms == 0)
 		msecs |= 2;
-	writeData_Int(out, msecs);
+	return msecs;
+}
+
+void writeData_DateTime(std::ostream &out, const RpcValue::DateTime &dt)
+{
+	writeData_Int(out, packedDateTime(dt));
+}
+
+template<typename T>
+size_t uintDataSize(T num)
+{
+	return bytes_needed(significant_bits_part_length(num));
+}
+
+template<typename T>
+size_t intDataSize(T snum)
+{
+	using UT = typename std::make_unsigned<T>::type;
+	UT num = snum < 0? -snum: snum;
+	// sign bit
+	return bytes_needed(significant_bits_part_length(num) + 1);
+}
+
+template<typename T>
+size_t blobDataSize(const T &blob)
+{
+	return uintDataSize(blob.length()) + blob.length();
 }
 
 } // namespace
@@ -210,6 +236,107 @@ size_t ChainPackWriter::write(const RpcValue::MetaData &meta_data)
 	return (size_t)m_out.tellp() - len;
 }
 
+size_t ChainPackWriter::encodedSize(const RpcValue &val)
+{
+	if(!val.isValid()) {
+		if(WRITE_INVALID_AS_NULL)
+			return 1;
+		SHVCHP_EXCEPTION("Cannot serialize invalid ChainPack.");
+	}
+	size_t ret = encodedSize(val.metaData());
+	switch (val.type()) {
+	case RpcValue::Type::Bool:
+		/// TRUE / FALSE type info only
+		return ret + 1;
+	case RpcValue::Type::UInt:
+		if(val.toUInt() < 64)
+			return ret + 1;
+		break;
+	case RpcValue::Type::Int: {
+		auto n = val.toInt();
+		if(n >= 0 && n < 64)
+			return ret + 1;
+		break;
+	}
+	default:
+		break;
+	}
+	return ret + 1 + dataSize(val);
+}
+
+size_t ChainPackWriter::encodedSize(const RpcValue::MetaData &meta_data)
+{
+	size_t ret = 0;
+	if(!meta_data.isEmpty()) {
+		const RpcValue::IMap &cim = meta_data.iValues();
+		if(!cim.empty())
+			ret += 1 + dataSize_IMap(cim);
+		const RpcValue::Map &csm = meta_data.sValues();
+		if(!csm.empty())
+			ret += 1 + dataSize_Map(csm);
+	}
+	return ret;
+}
+
+size_t ChainPackWriter::uIntDataSize(uint64_t n)
+{
+	return uintDataSize(n);
+}
+
+size_t ChainPackWriter::dataSize(const RpcValue &val)
+{
+	RpcValue::Type type = val.type();
+	switch (type) {
+	case RpcValue::Type::Null: return 0;
+	case RpcValue::Type::Bool: return 1;
+	case RpcValue::Type::UInt: return uintDataSize(val.toUInt64());
+	case RpcValue::Type::Int: return intDataSize(val.toInt64());
+	case RpcValue::Type::Double: return sizeof(double);
+	case RpcValue::Type::Decimal: {
+		const RpcValue::Decimal d = val.toDecimal();
+		return intDataSize(d.mantisa()) + intDataSize(d.precision());
+	}
+	case RpcValue::Type::DateTime: return intDataSize(packedDateTime(val.toDateTime()));
+	case RpcValue::Type::String: return blobDataSize(val.toString());
+	case RpcValue::Type::Blob: return blobDataSize(val.toBlob());
+	case RpcValue::Type::List: {
+		size_t ret = 1;
+		for (const RpcValue &cp : val.toList())
+			ret += encodedSize(cp);
+		return ret;
+	}
+	case RpcValue::Type::Array: {
+		const RpcValue::Array &array = val.toArray();
+		size_t ret = uintDataSize(array.size());
+		for (size_t i = 0; i < array.size(); ++i)
+			ret += dataSize(array.valueAt(i));
+		return ret;
+	}
+	case RpcValue::Type::Map: return dataSize_Map(val.toMap());
+	case RpcValue::Type::IMap: return dataSize_IMap(val.toIMap());
+	case RpcValue::Type::Invalid:
+		break;
+	}
+	SHVCHP_EXCEPTION("Internal error: attempt to compute size of helper type. type: " + std::string(RpcValue::typeToName(type)));
+	return 0;
+}
+
+size_t ChainPackWriter::dataSize_Map(const RpcValue::Map &map)
+{
+	size_t ret = 1;
+	for (const auto &kv : map)
+		ret += blobDataSize(kv.first) + encodedSize(kv.second);
+	return ret;
+}
+
+size_t ChainPackWriter::dataSize_IMap(const RpcValue::IMap &map)
+{
+	size_t ret = 1;
+	for (const auto &kv : map)
+		ret += uintDataSize(kv.first) + encodedSize(kv.second);
+	return ret;
+}
+
 void ChainPackWriter::writeUIntData(uint64_t n)
 {
 	writeUIntData(m_out, n);
@@ -220,6 +347,46 @@ void ChainPackWriter::writeUIntData(std::ostream &os, uint64_t n)
 	writeData_UInt(os, n);
 }
 
+void ChainPackWriter::writeUInt(uint64_t n)
+{
+	if(n < 64) {
+		/// TinyUInt
+		m_out << (uint8_t)n;
+	}
+	else {
+		m_out << (uint8_t)ChainPack::TypeInfo::UInt;
+		writeData_UInt(m_out, n);
+	}
+}
+
+void ChainPackWriter::writeInt(int64_t n)
+{
+	if(n >= 0 && n < 64) {
+		/// TinyInt
+		m_out << (uint8_t)(64 + n);
+	}
+	else {
+		m_out << (uint8_t)ChainPack::TypeInfo::Int;
+		writeData_Int(m_out, n);
+	}
+}
+
+void ChainPackWriter::writeBool(bool b)
+{
+	m_out << (uint8_t)(b? ChainPack::TypeInfo::TRUE: ChainPack::TypeInfo::FALSE);
+}
+
+void ChainPackWriter::writeString(const std::string &s)
+{
+	m_out << (uint8_t)ChainPack::TypeInfo::String;
+	writeData_Blob(m_out, s);
+}
+
+void ChainPackWriter::writeMetaDataBegin()
+{
+	m_out << (uint8_t)ChainPack::TypeInfo::MetaIMap;
+}
+
 static ChainPack::TypeInfo::Enum typeToTypeInfo(RpcValue::Type type)
 {
 	switch (type) {
@@ -366,6 +533,11 @@ void ChainPackWriter::writeMapElement(const std::string &key, const RpcValue &va
 	write(val);
 }
 
+void ChainPackWriter::writeMapKey(const std::string &key)
+{
+	writeData_Blob(m_out, key);
+}
+
 void ChainPackWriter::writeMapElement(RpcValue::UInt key, const RpcValue &val)
 {
 	writeData_UInt(m_out, key);
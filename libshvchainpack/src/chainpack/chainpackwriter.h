@@ -20,7 +20,22 @@ public:
 	void writeUIntData(uint64_t n);
 	static void writeUIntData(std::ostream &os, uint64_t n);
 
+	/// number of bytes, write(val) would produce, computed without encoding
+	static size_t encodedSize(const RpcValue &val);
+	static size_t encodedSize(const RpcValue::MetaData &meta_data);
+	static size_t uIntDataSize(uint64_t n);
+
+	/// typed writes of values without meta data, output is the same as write(RpcValue(v)) produces
+	void writeUInt(uint64_t n);
+	void writeInt(int64_t n);
+	void writeBool(bool b);
+	void writeString(const std::string &s);
+	/// meta data IMap is closed by writeContainerEnd()
+	void writeMetaDataBegin();
+
 	void writeIMapKey(RpcValue::UInt key) override {writeUIntData(key);}
+	/// Map key for streaming writes, key is followed by value written by write()
+	void writeMapKey(const std::string &key);
 	void writeContainerBegin(RpcValue::Type container_type) override;
 	/// ChainPack doesn't need to know container type to close it
 	void writeContainerEnd(RpcValue::Type container_type = RpcValue::Type::Invalid) override;
@@ -37,6 +52,10 @@ private:
 	void writeData_IMap(const RpcValue::IMap &map);
 	void writeData_List(const RpcValue::List &list);
 	void writeData_Array(const RpcValue::Array &array);
+
+	static size_t dataSize(const RpcValue &val);
+	static size_t dataSize_Map(const RpcValue::Map &map);
+	static size_t dataSize_IMap(const RpcValue::IMap &map);
 };
 
 } // namespace chainpack
@@ -0,0 +1,841 @@
+#include "cpon.h"
+#include "cponbufferreader.h"
+#include "chainpackwriter.h"
+#include "utils.h"
+
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+
+namespace shv {
+namespace chainpack {
+
+namespace {
+
+const int MAX_RECURSION_DEPTH = 1000;
+const int ERROR_CONTEXT_LENGTH = 40;
+
+/// powers of 10 exactly representable in double
+const double POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+	1e21, 1e22,
+};
+const int MAX_EXACT_POW10 = 22;
+const uint64_t MAX_EXACT_DOUBLE_MANTISSA = uint64_t(1) << 53;
+/// magnitude of Decimal mantissa is limited by its 48 bit storage
+const uint64_t MAX_DECIMAL_MANTISSA = (uint64_t(1) << 47) - 1;
+
+class DepthScope
+{
+public:
+	DepthScope(int &depth) : m_depth(depth) {m_depth++;}
+	~DepthScope() {m_depth--;}
+private:
+	int &m_depth;
+};
+
+inline bool in_range(long x, long lower, long upper)
+{
+	return (x >= lower && x <= upper);
+}
+
+inline bool is_digit(char c)
+{
+	return static_cast<unsigned char>(c - '0') < 10;
+}
+
+/// @return false if digit does not fit into mantissa anymore
+inline bool append_digit(uint64_t &mantissa, char c)
+{
+	static const uint64_t max_div_10 = std::numeric_limits<uint64_t>::max() / 10;
+	static const unsigned max_mod_10 = std::numeric_limits<uint64_t>::max() % 10;
+	unsigned d = static_cast<unsigned>(c - '0');
+	if(mantissa > max_div_10 || (mantissa == max_div_10 && d > max_mod_10))
+		return false;
+	mantissa = mantissa * 10 + d;
+	return true;
+}
+
+inline int hex_digit(char c)
+{
+	if(in_range(c, '0', '9'))
+		return c - '0';
+	if(in_range(c, 'a', 'f'))
+		return c - 'a' + 10;
+	if(in_range(c, 'A', 'F'))
+		return c - 'A' + 10;
+	return -1;
+}
+
+inline std::string dump_char(char c)
+{
+	char buf[12];
+	if (static_cast<uint8_t>(c) >= 0x20 && static_cast<uint8_t>(c) <= 0x7f) {
+		snprintf(buf, sizeof buf, "'%c' (%d)", c, c);
+	}
+	else {
+		snprintf(buf, sizeof buf, "(%d)", c);
+	}
+	return std::string(buf);
+}
+
+const uint64_t ONES = ~uint64_t(0) / 255;
+const uint64_t HIGH_BITS = ONES * 0x80;
+
+/// non zero if some byte of x is zero
+inline uint64_t has_zero_byte(uint64_t x)
+{
+	return (x - ONES) & ~x & HIGH_BITS;
+}
+
+/// non zero if some byte of x is less than n, n <= 128
+inline uint64_t has_byte_less_than(uint64_t x, uint8_t n)
+{
+	return (x - ONES * n) & ~x & HIGH_BITS;
+}
+
+/// @return pointer to the first '"', '\\' or control character in [p, end) or end
+/// string bytes are tested 8 at a time, it is where Cpon parsing spends most of the time
+const char* find_string_special(const char *p, const char *end)
+{
+	while(end - p >= 8) {
+		uint64_t x;
+		std::memcpy(&x, p, sizeof(x));
+		if(has_zero_byte(x ^ (ONES * '"')) | has_zero_byte(x ^ (ONES * '\\')) | has_byte_less_than(x, 0x20))
+			break;
+		p += 8;
+	}
+	for(; p < end; p++) {
+		unsigned char c = static_cast<unsigned char>(*p);
+		if(c == '"' || c == '\\' || c < 0x20)
+			break;
+	}
+	return p;
+}
+
+void encode_utf8(long pt, std::string &out)
+{
+	if (pt < 0)
+		return;
+
+	if (pt < 0x80) {
+		out += static_cast<char>(pt);
+	}
+	else if (pt < 0x800) {
+		out += static_cast<char>((pt >> 6) | 0xC0);
+		out += static_cast<char>((pt & 0x3F) | 0x80);
+	}
+	else if (pt < 0x10000) {
+		out += static_cast<char>((pt >> 12) | 0xE0);
+		out += static_cast<char>(((pt >> 6) & 0x3F) | 0x80);
+		out += static_cast<char>((pt & 0x3F) | 0x80);
+	}
+	else {
+		out += static_cast<char>((pt >> 18) | 0xF0);
+		out += static_cast<char>(((pt >> 12) & 0x3F) | 0x80);
+		out += static_cast<char>(((pt >> 6) & 0x3F) | 0x80);
+		out += static_cast<char>((pt & 0x3F) | 0x80);
+	}
+}
+
+/// slow, but correctly rounded conversion for numbers out of the exact double range
+/// @return false if number is out of double range
+bool string_to_double(const char *begin, const char *end, double &d)
+{
+	std::istringstream in(std::string(begin, end));
+	in.imbue(std::locale::classic());
+	d = 0;
+	in >> d;
+	return !in.fail();
+}
+
+/// @return false if magnitude of integer with sign does not fit into RpcValue::Int
+bool fits_int(uint64_t magnitude, bool negative)
+{
+	const uint64_t max = static_cast<uint64_t>(std::numeric_limits<RpcValue::Int>::max());
+	return magnitude <= (negative? max + 1: max);
+}
+
+bool fits_uint(uint64_t n)
+{
+	return n <= std::numeric_limits<RpcValue::UInt>::max();
+}
+
+int64_t signed_value(uint64_t magnitude, bool negative)
+{
+	return negative? -static_cast<int64_t>(magnitude): static_cast<int64_t>(magnitude);
+}
+
+}
+
+CponBufferReader::CponBufferReader(const char *data, size_t size)
+	: m_begin(data)
+	, m_pos(data)
+	, m_end(data + size)
+{
+}
+
+CponBufferReader::CponBufferReader(const std::string &data, size_t start_pos)
+	: m_begin(data.data())
+	, m_pos(data.data() + (start_pos < data.size()? start_pos: data.size()))
+	, m_end(data.data() + data.size())
+{
+}
+
+void CponBufferReader::throwParseException(const std::string &msg) const
+{
+	size_t near_len = static_cast<size_t>(m_end - m_pos);
+	if(near_len > ERROR_CONTEXT_LENGTH)
+		near_len = ERROR_CONTEXT_LENGTH;
+	throw ParseException(msg + " at pos: " + std::to_string(pos()) + " near to: " + std::string(m_pos, near_len));
+}
+
+RpcValue CponBufferReader::read()
+{
+	RpcValue value;
+	read(value);
+	return value;
+}
+
+void CponBufferReader::read(RpcValue &val, std::string &err)
+{
+	err.clear();
+	try {
+		read(val);
+	}
+	catch (ParseException &e) {
+		err = e.what();
+	}
+}
+
+char CponBufferReader::peekValidChar()
+{
+	while(true) {
+		while(m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+			m_pos++;
+		if(m_pos == m_end)
+			throwParseException("Unexpected end of stream.");
+		if(*m_pos != '/')
+			return *m_pos;
+		if(m_end - m_pos < 2)
+			throwParseException("Invalid comment.");
+		if(m_pos[1] == '/') {
+			// to end of line comment
+			const char *eol = static_cast<const char*>(std::memchr(m_pos, '\n', static_cast<size_t>(m_end - m_pos)));
+			m_pos = eol? eol + 1: m_end;
+		}
+		else if(m_pos[1] == '*') {
+			// multi line comment, "/*/" is not closed
+			const char *p = m_pos + 2;
+			while(true) {
+				p = static_cast<const char*>(std::memchr(p, '*', static_cast<size_t>(m_end - p)));
+				if(!p || p + 1 >= m_end)
+					throwParseException("Unclosed multiline comment.");
+				if(p[1] == '/')
+					break;
+				p++;
+			}
+			m_pos = p + 2;
+		}
+		else {
+			throwParseException("Invalid comment.");
+		}
+	}
+}
+
+char CponBufferReader::getValidChar()
+{
+	char ch = peekValidChar();
+	m_pos++;
+	return ch;
+}
+
+void CponBufferReader::read(RpcValue &val)
+{
+	if (m_depth > MAX_RECURSION_DEPTH)
+		throwParseException("maximum nesting depth exceeded");
+	DepthScope depth_scope(m_depth);
+
+	RpcValue::MetaData md;
+	char ch = peekValidChar();
+	if(ch == Cpon::C_META_BEGIN) {
+		read(md);
+		ch = peekValidChar();
+	}
+	auto check_prefix = [this](char expected, const char *msg) {
+		if(m_pos + 1 >= m_end || m_pos[1] != expected)
+			throwParseException(msg);
+		m_pos += 2;
+	};
+	switch (ch) {
+	case 'i':
+		check_prefix(Cpon::C_MAP_BEGIN, "Invalid IMap prefix.");
+		parseIMap(val);
+		break;
+	case 'a':
+		check_prefix(Cpon::C_LIST_BEGIN, "Invalid Array prefix.");
+		parseArray(val);
+		break;
+	case 'b':
+		check_prefix('"', "Invalid Blob prefix.");
+		parseBlob(val, false);
+		break;
+	case 'x':
+		check_prefix('"', "Invalid Blob prefix.");
+		parseBlob(val, true);
+		break;
+	case 'd':
+		check_prefix('"', "Invalid DateTime prefix.");
+		parseDateTime(val);
+		break;
+	case '{':
+		m_pos++;
+		parseMap(val);
+		break;
+	case '[':
+		m_pos++;
+		parseList(val);
+		break;
+	case '"': {
+		m_pos++;
+		std::string s;
+		parseStringHelper(s);
+		val = RpcValue(std::move(s));
+		break;
+	}
+	case 'n':
+		parseNull(val);
+		break;
+	case 'f':
+	case 't':
+		parseBool(val);
+		break;
+	default:
+		if(is_digit(ch) || ch == '-' || ch == '+' || ch == '.')
+			parseNumber(val);
+		else
+			throwParseException("Invalid input.");
+		break;
+	}
+	if(!md.isEmpty())
+		val.setMetaData(std::move(md));
+}
+
+void CponBufferReader::transcode(ChainPackWriter &wr)
+{
+	if (m_depth > MAX_RECURSION_DEPTH)
+		throwParseException("maximum nesting depth exceeded");
+	DepthScope depth_scope(m_depth);
+
+	char ch = peekValidChar();
+	if(ch == Cpon::C_META_BEGIN) {
+		RpcValue::MetaData md;
+		read(md);
+		wr.write(md);
+		ch = peekValidChar();
+	}
+	switch (ch) {
+	case '[':
+		m_pos++;
+		wr.writeContainerBegin(RpcValue::Type::List);
+		while (true) {
+			ch = peekValidChar();
+			if (ch == ',') {
+				m_pos++;
+				continue;
+			}
+			if (ch == Cpon::C_LIST_END) {
+				m_pos++;
+				break;
+			}
+			transcode(wr);
+		}
+		wr.writeContainerEnd(RpcValue::Type::List);
+		break;
+	case '{': {
+		m_pos++;
+		wr.writeContainerBegin(RpcValue::Type::Map);
+		std::string key;
+		while (readMapKey(key)) {
+			wr.writeMapKey(key);
+			transcode(wr);
+		}
+		wr.writeContainerEnd(RpcValue::Type::Map);
+		break;
+	}
+	case 'i':
+		if(m_pos + 1 >= m_end || m_pos[1] != Cpon::C_MAP_BEGIN)
+			throwParseException("Invalid IMap prefix.");
+		m_pos += 2;
+		wr.writeContainerBegin(RpcValue::Type::IMap);
+		while (true) {
+			ch = peekValidChar();
+			if (ch == ',') {
+				m_pos++;
+				continue;
+			}
+			if(ch == Cpon::C_MAP_END) {
+				m_pos++;
+				break;
+			}
+			RpcValue key;
+			parseNumber(key);
+			if(!(key.type() == RpcValue::Type::Int || key.type() == RpcValue::Type::UInt))
+				throwParseException("int key expected");
+			ch = getValidChar();
+			if (ch != ':')
+				throwParseException("expected ':' in IMap, got " + dump_char(ch));
+			wr.writeIMapKey(key.toUInt());
+			transcode(wr);
+		}
+		wr.writeContainerEnd(RpcValue::Type::IMap);
+		break;
+	default: {
+		RpcValue val;
+		read(val);
+		wr.write(val);
+		break;
+	}
+	}
+}
+
+void CponBufferReader::read(RpcValue::MetaData &meta_data)
+{
+	if(peekValidChar() != Cpon::C_META_BEGIN)
+		return;
+	m_pos++;
+	RpcValue::IMap imap;
+	RpcValue::Map smap;
+	while (true) {
+		char ch = peekValidChar();
+		if (ch == ',') {
+			m_pos++;
+			continue;
+		}
+		if(ch == Cpon::C_META_END) {
+			m_pos++;
+			break;
+		}
+		RpcValue key;
+		read(key);
+		if(!(key.type() == RpcValue::Type::Int || key.type() == RpcValue::Type::UInt)
+		   && !(key.type() == RpcValue::Type::String))
+			throwParseException("key expected");
+		ch = getValidChar();
+		if (ch != ':')
+			throwParseException("expected ':' in MetaData, got " + dump_char(ch));
+		if(key.type() == RpcValue::Type::String)
+			read(smap[key.toString()]);
+		else
+			read(imap[key.toUInt()]);
+	}
+	meta_data = RpcValue::MetaData(std::move(imap), std::move(smap));
+}
+
+void CponBufferReader::parseNull(RpcValue &val)
+{
+	if(m_end - m_pos < 4 || std::memcmp(m_pos, "null", 4) != 0)
+		throwParseException("Parse null error");
+	m_pos += 4;
+	val = RpcValue(nullptr);
+}
+
+void CponBufferReader::parseBool(RpcValue &val)
+{
+	if(m_end - m_pos >= 4 && std::memcmp(m_pos, "true", 4) == 0) {
+		m_pos += 4;
+		val = RpcValue(true);
+		return;
+	}
+	if(m_end - m_pos >= 5 && std::memcmp(m_pos, "false", 5) == 0) {
+		m_pos += 5;
+		val = RpcValue(false);
+		return;
+	}
+	throwParseException("Parse bool error");
+}
+
+void CponBufferReader::parseBlob(RpcValue &val, bool hex_blob)
+{
+	std::string s;
+	if(hex_blob) {
+		parseStringHelper(s);
+		s = Utils::fromHex(s);
+	}
+	else {
+		parseCStringHelper(s);
+	}
+	val = RpcValue(RpcValue::Blob(std::move(s)));
+}
+
+void CponBufferReader::parseDateTime(RpcValue &val)
+{
+	// date time is converted right from the buffer, when it has no escapes
+	const char *str_end = find_string_special(m_pos, m_end);
+	if(str_end < m_end && *str_end == '"') {
+		bool ok;
+		RpcValue::DateTime dt = RpcValue::DateTime::fromUtcString(m_pos, static_cast<size_t>(str_end - m_pos), &ok);
+		if(ok) {
+			m_pos = str_end + 1;
+			val = dt;
+			return;
+		}
+	}
+	std::string s;
+	parseStringHelper(s);
+	val = RpcValue::DateTime::fromUtcString(s);
+}
+
+void CponBufferReader::parseNumber(RpcValue &val)
+{
+	const char *start = m_pos;
+	bool negative = false;
+	if(*m_pos == '-' || *m_pos == '+') {
+		negative = (*m_pos == '-');
+		m_pos++;
+	}
+	if(m_end - m_pos > 1 && m_pos[0] == '0' && m_pos[1] == 'x') {
+		m_pos += 2;
+		uint64_t n = 0;
+		int cnt = 0;
+		for(int d; m_pos < m_end && (d = hex_digit(*m_pos)) >= 0; m_pos++, cnt++) {
+			if(n > (std::numeric_limits<uint64_t>::max() >> 4))
+				throwParseException("integer overflow");
+			n = n * 16 + static_cast<unsigned>(d);
+		}
+		if(cnt == 0)
+			throwParseException("number integer part missing");
+		if(m_pos < m_end && *m_pos == Cpon::C_UNSIGNED_END) {
+			if(negative)
+				throwParseException("negative unsigned number");
+			if(!fits_uint(n))
+				throwParseException("integer overflow");
+			m_pos++;
+			val = RpcValue(n);
+		}
+		else {
+			if(!fits_int(n, negative))
+				throwParseException("integer overflow");
+			val = RpcValue(signed_value(n, negative));
+		}
+		return;
+	}
+
+	uint64_t mantissa = 0;
+	/// decimal exponent of mantissa, digits not fitting into it are dropped
+	int exponent = 0;
+	int int_cnt = 0;
+	for(; m_pos < m_end && is_digit(*m_pos); m_pos++, int_cnt++) {
+		if(!append_digit(mantissa, *m_pos))
+			exponent++;
+	}
+	// dropped digits are fine for double only
+	const bool int_overflow = exponent > 0;
+	if(m_pos < m_end && *m_pos == Cpon::C_UNSIGNED_END) {
+		if(int_cnt == 0)
+			throwParseException("number integer part missing");
+		if(negative)
+			throwParseException("negative unsigned number");
+		if(int_overflow || !fits_uint(mantissa))
+			throwParseException("integer overflow");
+		m_pos++;
+		val = RpcValue(mantissa);
+		return;
+	}
+	bool is_double = false;
+	int dec_cnt = 0;
+	bool dec_overflow = false;
+	if(m_pos < m_end && *m_pos == '.') {
+		m_pos++;
+		is_double = true;
+		for(; m_pos < m_end && is_digit(*m_pos); m_pos++, dec_cnt++) {
+			if(append_digit(mantissa, *m_pos))
+				exponent--;
+			else
+				dec_overflow = true;
+		}
+		if(int_cnt + dec_cnt == 0)
+			throwParseException("number integer part missing");
+		if(m_pos < m_end && *m_pos == Cpon::C_DECIMAL_END) {
+			if(int_overflow || dec_overflow || mantissa > MAX_DECIMAL_MANTISSA
+			   || dec_cnt > std::numeric_limits<int16_t>::max())
+				throwParseException("decimal overflow");
+			m_pos++;
+			val = RpcValue(RpcValue::Decimal(signed_value(mantissa, negative), static_cast<int16_t>(dec_cnt)));
+			return;
+		}
+	}
+	else if(int_cnt == 0) {
+		throwParseException("number integer part missing");
+	}
+	if(m_pos < m_end && (*m_pos == 'e' || *m_pos == 'E')) {
+		m_pos++;
+		is_double = true;
+		bool negative_exp = false;
+		if(m_pos < m_end && (*m_pos == '-' || *m_pos == '+')) {
+			negative_exp = (*m_pos == '-');
+			m_pos++;
+		}
+		int exp_val = 0;
+		int exp_cnt = 0;
+		for(; m_pos < m_end && is_digit(*m_pos); m_pos++, exp_cnt++) {
+			if(exp_val < 100000)
+				exp_val = exp_val * 10 + (*m_pos - '0');
+		}
+		if(exp_cnt == 0)
+			throwParseException("double exponent part missing");
+		exponent += negative_exp? -exp_val: exp_val;
+	}
+	if(!is_double) {
+		if(int_overflow || !fits_int(mantissa, negative))
+			throwParseException("integer overflow");
+		val = RpcValue(signed_value(mantissa, negative));
+		return;
+	}
+	double d;
+	if(mantissa == 0) {
+		d = 0;
+	}
+	else if(mantissa <= MAX_EXACT_DOUBLE_MANTISSA && exponent >= -MAX_EXACT_POW10 && exponent <= MAX_EXACT_POW10) {
+		// both operands are exact, so the result is correctly rounded
+		d = static_cast<double>(mantissa);
+		if(exponent < 0)
+			d /= POW10[-exponent];
+		else
+			d *= POW10[exponent];
+	}
+	else if(!string_to_double(negative? start + 1: start, m_pos, d)) {
+		throwParseException("double out of range");
+	}
+	val = RpcValue(negative? -d: d);
+}
+
+void CponBufferReader::parseList(RpcValue &val)
+{
+	RpcValue::List lst;
+	while (true) {
+		char ch = peekValidChar();
+		if (ch == ',') {
+			m_pos++;
+			continue;
+		}
+		if (ch == Cpon::C_LIST_END) {
+			m_pos++;
+			break;
+		}
+		lst.emplace_back();
+		read(lst.back());
+	}
+	val = RpcValue(std::move(lst));
+}
+
+void CponBufferReader::parseArray(RpcValue &val)
+{
+	RpcValue::Array arr;
+	while (true) {
+		char ch = peekValidChar();
+		if (ch == ',') {
+			m_pos++;
+			continue;
+		}
+		if (ch == Cpon::C_LIST_END) {
+			m_pos++;
+			break;
+		}
+		RpcValue item;
+		read(item);
+		if(arr.empty()) {
+			arr = RpcValue::Array(item.type());
+		}
+		else {
+			if(item.type() != arr.type())
+				throwParseException("Mixed types in Array: " + item.toCpon());
+		}
+		arr.push_back(RpcValue::Array::makeElement(item));
+	}
+	val = RpcValue(std::move(arr));
+}
+
+bool CponBufferReader::readMapBegin()
+{
+	if(peekValidChar() != Cpon::C_MAP_BEGIN)
+		return false;
+	m_pos++;
+	return true;
+}
+
+bool CponBufferReader::readMapKey(std::string &key)
+{
+	while (true) {
+		char ch = getValidChar();
+		if (ch == ',')
+			continue;
+		if (ch == Cpon::C_MAP_END)
+			return false;
+		if(ch != '"')
+			throwParseException("expected '\"' in map key, got " + dump_char(ch));
+		key.clear();
+		parseStringHelper(key);
+		ch = getValidChar();
+		if (ch != ':')
+			throwParseException("expected ':' in Map, got " + dump_char(ch));
+		return true;
+	}
+}
+
+void CponBufferReader::parseMap(RpcValue &val)
+{
+	RpcValue::Map map;
+	std::string key;
+	while (readMapKey(key)) {
+		// keys are usually sorted, since Cpon is written from std::map
+		auto it = map.emplace_hint(map.end(), key, RpcValue());
+		read(it->second);
+	}
+	val = RpcValue(std::move(map));
+}
+
+void CponBufferReader::parseIMap(RpcValue &val)
+{
+	RpcValue::IMap map;
+	while (true) {
+		char ch = peekValidChar();
+		if (ch == ',') {
+			m_pos++;
+			continue;
+		}
+		if(ch == Cpon::C_MAP_END) {
+			m_pos++;
+			break;
+		}
+		RpcValue key;
+		parseNumber(key);
+		if(!(key.type() == RpcValue::Type::Int || key.type() == RpcValue::Type::UInt))
+			throwParseException("int key expected");
+		ch = getValidChar();
+		if (ch != ':')
+			throwParseException("expected ':' in IMap, got " + dump_char(ch));
+		auto it = map.emplace_hint(map.end(), key.toUInt(), RpcValue());
+		read(it->second);
+	}
+	val = RpcValue(std::move(map));
+}
+
+void CponBufferReader::parseStringHelper(std::string &val)
+{
+	long last_escaped_codepoint = -1;
+	while (true) {
+		const char *run_end = find_string_special(m_pos, m_end);
+		if(run_end != m_pos) {
+			encode_utf8(last_escaped_codepoint, val);
+			last_escaped_codepoint = -1;
+			val.append(m_pos, run_end);
+			m_pos = run_end;
+		}
+		if (m_pos == m_end)
+			throwParseException("unexpected end of input in string");
+
+		char ch = *m_pos++;
+		if (ch == '"') {
+			encode_utf8(last_escaped_codepoint, val);
+			return;
+		}
+		if (ch != '\\')
+			throwParseException("unescaped " + dump_char(ch) + " in string");
+
+		// Handle escapes
+		if (m_pos == m_end)
+			throwParseException("unexpected end of input in string");
+		ch = *m_pos++;
+
+		if (ch == 'u') {
+			if (m_end - m_pos < 4)
+				throwParseException("bad \\u escape: " + std::string(m_pos, m_end));
+			long codepoint = 0;
+			for (int j = 0; j < 4; j++) {
+				int d = hex_digit(m_pos[j]);
+				if (d < 0)
+					throwParseException("bad \\u escape: " + std::string(m_pos, 4));
+				codepoint = codepoint * 16 + d;
+			}
+			m_pos += 4;
+			// characters outside the BMP are encoded as a pair of \u escapes of UTF-16 surrogates
+			if (in_range(last_escaped_codepoint, 0xD800, 0xDBFF)
+				&& in_range(codepoint, 0xDC00, 0xDFFF)) {
+				encode_utf8((((last_escaped_codepoint - 0xD800) << 10)
+							 | (codepoint - 0xDC00)) + 0x10000, val);
+				last_escaped_codepoint = -1;
+			} else {
+				encode_utf8(last_escaped_codepoint, val);
+				last_escaped_codepoint = codepoint;
+			}
+			continue;
+		}
+
+		encode_utf8(last_escaped_codepoint, val);
+		last_escaped_codepoint = -1;
+
+		switch (ch) {
+		case 'b': val += '\b'; break;
+		case 'f': val += '\f'; break;
+		case 'n': val += '\n'; break;
+		case 'r': val += '\r'; break;
+		case 't': val += '\t'; break;
+		case '"':
+		case '\\':
+		case '/': val += ch; break;
+		default:
+			throwParseException("invalid escape character " + dump_char(ch));
+		}
+	}
+}
+
+void CponBufferReader::parseCStringHelper(std::string &val)
+{
+	while (true) {
+		const char *run_end = find_string_special(m_pos, m_end);
+		val.append(m_pos, run_end);
+		m_pos = run_end;
+		if (m_pos == m_end)
+			throwParseException("unexpected end of input in string");
+
+		char ch = *m_pos++;
+		if (ch == '"')
+			return;
+		if (ch != '\\')
+			throwParseException("unescaped " + dump_char(ch) + " in string");
+
+		// Handle escapes
+		if (m_pos == m_end)
+			throwParseException("unexpected end of input in string");
+		ch = *m_pos++;
+
+		if (ch == 'x') {
+			if (m_end - m_pos < 2)
+				throwParseException("bad \\x escape: " + std::string(m_pos, m_end));
+			int hi = hex_digit(m_pos[0]);
+			int lo = hex_digit(m_pos[1]);
+			if (hi < 0 || lo < 0)
+				throwParseException("bad \\x escape: " + std::string(m_pos, 2));
+			m_pos += 2;
+			val += static_cast<char>(16 * hi + lo);
+			continue;
+		}
+		switch (ch) {
+		case '\\': val += '\\'; break;
+		case '"' : val += '"'; break;
+		case 'b': val += '\b'; break;
+		case 'f': val += '\f'; break;
+		case 'n': val += '\n'; break;
+		case 'r': val += '\r'; break;
+		case 't': val += '\t'; break;
+		default:
+			throwParseException("invalid escape character " + dump_char(ch));
+		}
+	}
+}
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "abstractstreamreader.h"
+#include "rpcvalue.h"
+
+#include <string>
+
+namespace shv {
+namespace chainpack {
+
+class ChainPackWriter;
+
+/// Cpon (and JSON) parser working directly over contiguous buffer.
+/// It accepts the same input as CponReader, but it does not pay for std::istream per character,
+/// string runs without escapes are scanned 8 bytes at a time and copied at once.
+/// Buffer must outlive the reader.
+class SHVCHAINPACK_DECL_EXPORT CponBufferReader
+{
+public:
+	using ParseException = AbstractStreamReader::ParseException;
+public:
+	CponBufferReader(const char *data, size_t size);
+	CponBufferReader(const std::string &data, size_t start_pos = 0);
+	/// reader keeps pointer to data, temporary string would be destroyed before it is read
+	CponBufferReader(std::string &&data, size_t start_pos = 0) = delete;
+
+	/// position of first not parsed byte, relative to data
+	size_t pos() const {return static_cast<size_t>(m_pos - m_begin);}
+
+	RpcValue read();
+	void read(RpcValue &val);
+	void read(RpcValue &val, std::string &err);
+	/// reads meta data if present, nothing is consumed except white spaces otherwise
+	void read(RpcValue::MetaData &meta_data);
+
+	/// Map can be read member by member, when its members are mapped to something else than RpcValue::Map.
+	/// @return false if next value is not a Map, nothing is consumed except white spaces then
+	bool readMapBegin();
+	/// reads key of next Map member, member value has to be read by read() then
+	/// @return false if end of Map was read
+	bool readMapKey(std::string &key);
+
+	/// reads value and writes it to ChainPack writer, containers are piped element by element,
+	/// RpcValue is created for scalars, arrays and meta data only
+	void transcode(ChainPackWriter &wr);
+private:
+	char getValidChar();
+	char peekValidChar();
+	[[noreturn]] void throwParseException(const std::string &msg) const;
+
+	void parseStringHelper(std::string &val);
+	void parseCStringHelper(std::string &val);
+	void parseNull(RpcValue &val);
+	void parseBool(RpcValue &val);
+	void parseBlob(RpcValue &val, bool hex_blob);
+	void parseNumber(RpcValue &val);
+	void parseList(RpcValue &val);
+	void parseArray(RpcValue &val);
+	void parseMap(RpcValue &val);
+	void parseIMap(RpcValue &val);
+	void parseDateTime(RpcValue &val);
+private:
+	const char *m_begin;
+	const char *m_pos;
+	const char *m_end;
+	int m_depth = 0;
+};
+
+} // namespace chainpack
+} // namespace shv
@@ -2,17 +2,165 @@
 #include "cpon.h"
 #include "exception.h"
 
-#include <iostream>
 #include <cmath>
-#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
 namespace shv {
 namespace chainpack {
 
+namespace {
+
+template<size_t N>
+inline void write_literal(std::ostream &out, const char (&str)[N])
+{
+	out.write(str, N - 1);
+}
+
+inline void write_string(std::ostream &out, const std::string &str)
+{
+	out.write(str.data(), (std::streamsize)str.size());
+}
+
+void write_uint(std::ostream &out, uint64_t n, bool negative = false)
+{
+	char buff[24];
+	char *end = buff + sizeof(buff);
+	char *p = end;
+	do {
+		*--p = static_cast<char>('0' + n % 10);
+		n /= 10;
+	} while(n);
+	if(negative)
+		*--p = '-';
+	out.write(p, end - p);
+}
+
+void write_int(std::ostream &out, int64_t n)
+{
+	// unsigned negation is defined for INT64_MIN too
+	write_uint(out, n < 0? 0 - static_cast<uint64_t>(n): static_cast<uint64_t>(n), n < 0);
+}
+
+/// powers of 10 exactly representable in double
+const double POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15,
+};
+const double MAX_EXACT_DOUBLE_INT = 9007199254740992.; // 2^53
+
+/// fast path for values with few decimal places, which are the most of real world values
+/// m / 10^k is correctly rounded, so it is equal to value, when decimal m*10^-k reads back as value
+/// the smallest such k gives the shortest representation
+int format_short_decimal(double value, char *buff)
+{
+	const double abs_value = std::fabs(value);
+	for (int k = 0; k < (int)(sizeof(POW10) / sizeof(POW10[0])); k++) {
+		const double scaled = abs_value * POW10[k];
+		if(scaled >= MAX_EXACT_DOUBLE_INT)
+			return 0;
+		const double m = std::floor(scaled + 0.5);
+		if(m / POW10[k] != abs_value)
+			continue;
+		char digits[24];
+		char *digits_end = digits + sizeof(digits);
+		char *p = digits_end;
+		uint64_t n = static_cast<uint64_t>(m);
+		do {
+			*--p = static_cast<char>('0' + n % 10);
+			n /= 10;
+		} while(n);
+		int digit_cnt = static_cast<int>(digits_end - p);
+		char *out = buff;
+		if(std::signbit(value))
+			*out++ = '-';
+		if(digit_cnt <= k) {
+			*out++ = '0';
+			*out++ = '.';
+			for (int i = digit_cnt; i < k; i++)
+				*out++ = '0';
+			std::memcpy(out, p, (size_t)digit_cnt);
+			out += digit_cnt;
+		}
+		else {
+			int int_cnt = digit_cnt - k;
+			std::memcpy(out, p, (size_t)int_cnt);
+			out += int_cnt;
+			if(k > 0) {
+				*out++ = '.';
+				std::memcpy(out, p + int_cnt, (size_t)k);
+				out += k;
+			}
+		}
+		return static_cast<int>(out - buff);
+	}
+	return 0;
+}
+
+/// shortest representation reading back to the same double, 15 significant digits are always enough
+/// for numbers which were decimal with 15 and less digits, 17 digits are enough for any double
+int format_double(double value, char *buff, size_t size)
+{
+	int n = format_short_decimal(value, buff);
+	if(n > 0)
+		return n;
+	for (int precision = 15; precision <= 17; precision++) {
+		n = snprintf(buff, size, "%.*g", precision, value);
+		if(precision == 17 || std::strtod(buff, nullptr) == value)
+			break;
+	}
+	// snprintf and strtod respect LC_NUMERIC, Cpon decimal point does not
+	for (int i = 0; i < n; i++) {
+		if(buff[i] == ',')
+			buff[i] = '.';
+	}
+	return n;
+}
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+/// escape table marks for characters written as \uXXXX, \xXX or as a possible start of U+2028, U+2029
+const char ESC_UNICODE = 'u';
+const char ESC_HEX = 'x';
+const char ESC_LINE_SEPARATOR_LEAD = '!';
+
+/// escape character for each byte of String and Blob, 0 if byte is copied as is
+struct EscapeTable
+{
+	char string[256];
+	char blob[256];
+
+	EscapeTable()
+	{
+		std::memset(string, 0, sizeof(string));
+		std::memset(blob, 0, sizeof(blob));
+		for (int c = 0; c < 0x20; c++) {
+			string[c] = ESC_UNICODE;
+			blob[c] = ESC_HEX;
+		}
+		const char escaped[][2] = {{'\\', '\\'}, {'"', '"'}, {'\b', 'b'}, {'\f', 'f'}, {'\n', 'n'}, {'\r', 'r'}, {'\t', 't'}};
+		for (const auto &e : escaped) {
+			string[static_cast<uint8_t>(e[0])] = e[1];
+			blob[static_cast<uint8_t>(e[0])] = e[1];
+		}
+		// U+2028 and U+2029 are valid in JSON strings, but not in JavaScript ones
+		string[0xe2] = ESC_LINE_SEPARATOR_LEAD;
+	}
+};
+
+const EscapeTable& escape_table()
+{
+	static const EscapeTable table;
+	return table;
+}
+
+}
+
 void CponWriter::startBlock()
 {
 	if(!m_opts.indent().empty()) {
-		m_out << '\n';
+		m_out.put('\n');
 		m_currentIndent++;
 	}
 }
@@ -30,7 +178,7 @@ void CponWriter::indentElement()
 {
 	if(!m_opts.indent().empty()) {
 		for (int i = 0; i < m_currentIndent; ++i) {
-			m_out << m_opts.indent();
+			write_string(m_out, m_opts.indent());
 		}
 	}
 }
@@ -39,12 +187,12 @@ void CponWriter::separateElement(bool without_comma)
 {
 	if(m_opts.indent().empty()) {
 		if(!without_comma)
-			m_out << ", ";
+			write_literal(m_out, ", ");
 	}
 	else {
 		if(!without_comma)
-			m_out << ',';
-		m_out << '\n';
+			m_out.put(',');
+		m_out.put('\n');
 	}
 }
 
@@ -54,7 +202,7 @@ size_t CponWriter::write(const RpcValue &value)
 	if(!value.metaData().isEmpty()) {
 		write(value.metaData());
 		if(!m_opts.indent().empty())
-			m_out << '\n';
+			m_out.put('\n');
 	}
 	switch (value.type()) {
 	case RpcValue::Type::Null: write(nullptr); break;
@@ -84,27 +232,28 @@ size_t CponWriter::write(const RpcValue::MetaData &meta_data)
 {
 	size_t len = m_out.tellp();
 	if(!meta_data.isEmpty()) {
-		m_out << Cpon::C_META_BEGIN;
+		m_out.put(Cpon::C_META_BEGIN);
 		startBlock();
 		const RpcValue::IMap &cim = meta_data.iValues();
 		if(!cim.empty()) {
 			int nsid = meta_data.metaTypeNameSpaceId();
 			int mtid = meta_data.metaTypeId();
+			const meta::MetaType *meta_type = m_opts.isTranslateIds()? &meta::registeredType(nsid, mtid): nullptr;
 			size_t ix = 0;
 			for (const auto &kv : cim) {
 				indentElement();
 				unsigned tag = kv.first;
-				if(m_opts.isTranslateIds()) {
-					const meta::MetaInfo &tag_info = meta::registeredType(nsid, mtid).tagById(tag);
+				if(meta_type) {
+					const meta::MetaInfo &tag_info = meta_type->tagById(tag);
 					if(tag_info.isValid())
 						m_out << tag_info.name;
 					else
-						m_out << Utils::toString(tag);
+						write_uint(m_out, tag);
 				}
 				else {
-					m_out << Utils::toString(tag);
+					write_uint(m_out, tag);
 				}
-				m_out << ":";
+				m_out.put(':');
 				RpcValue meta_val = kv.second;
 				if(m_opts.isTranslateIds()) {
 					if(tag == meta::Tag::MetaTypeNameSpaceId) {
@@ -114,7 +263,7 @@ size_t CponWriter::write(const RpcValue::MetaData &meta_data)
 						if(n[0])
 							m_out << n;
 						else
-							m_out << Utils::toString(id);
+							write_int(m_out, id);
 					}
 					else if(tag == meta::Tag::MetaTypeId) {
 						int id = meta_val.toInt();
@@ -123,7 +272,7 @@ size_t CponWriter::write(const RpcValue::MetaData &meta_data)
 						if(n[0])
 							m_out << n;
 						else
-							m_out << Utils::toString(id);
+							write_int(m_out, id);
 					}
 					else {
 						write(meta_val);
@@ -142,24 +291,38 @@ size_t CponWriter::write(const RpcValue::MetaData &meta_data)
 			writeMapContent(csm);
 		}
 		endBlock();
-		m_out << Cpon::C_META_END;
+		m_out.put(Cpon::C_META_END);
 	}
 	return (size_t)m_out.tellp() - len;
 }
 
+void CponWriter::writeMetaDataBegin()
+{
+	m_out.put(Cpon::C_META_BEGIN);
+	startBlock();
+}
+
+void CponWriter::writeMetaDataEnd()
+{
+	endBlock();
+	m_out.put(Cpon::C_META_END);
+	if(!m_opts.indent().empty())
+		m_out.put('\n');
+}
+
 void CponWriter::writeContainerBegin(RpcValue::Type container_type)
 {
 	switch (container_type) {
 	case RpcValue::Type::List:
-		m_out << Cpon::C_LIST_BEGIN;
+		m_out.put(Cpon::C_LIST_BEGIN);
 		startBlock();
 		break;
 	case RpcValue::Type::Map:
-		m_out << Cpon::C_MAP_BEGIN;
+		m_out.put(Cpon::C_MAP_BEGIN);
 		startBlock();
 		break;
 	case RpcValue::Type::IMap:
-		m_out << Cpon::STR_IMAP_BEGIN;
+		write_string(m_out, Cpon::STR_IMAP_BEGIN);
 		startBlock();
 		break;
 	default:
@@ -170,7 +333,11 @@ void CponWriter::writeContainerBegin(RpcValue::Type container_type)
 
 void CponWriter::writeArrayBegin(RpcValue::Type , size_t )
 {
-	m_out << Cpon::STR_ARRAY_BEGIN;
+	// JSON has no typed arrays
+	if(m_opts.isJsonFormat())
+		m_out.put(Cpon::C_LIST_BEGIN);
+	else
+		write_string(m_out, Cpon::STR_ARRAY_BEGIN);
 	startBlock();
 }
 
@@ -180,12 +347,12 @@ void CponWriter::writeContainerEnd(RpcValue::Type container_type)
 	case RpcValue::Type::List:
 	case RpcValue::Type::Array:
 		endBlock();
-		m_out << Cpon::C_LIST_END;
+		m_out.put(Cpon::C_LIST_END);
 		break;
 	case RpcValue::Type::Map:
 	case RpcValue::Type::IMap:
 		endBlock();
-		m_out << Cpon::C_MAP_END;
+		m_out.put(Cpon::C_MAP_END);
 		break;
 	default:
 		SHVCHP_EXCEPTION(std::string("Cannot write end of container type: ") + RpcValue::typeToName(container_type));
@@ -204,7 +371,7 @@ void CponWriter::writeMapElement(const std::string &key, const RpcValue &val, bo
 {
 	indentElement();
 	write(key);
-	m_out << ':';
+	m_out.put(':');
 	write(val);
 	separateElement(without_separator);
 }
@@ -213,160 +380,150 @@ void CponWriter::writeMapElement(RpcValue::UInt key, const RpcValue &val, bool w
 {
 	indentElement();
 	write(key);
-	m_out << ':';
+	m_out.put(':');
 	write(val);
 	separateElement(without_separator);
 }
 
 CponWriter &CponWriter::write(std::nullptr_t)
 {
-	m_out << Cpon::STR_NULL;
+	write_string(m_out, Cpon::STR_NULL);
 	return *this;
 }
 
 CponWriter &CponWriter::write(bool value)
 {
-	m_out << (value? Cpon::STR_TRUE : Cpon::STR_FALSE);
+	write_string(m_out, value? Cpon::STR_TRUE : Cpon::STR_FALSE);
 	return *this;
 }
 
 CponWriter &CponWriter::write(int32_t value)
 {
-	m_out << Utils::toString(value);
+	write_int(m_out, value);
 	return *this;
 }
 
 CponWriter &CponWriter::write(uint32_t value)
 {
-	m_out << Utils::toString(value);
-	if(!m_opts.isJsonFormat())
-		m_out << Cpon::C_UNSIGNED_END;
-	return *this;
+	return write(static_cast<uint64_t>(value));
 }
 
 CponWriter &CponWriter::write(int64_t value)
 {
-	m_out << Utils::toString(value);
+	write_int(m_out, value);
 	return *this;
 }
 
 CponWriter &CponWriter::write(uint64_t value)
 {
-	m_out << Utils::toString(value);
+	write_uint(m_out, value);
 	if(!m_opts.isJsonFormat())
-		m_out << Cpon::C_UNSIGNED_END;
+		m_out.put(Cpon::C_UNSIGNED_END);
 	return *this;
 }
 
 CponWriter &CponWriter::write(double value)
 {
-	std::ostringstream ss;
-	if (std::isfinite(value)) {
-		ss << value;
-	}
-	else {
-		ss << Cpon::STR_NULL;
+	if (!std::isfinite(value)) {
+		// there is no Cpon nor JSON representation of inf and nan
+		return write(nullptr);
 	}
-	std::string s = ss.str();
-	if(s.find('.') == std::string::npos)
-		s += '.';
-	m_out << s;
+	char buff[32];
+	int n = format_double(value, buff, sizeof(buff));
+	m_out.write(buff, n);
+	// integral value must be distinguishable from Int
+	if(!std::memchr(buff, '.', (size_t)n) && !std::memchr(buff, 'e', (size_t)n))
+		m_out.put('.');
 	return *this;
 }
 
 CponWriter &CponWriter::write(RpcValue::Decimal value)
 {
-	m_out << value.toString() << Cpon::C_DECIMAL_END;
+	write_string(m_out, value.toString());
+	m_out.put(Cpon::C_DECIMAL_END);
 	return *this;
 }
 
 CponWriter &CponWriter::write(RpcValue::DateTime value)
 {
-	m_out << Cpon::STR_DATETIME_BEGIN << value.toUtcString() << '"';
+	char buff[RpcValue::DateTime::UTC_STRING_MAX_LEN];
+	size_t n = value.toUtcString(buff);
+	write_string(m_out, Cpon::STR_DATETIME_BEGIN);
+	m_out.write(buff, (std::streamsize)n);
+	m_out.put('"');
 	return *this;
 }
 
 CponWriter &CponWriter::write(const std::string &value)
 {
-	m_out << '"';
-	for (size_t i = 0; i < value.length(); i++) {
-		const char ch = value[i];
-		if (ch == '\\') {
-			m_out << "\\\\";
-		}
-		else if (ch == '"') {
-			m_out << "\\\"";
-		}
-		else if (ch == '\b') {
-			m_out << "\\b";
-		}
-		else if (ch == '\f') {
-			m_out << "\\f";
-		}
-		else if (ch == '\n') {
-			m_out << "\\n";
+	const char *esc_table = escape_table().string;
+	m_out.put('"');
+	const char *p = value.data();
+	const char *end = p + value.size();
+	// runs without escapes are copied at once
+	const char *run = p;
+	for (; p < end; p++) {
+		const uint8_t ch = static_cast<uint8_t>(*p);
+		const char esc = esc_table[ch];
+		if (!esc)
+			continue;
+		if (esc == ESC_LINE_SEPARATOR_LEAD) {
+			if(end - p < 3 || static_cast<uint8_t>(p[1]) != 0x80
+					|| (static_cast<uint8_t>(p[2]) != 0xa8 && static_cast<uint8_t>(p[2]) != 0xa9))
+				continue;
+			m_out.write(run, p - run);
+			write_literal(m_out, "\\u202");
+			m_out.put(static_cast<uint8_t>(p[2]) == 0xa8? '8': '9');
+			p += 2;
 		}
-		else if (ch == '\r') {
-			m_out << "\\r";
-		}
-		else if (ch == '\t') {
-			m_out << "\\t";
-		}
-		else if (static_cast<uint8_t>(ch) <= 0x1f) {
-			char buf[8];
-			snprintf(buf, sizeof buf, "\\u%04x", ch);
-			m_out << buf;
-		}
-		else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i+1]) == 0x80
-				 && static_cast<uint8_t>(value[i+2]) == 0xa8) {
-			m_out << "\\u2028";
-			i += 2;
-		}
-		else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i+1]) == 0x80
-				 && static_cast<uint8_t>(value[i+2]) == 0xa9) {
-			m_out << "\\u2029";
-			i += 2;
+		else if (esc == ESC_UNICODE) {
+			m_out.write(run, p - run);
+			const char buff[] = {'\\', 'u', '0', '0', HEX_DIGITS[ch >> 4], HEX_DIGITS[ch & 0xf]};
+			m_out.write(buff, sizeof(buff));
 		}
 		else {
-			m_out << ch;
+			m_out.write(run, p - run);
+			const char buff[] = {'\\', esc};
+			m_out.write(buff, sizeof(buff));
 		}
+		run = p + 1;
 	}
-	m_out << '"';
+	m_out.write(run, end - run);
+	m_out.put('"');
 	return *this;
 }
 
 CponWriter &CponWriter::write(const RpcValue::Blob &value)
 {
 	if(m_opts.isHexBlob()) {
-		m_out << Cpon::STR_HEX_BLOB_BEGIN;
-		m_out << Utils::toHex(value);
-		m_out << '"';
+		write_string(m_out, Cpon::STR_HEX_BLOB_BEGIN);
+		write_string(m_out, Utils::toHex(value));
+		m_out.put('"');
 	}
 	else {
-		m_out << Cpon::STR_ESC_BLOB_BEGIN;
-		for (size_t i = 0; i < value.length(); i++) {
-			const char ch = value[i];
-			switch (ch) {
-			case '\\': m_out << "\\\\"; break;
-			case '"' : m_out << "\\\""; break;
-			case '\b': m_out << "\\b"; break;
-			case '\f': m_out << "\\f"; break;
-			case '\n': m_out << "\\n"; break;
-			case '\r': m_out << "\\r"; break;
-			case '\t': m_out << "\\t"; break;
-			default: {
-				if (static_cast<uint8_t>(ch) <= 0x1f) {
-					char buf[8];
-					snprintf(buf, sizeof buf, "\\x%02x", ch);
-					m_out << buf;
-				}
-				else {
-					m_out << ch;
-				}
+		const char *esc_table = escape_table().blob;
+		write_string(m_out, Cpon::STR_ESC_BLOB_BEGIN);
+		const char *p = value.data();
+		const char *end = p + value.size();
+		const char *run = p;
+		for (; p < end; p++) {
+			const uint8_t ch = static_cast<uint8_t>(*p);
+			const char esc = esc_table[ch];
+			if (!esc)
+				continue;
+			m_out.write(run, p - run);
+			if (esc == ESC_HEX) {
+				const char buff[] = {'\\', 'x', HEX_DIGITS[ch >> 4], HEX_DIGITS[ch & 0xf]};
+				m_out.write(buff, sizeof(buff));
 			}
+			else {
+				const char buff[] = {'\\', esc};
+				m_out.write(buff, sizeof(buff));
 			}
+			run = p + 1;
 		}
-		m_out << '"';
+		m_out.write(run, end - run);
+		m_out.put('"');
 	}
 	return *this;
 }
@@ -411,14 +568,15 @@ CponWriter &CponWriter::write(const RpcValue::Array &values)
 
 void CponWriter::writeIMapContent(const RpcValue::IMap &values, const RpcValue::MetaData *meta_data)
 {
+	const meta::MetaType *meta_type = (m_opts.isTranslateIds() && meta_data)
+			? &meta::registeredType(meta_data->metaTypeNameSpaceId(), meta_data->metaTypeId())
+			: nullptr;
 	size_t ix = 0;
 	for (const auto &kv : values) {
 		indentElement();
-		if(m_opts.isTranslateIds() && meta_data) {
-			int mtid = meta_data->metaTypeId();
-			int nsid = meta_data->metaTypeNameSpaceId();
+		if(meta_type) {
 			unsigned key = kv.first;
-			const meta::MetaInfo key_info = meta::registeredType(nsid, mtid).keyById(key);
+			const meta::MetaInfo &key_info = meta_type->keyById(key);
 			if(key_info.isValid())
 				m_out << key_info.name;
 			else
@@ -427,7 +585,7 @@ void CponWriter::writeIMapContent(const RpcValue::IMap &values, const RpcValue::
 		else {
 			write(kv.first);
 		}
-		m_out << ":";
+		m_out.put(':');
 		write(kv.second);
 		separateElement(++ix == values.size());
 	}
@@ -57,6 +57,15 @@ public:
 	void writeMapElement(RpcValue::UInt key, const RpcValue &val, bool without_separator);
 	void writeArrayElement(const RpcValue &val, bool without_separator) {writeListElement(val, without_separator);}
 
+	/// Streaming API, containers can be written element by element without RpcValue.
+	/// Each element of container or meta data is enclosed by writeElementBegin() and writeElementEnd(),
+	/// map member is written as key, ':' and value.
+	void writeElementBegin() {indentElement();}
+	void writeElementEnd(bool is_last) {separateElement(is_last);}
+	/// meta data followed by value
+	void writeMetaDataBegin();
+	void writeMetaDataEnd();
+
 	CponWriter& write(std::nullptr_t);
 	CponWriter& write(bool value);
 	CponWriter& write(int32_t value);
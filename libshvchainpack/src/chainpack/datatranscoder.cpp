@@ -0,0 +1,354 @@
+#include "datatranscoder.h"
+#include "abstractstreamreader.h"
+#include "chainpack.h"
+#include "chainpackwriter.h"
+#include "cpon.h"
+#include "cponbufferreader.h"
+
+#include <cstring>
+#include <ostream>
+
+namespace shv {
+namespace chainpack {
+
+namespace {
+
+const int MAX_RECURSION_DEPTH = 1000;
+
+class DepthScope
+{
+public:
+	DepthScope(int &depth) : m_depth(depth) {m_depth++;}
+	~DepthScope() {m_depth--;}
+private:
+	int &m_depth;
+};
+
+/// ChainPack parser over contiguous buffer writing Cpon of values read
+class ChainPackToCpon
+{
+public:
+	ChainPackToCpon(const char *begin, const char *end, std::ostream &out, const CponWriterOptions &opts)
+		: m_begin(begin), m_pos(begin), m_end(end), m_out(out), m_wr(out, opts) {}
+
+	size_t pos() const {return static_cast<size_t>(m_pos - m_begin);}
+	void transcode();
+private:
+	[[noreturn]] void throwParseException(const std::string &msg) const
+	{
+		throw AbstractStreamReader::ParseException(msg + " at pos: " + std::to_string(pos()));
+	}
+	uint8_t peekByte() const
+	{
+		if(m_pos >= m_end)
+			throwParseException("Unexpected EOF!");
+		return static_cast<uint8_t>(*m_pos);
+	}
+	uint8_t getByte()
+	{
+		uint8_t b = peekByte();
+		m_pos++;
+		return b;
+	}
+	uint64_t readUIntData(int *pbitlen = nullptr);
+	int64_t readIntData();
+	const char* readBlobData(size_t &len);
+
+	void transcodeMetaData();
+	void transcodeData(ChainPack::TypeInfo::Enum type_info);
+	void transcodeArray(ChainPack::TypeInfo::Enum type_info);
+	void transcodeList();
+	void transcodeMap();
+	void transcodeIMap();
+	bool isTerm() const {return peekByte() == ChainPack::TypeInfo::TERM;}
+private:
+	const char *m_begin;
+	const char *m_pos;
+	const char *m_end;
+	std::ostream &m_out;
+	CponWriter m_wr;
+	int m_depth = 0;
+	/// reused for string and blob values
+	std::string m_string;
+	RpcValue::Blob m_blob;
+};
+
+uint64_t ChainPackToCpon::readUIntData(int *pbitlen)
+{
+	uint8_t head = getByte();
+	int bytes_to_read_cnt;
+	uint64_t num;
+	int bitlen;
+	if     ((head & 128) == 0) {bytes_to_read_cnt = 0; num = head & 127; bitlen = 7;}
+	else if((head &  64) == 0) {bytes_to_read_cnt = 1; num = head & 63; bitlen = 6 + 8;}
+	else if((head &  32) == 0) {bytes_to_read_cnt = 2; num = head & 31; bitlen = 5 + 2*8;}
+	else if((head &  16) == 0) {bytes_to_read_cnt = 3; num = head & 15; bitlen = 4 + 3*8;}
+	else {
+		bytes_to_read_cnt = (head & 0xf) + 4;
+		num = 0;
+		bitlen = bytes_to_read_cnt * 8;
+		// longer numbers cannot be stored in uint64_t, data are not trusted
+		if(bytes_to_read_cnt > 8)
+			throwParseException("Integer too long: " + std::to_string(bytes_to_read_cnt) + " bytes");
+	}
+	if(m_end - m_pos < bytes_to_read_cnt)
+		throwParseException("Unexpected EOF!");
+	for (int i = 0; i < bytes_to_read_cnt; ++i)
+		num = (num << 8) + static_cast<uint8_t>(*m_pos++);
+	if(pbitlen)
+		*pbitlen = bitlen;
+	return num;
+}
+
+int64_t ChainPackToCpon::readIntData()
+{
+	int bitlen;
+	uint64_t num = readUIntData(&bitlen);
+	uint64_t sign_bit_mask = uint64_t{1} << (bitlen - 1);
+	if(num & sign_bit_mask)
+		return -static_cast<int64_t>(num & ~sign_bit_mask);
+	return static_cast<int64_t>(num);
+}
+
+const char* ChainPackToCpon::readBlobData(size_t &len)
+{
+	len = static_cast<size_t>(readUIntData());
+	if(static_cast<size_t>(m_end - m_pos) < len)
+		throwParseException("Unexpected EOF!");
+	const char *ret = m_pos;
+	m_pos += len;
+	return ret;
+}
+
+void ChainPackToCpon::transcode()
+{
+	if (m_depth > MAX_RECURSION_DEPTH)
+		throwParseException("maximum nesting depth exceeded");
+	DepthScope depth_scope(m_depth);
+
+	uint8_t type = peekByte();
+	if(type == ChainPack::TypeInfo::MetaIMap || type == ChainPack::TypeInfo::MetaSMap)
+		transcodeMetaData();
+	type = getByte();
+	if(type < 128) {
+		if(type & 64)
+			m_wr.write(static_cast<int64_t>(type & 63));
+		else
+			m_wr.write(static_cast<uint64_t>(type & 63));
+	}
+	else if(type == ChainPack::TypeInfo::FALSE) {
+		m_wr.write(false);
+	}
+	else if(type == ChainPack::TypeInfo::TRUE) {
+		m_wr.write(true);
+	}
+	else if(type & ChainPack::ARRAY_FLAG_MASK) {
+		transcodeArray(static_cast<ChainPack::TypeInfo::Enum>(type & ~ChainPack::ARRAY_FLAG_MASK));
+	}
+	else {
+		switch (type) {
+		case ChainPack::TypeInfo::List: transcodeList(); break;
+		case ChainPack::TypeInfo::Map: transcodeMap(); break;
+		case ChainPack::TypeInfo::IMap: transcodeIMap(); break;
+		default: transcodeData(static_cast<ChainPack::TypeInfo::Enum>(type)); break;
+		}
+	}
+}
+
+void ChainPackToCpon::transcodeMetaData()
+{
+	m_wr.writeMetaDataBegin();
+	bool has_int_keys = false;
+	while(true) {
+		uint8_t type = peekByte();
+		if(type == ChainPack::TypeInfo::MetaIMap) {
+			m_pos++;
+			has_int_keys = true;
+			while(!isTerm()) {
+				m_wr.writeElementBegin();
+				// meta data tags are written without unsigned suffix
+				m_wr.write(static_cast<int64_t>(readUIntData()));
+				m_out.put(':');
+				transcode();
+				m_wr.writeElementEnd(isTerm());
+			}
+			m_pos++;
+		}
+		else if(type == ChainPack::TypeInfo::MetaSMap) {
+			m_pos++;
+			if(has_int_keys && !isTerm())
+				m_wr.writeElementEnd(false);
+			while(!isTerm()) {
+				size_t len;
+				const char *key = readBlobData(len);
+				m_wr.writeElementBegin();
+				m_string.assign(key, len);
+				m_wr.write(m_string);
+				m_out.put(':');
+				transcode();
+				m_wr.writeElementEnd(isTerm());
+			}
+			m_pos++;
+		}
+		else {
+			break;
+		}
+	}
+	m_wr.writeMetaDataEnd();
+}
+
+void ChainPackToCpon::transcodeData(ChainPack::TypeInfo::Enum type_info)
+{
+	switch (type_info) {
+	case ChainPack::TypeInfo::Null:
+		m_wr.write(nullptr);
+		break;
+	case ChainPack::TypeInfo::UInt:
+		m_wr.write(readUIntData());
+		break;
+	case ChainPack::TypeInfo::Int:
+		m_wr.write(readIntData());
+		break;
+	case ChainPack::TypeInfo::Double: {
+		if(m_end - m_pos < 8)
+			throwParseException("Unexpected EOF!");
+		uint64_t n = 0;
+		for (int i = 7; i >= 0; --i)
+			n = (n << 8) + static_cast<uint8_t>(m_pos[i]);
+		m_pos += 8;
+		double d;
+		std::memcpy(&d, &n, sizeof(d));
+		m_wr.write(d);
+		break;
+	}
+	case ChainPack::TypeInfo::Decimal: {
+		int64_t mant = readIntData();
+		int prec = static_cast<int>(readIntData());
+		m_wr.write(RpcValue::Decimal(mant, static_cast<int16_t>(prec)));
+		break;
+	}
+	case ChainPack::TypeInfo::Bool:
+		m_wr.write(getByte() != 0);
+		break;
+	case ChainPack::TypeInfo::TRUE:
+		m_wr.write(true);
+		break;
+	case ChainPack::TypeInfo::FALSE:
+		m_wr.write(false);
+		break;
+	case ChainPack::TypeInfo::DateTimeEpoch:
+		m_wr.write(RpcValue::DateTime::fromMSecsSinceEpoch(readIntData()));
+		break;
+	case ChainPack::TypeInfo::DateTime: {
+		int64_t d = readIntData();
+		int8_t offset = 0;
+		bool has_tz_offset = d & 1;
+		bool has_not_msec = d & 2;
+		d >>= 2;
+		if(has_tz_offset) {
+			offset = d & 0b01111111;
+			offset <<= 1;
+			offset >>= 1;
+			d >>= 7;
+		}
+		if(has_not_msec)
+			d *= 1000;
+		d += RpcValue::DateTime::SHV_EPOCH_MSEC;
+		m_wr.write(RpcValue::DateTime::fromMSecsSinceEpoch(d, offset * 15));
+		break;
+	}
+	case ChainPack::TypeInfo::String: {
+		size_t len;
+		const char *str = readBlobData(len);
+		m_string.assign(str, len);
+		m_wr.write(m_string);
+		break;
+	}
+	case ChainPack::TypeInfo::Blob: {
+		size_t len;
+		const char *str = readBlobData(len);
+		m_blob.assign(str, len);
+		m_wr.write(m_blob);
+		break;
+	}
+	default:
+		throwParseException("Invalid type info: " + std::to_string(static_cast<int>(type_info)));
+	}
+}
+
+void ChainPackToCpon::transcodeArray(ChainPack::TypeInfo::Enum type_info)
+{
+	uint64_t size = readUIntData();
+	m_wr.writeArrayBegin(ChainPack::typeInfoToArrayType(type_info), static_cast<size_t>(size));
+	for (uint64_t i = 0; i < size; ++i) {
+		m_wr.writeElementBegin();
+		transcodeData(type_info);
+		m_wr.writeElementEnd(i + 1 == size);
+	}
+	m_wr.writeContainerEnd(RpcValue::Type::Array);
+}
+
+void ChainPackToCpon::transcodeList()
+{
+	m_wr.writeContainerBegin(RpcValue::Type::List);
+	while(!isTerm()) {
+		m_wr.writeElementBegin();
+		transcode();
+		m_wr.writeElementEnd(isTerm());
+	}
+	m_pos++;
+	m_wr.writeContainerEnd(RpcValue::Type::List);
+}
+
+void ChainPackToCpon::transcodeMap()
+{
+	m_wr.writeContainerBegin(RpcValue::Type::Map);
+	while(!isTerm()) {
+		size_t len;
+		const char *key = readBlobData(len);
+		m_wr.writeElementBegin();
+		m_string.assign(key, len);
+		m_wr.write(m_string);
+		m_out.put(':');
+		transcode();
+		m_wr.writeElementEnd(isTerm());
+	}
+	m_pos++;
+	m_wr.writeContainerEnd(RpcValue::Type::Map);
+}
+
+void ChainPackToCpon::transcodeIMap()
+{
+	m_wr.writeContainerBegin(RpcValue::Type::IMap);
+	while(!isTerm()) {
+		m_wr.writeElementBegin();
+		m_wr.write(readUIntData());
+		m_out.put(':');
+		transcode();
+		m_wr.writeElementEnd(isTerm());
+	}
+	m_pos++;
+	m_wr.writeContainerEnd(RpcValue::Type::IMap);
+}
+
+} // namespace
+
+size_t DataTranscoder::chainPackToCpon(const std::string &data, size_t start_pos, std::ostream &out, const CponWriterOptions &opts)
+{
+	if(start_pos > data.size())
+		start_pos = data.size();
+	ChainPackToCpon transcoder(data.data() + start_pos, data.data() + data.size(), out, opts);
+	transcoder.transcode();
+	return start_pos + transcoder.pos();
+}
+
+size_t DataTranscoder::cponToChainPack(const std::string &data, size_t start_pos, std::ostream &out)
+{
+	CponBufferReader rd(data, start_pos);
+	ChainPackWriter wr(out);
+	rd.transcode(wr);
+	return rd.pos();
+}
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+#include "cponwriter.h"
+
+#include <iosfwd>
+#include <string>
+
+namespace shv {
+namespace chainpack {
+
+/// Direct conversion of values between ChainPack and Cpon, reader events are piped into the other writer,
+/// so the RpcValue tree is not built. Output is the same as if the value was read and written again,
+/// CponWriterOptions::isTranslateIds() is not supported.
+class SHVCHAINPACK_DECL_EXPORT DataTranscoder
+{
+public:
+	/// @return position after the ChainPack value read
+	/// @throw AbstractStreamReader::ParseException
+	static size_t chainPackToCpon(const std::string &data, size_t start_pos, std::ostream &out, const CponWriterOptions &opts = CponWriterOptions());
+	/// @return position after the Cpon value read
+	/// @throw AbstractStreamReader::ParseException
+	static size_t cponToChainPack(const std::string &data, size_t start_pos, std::ostream &out);
+};
+
+} // namespace chainpack
+} // namespace shv
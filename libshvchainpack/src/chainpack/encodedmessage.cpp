@@ -0,0 +1,29 @@
+#include "encodedmessage.h"
+#include "rpcdriver.h"
+#include "exception.h"
+
+namespace shv {
+namespace chainpack {
+
+EncodedMessage::EncodedMessage(const RpcValue &msg)
+{
+	std::string encoded = RpcDriver::codeRpcValue(Rpc::ProtocolType::ChainPack, msg);
+	m_value = RpcDriver::decodeData(Rpc::ProtocolType::ChainPack, encoded, 0);
+	m_data[(int)Rpc::ProtocolType::ChainPack] = std::make_shared<const std::string>(std::move(encoded));
+}
+
+EncodedMessage::Data EncodedMessage::data(Rpc::ProtocolType protocol_type) const
+{
+	if(protocol_type == Rpc::ProtocolType::Invalid || protocol_type > Rpc::ProtocolType::JsonRpc)
+		SHVCHP_EXCEPTION("Cannot serialize data without protocol version specified.")
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Data &data = m_data[(int)protocol_type];
+	if(!data) {
+		std::string encoded = RpcDriver::codeRpcValue(protocol_type, m_value);
+		data = std::make_shared<const std::string>(std::move(encoded));
+	}
+	return data;
+}
+
+} // namespace chainpack
+} // namespace shv
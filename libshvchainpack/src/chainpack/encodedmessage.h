@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+#include "rpc.h"
+#include "rpcvalue.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace shv {
+namespace chainpack {
+
+/// RPC message encoded at most once per protocol type. Encoded data are immutable
+/// and they are queued by reference by every RpcDriver sending the message, see RpcDriver::sendEncodedMessage().
+/// Use it to send the same message (typically notification) to many connections.
+/// Message value is deep copied in constructor, so EncodedMessage can be shared between threads
+/// even if the caller modifies the original message later.
+class SHVCHAINPACK_DECL_EXPORT EncodedMessage
+{
+public:
+	using Data = std::shared_ptr<const std::string>;
+
+	/// message is encoded to ChainPack and decoded back, value does not share any data with msg
+	explicit EncodedMessage(const RpcValue &msg);
+	EncodedMessage(const EncodedMessage &) = delete;
+	EncodedMessage& operator=(const EncodedMessage &) = delete;
+
+	const RpcValue& value() const {return m_value;}
+	/// message encoded in protocol_type, it is encoded on the first call only, thread safe
+	Data data(Rpc::ProtocolType protocol_type) const;
+private:
+	RpcValue m_value;
+	mutable std::mutex m_mutex;
+	mutable Data m_data[(int)Rpc::ProtocolType::JsonRpc + 1];
+};
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,105 @@
+#include "jsonrpctranscoder.h"
+#include "rpcmessage.h"
+#include "cponwriter.h"
+#include "cponbufferreader.h"
+
+#include <ostream>
+
+namespace shv {
+namespace chainpack {
+
+void JsonRpcTranscoder::writeJsonRpc(std::ostream &out, const RpcValue::MetaData &meta_data, const RpcValue &msg_data)
+{
+	using Key = RpcMessage::MetaType::Key;
+	CponWriterOptions opts;
+	opts.setJsonFormat(true);
+	CponWriter wr(out, opts);
+	wr.writeContainerBegin(RpcValue::Type::Map);
+
+	const RpcValue rq_id = RpcMessage::requestId(meta_data);
+	if(rq_id.isValid())
+		wr.writeMapElement(Rpc::JSONRPC_ID, rq_id);
+	const RpcValue shv_path = RpcMessage::shvPath(meta_data);
+	if(shv_path.isString())
+		wr.writeMapElement(Rpc::JSONRPC_SHV_PATH, shv_path);
+	const RpcValue caller_ids = RpcMessage::callerIds(meta_data);
+	if(caller_ids.isValid())
+		wr.writeMapElement(Rpc::JSONRPC_CALLER_ID, caller_ids);
+
+	// message data member is always the last one
+	const RpcValue::IMap &imap = msg_data.toIMap();
+	if(RpcMessage::isResponse(meta_data)) {
+		auto it = imap.find(Key::Error);
+		if(it != imap.end())
+			wr.writeMapElement(Rpc::JSONRPC_ERROR, RpcResponse::Error(it->second.toIMap()).toJson(), true);
+		else
+			wr.writeMapElement(Rpc::JSONRPC_RESULT, imap.value(Key::Result), true);
+	}
+	else {
+		wr.writeMapElement(Rpc::JSONRPC_METHOD, RpcMessage::method(meta_data));
+		wr.writeMapElement(Rpc::JSONRPC_PARAMS, imap.value(Key::Params), true);
+	}
+	wr.writeContainerEnd(RpcValue::Type::Map);
+}
+
+void JsonRpcTranscoder::readJsonRpc(const std::string &data, size_t start_pos, RpcValue::MetaData &meta_data, RpcValue &msg_data)
+{
+	using Key = RpcMessage::MetaType::Key;
+	CponBufferReader rd(data, start_pos);
+	if(!rd.readMapBegin())
+		throw CponBufferReader::ParseException("JSON-RPC message must be an object.");
+	RpcValue::IMap imap;
+	std::string key;
+	while(rd.readMapKey(key)) {
+		RpcValue val;
+		rd.read(val);
+		if(key == Rpc::JSONRPC_ID) {
+			unsigned id = val.toUInt();
+			if(id > 0)
+				RpcMessage::setRequestId(meta_data, id);
+		}
+		else if(key == Rpc::JSONRPC_METHOD) {
+			if(!val.toString().empty())
+				RpcMessage::setMethod(meta_data, val.toString());
+		}
+		else if(key == Rpc::JSONRPC_SHV_PATH) {
+			if(!val.toString().empty())
+				RpcMessage::setShvPath(meta_data, val.toString());
+		}
+		else if(key == Rpc::JSONRPC_CALLER_ID) {
+			if(val.isList()) {
+				// JSON array of caller ids is ChainPack UInt Array
+				RpcValue::Array caller_ids(RpcValue::Type::UInt);
+				for(const RpcValue &id : val.toList())
+					caller_ids.push_back(RpcValue::Array::makeElement(id.toUInt()));
+				RpcMessage::setCallerIds(meta_data, caller_ids);
+			}
+			else if(val.toUInt() > 0) {
+				RpcMessage::setCallerIds(meta_data, val.toUInt());
+			}
+		}
+		else if(key == Rpc::JSONRPC_PARAMS) {
+			imap[Key::Params] = std::move(val);
+		}
+		else if(key == Rpc::JSONRPC_RESULT) {
+			imap[Key::Result] = std::move(val);
+		}
+		else if(key == Rpc::JSONRPC_ERROR) {
+			if(val.isMap()) {
+				const RpcValue::Map &map = val.toMap();
+				RpcResponse::Error err;
+				err.setCode((RpcResponse::Error::ErrorType)map.value(Rpc::JSONRPC_ERROR_CODE).toInt());
+				RpcValue::String msg = map.value(Rpc::JSONRPC_ERROR_MESSAGE).toString();
+				err.setMessage(std::move(msg));
+				imap[Key::Error] = err;
+			}
+			else {
+				imap[Key::Error] = std::move(val);
+			}
+		}
+	}
+	msg_data = RpcValue(std::move(imap));
+}
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+#include "rpcvalue.h"
+
+#include <iosfwd>
+#include <string>
+
+namespace shv {
+namespace chainpack {
+
+/// Translation between JSON-RPC and ChainPack RPC messages without intermediate RpcValue::Map of JSON object.
+/// JSON members id, method, shvPath and callerId are mapped to RPC message meta data,
+/// params, result and error to message data IMap.
+class SHVCHAINPACK_DECL_EXPORT JsonRpcTranscoder
+{
+public:
+	/// writes JSON-RPC object of message meta data and message data IMap
+	static void writeJsonRpc(std::ostream &out, const RpcValue::MetaData &meta_data, const RpcValue &msg_data);
+	/// reads JSON-RPC object in single pass, meta data read are set to meta_data
+	/// @throw AbstractStreamReader::ParseException
+	static void readJsonRpc(const std::string &data, size_t start_pos, RpcValue::MetaData &meta_data, RpcValue &msg_data);
+};
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "chainpackreader.h"
+#include "chainpackwriter.h"
+#include "rpcvalue.h"
+
+#include <string>
+#include <vector>
+
+/// field of struct S stored in member, encoded as IMap entry with key id
+#define SHV_META_FIELD(id, S, member) shv::chainpack::meta::StructField<(int)id, S, decltype(S::member), &S::member>
+
+namespace shv {
+namespace chainpack {
+namespace meta {
+
+/// typed encoding of struct field values, plain fields are always written,
+/// Optional fields and invalid RpcValue are not written when they are not set
+template<typename T>
+struct FieldCodec;
+
+template<>
+struct FieldCodec<RpcValue::UInt>
+{
+	static bool isSet(RpcValue::UInt) {return true;}
+	static void write(ChainPackWriter &wr, RpcValue::UInt v) {wr.writeUInt(v);}
+	static void read(ChainPackReader &rd, RpcValue::UInt &v) {v = static_cast<RpcValue::UInt>(rd.readUInt());}
+	static RpcValue toRpcValue(RpcValue::UInt v) {return v;}
+	static void fromRpcValue(const RpcValue &rv, RpcValue::UInt &v) {v = rv.toUInt();}
+};
+
+template<>
+struct FieldCodec<RpcValue::Int>
+{
+	static bool isSet(RpcValue::Int) {return true;}
+	static void write(ChainPackWriter &wr, RpcValue::Int v) {wr.writeInt(v);}
+	static void read(ChainPackReader &rd, RpcValue::Int &v) {v = static_cast<RpcValue::Int>(rd.readInt());}
+	static RpcValue toRpcValue(RpcValue::Int v) {return v;}
+	static void fromRpcValue(const RpcValue &rv, RpcValue::Int &v) {v = rv.toInt();}
+};
+
+template<>
+struct FieldCodec<bool>
+{
+	static bool isSet(bool) {return true;}
+	static void write(ChainPackWriter &wr, bool v) {wr.writeBool(v);}
+	static void read(ChainPackReader &rd, bool &v) {v = rd.readBool();}
+	static RpcValue toRpcValue(bool v) {return v;}
+	static void fromRpcValue(const RpcValue &rv, bool &v) {v = rv.toBool();}
+};
+
+template<>
+struct FieldCodec<std::string>
+{
+	static bool isSet(const std::string &) {return true;}
+	static void write(ChainPackWriter &wr, const std::string &v) {wr.writeString(v);}
+	static void read(ChainPackReader &rd, std::string &v) {v = rd.readString();}
+	static RpcValue toRpcValue(const std::string &v) {return v;}
+	static void fromRpcValue(const RpcValue &rv, std::string &v) {v = rv.toString();}
+};
+
+/// UInt array, single UInt is accepted when read
+template<>
+struct FieldCodec<std::vector<RpcValue::UInt>>
+{
+	static bool isSet(const std::vector<RpcValue::UInt> &) {return true;}
+	static void write(ChainPackWriter &wr, const std::vector<RpcValue::UInt> &v)
+	{
+		wr.writeArrayBegin(RpcValue::Type::UInt, v.size());
+		for(RpcValue::UInt n : v)
+			wr.writeUIntData(n);
+	}
+	static void read(ChainPackReader &rd, std::vector<RpcValue::UInt> &v) {rd.readUIntArray(v);}
+	static RpcValue toRpcValue(const std::vector<RpcValue::UInt> &v)
+	{
+		RpcValue::Array array(RpcValue::Type::UInt);
+		array.reserve(v.size());
+		for(RpcValue::UInt n : v)
+			array.push_back(RpcValue::ArrayElement(n));
+		return array;
+	}
+	static void fromRpcValue(const RpcValue &rv, std::vector<RpcValue::UInt> &v)
+	{
+		v.clear();
+		if(rv.isArray()) {
+			const RpcValue::Array &array = rv.toArray();
+			v.reserve(array.size());
+			for (size_t i = 0; i < array.size(); ++i)
+				v.push_back(array.valueAt(i).toUInt());
+		}
+		else if(rv.isValid()) {
+			v.push_back(rv.toUInt());
+		}
+	}
+};
+
+/// untyped field, value is written and read as it is including its meta data
+template<>
+struct FieldCodec<RpcValue>
+{
+	static bool isSet(const RpcValue &v) {return v.isValid();}
+	static void write(ChainPackWriter &wr, const RpcValue &v) {wr.write(v);}
+	static void read(ChainPackReader &rd, RpcValue &v) {rd.read(v);}
+	static RpcValue toRpcValue(const RpcValue &v) {return v;}
+	static void fromRpcValue(const RpcValue &rv, RpcValue &v) {v = rv;}
+};
+
+template<typename T>
+struct FieldCodec<Optional<T>>
+{
+	static bool isSet(const Optional<T> &v) {return v.isSet();}
+	static void write(ChainPackWriter &wr, const Optional<T> &v) {FieldCodec<T>::write(wr, v.value());}
+	static void read(ChainPackReader &rd, Optional<T> &v) {FieldCodec<T>::read(rd, v.set());}
+	static RpcValue toRpcValue(const Optional<T> &v) {return FieldCodec<T>::toRpcValue(v.value());}
+	static void fromRpcValue(const RpcValue &rv, Optional<T> &v) {FieldCodec<T>::fromRpcValue(rv, v.set());}
+};
+
+template<int Id, typename S, typename T, T S::*Member>
+struct StructField
+{
+	enum {ID = Id};
+	using Codec = FieldCodec<T>;
+	static const T& get(const S &s) {return s.*Member;}
+	static T& get(S &s) {return s.*Member;}
+};
+
+template<typename... Fields>
+struct StructFieldList;
+
+template<>
+struct StructFieldList<>
+{
+	template<typename S>
+	static bool isEmpty(const S &) {return true;}
+	template<typename S>
+	static void writeEntries(ChainPackWriter &, const S &) {}
+	template<typename S>
+	static bool readEntry(ChainPackReader &, int, S &) {return false;}
+	template<typename S>
+	static void toIMap(const S &, RpcValue::IMap &) {}
+	template<typename S>
+	static void fromIMap(const RpcValue::IMap &, S &) {}
+};
+
+template<typename Field, typename... Fields>
+struct StructFieldList<Field, Fields...>
+{
+	using Codec = typename Field::Codec;
+	using Next = StructFieldList<Fields...>;
+
+	template<typename S>
+	static bool isEmpty(const S &s)
+	{
+		return !Codec::isSet(Field::get(s)) && Next::isEmpty(s);
+	}
+	template<typename S>
+	static void writeEntries(ChainPackWriter &wr, const S &s)
+	{
+		if(Codec::isSet(Field::get(s))) {
+			wr.writeIMapKey(Field::ID);
+			Codec::write(wr, Field::get(s));
+		}
+		Next::writeEntries(wr, s);
+	}
+	template<typename S>
+	static bool readEntry(ChainPackReader &rd, int key, S &s)
+	{
+		if(key == Field::ID) {
+			Codec::read(rd, Field::get(s));
+			return true;
+		}
+		return Next::readEntry(rd, key, s);
+	}
+	template<typename S>
+	static void toIMap(const S &s, RpcValue::IMap &m)
+	{
+		if(Codec::isSet(Field::get(s)))
+			m[Field::ID] = Codec::toRpcValue(Field::get(s));
+		Next::toIMap(s, m);
+	}
+	template<typename S>
+	static void fromIMap(const RpcValue::IMap &m, S &s)
+	{
+		auto it = m.find(Field::ID);
+		if(it != m.end())
+			Codec::fromRpcValue(it->second, Field::get(s));
+		Next::fromIMap(m, s);
+	}
+};
+
+/// Schema of struct with typed fields stored in IMap, fields are declared once by SHV_META_FIELD()
+/// and struct is written and read from ChainPack directly without intermediate IMap.
+/// Entries with keys not declared in schema are skipped when read.
+template<typename... Fields>
+struct StructSchema
+{
+	using FieldList = StructFieldList<Fields...>;
+
+	/// @return true if no field is set
+	template<typename S>
+	static bool isEmpty(const S &s) {return FieldList::isEmpty(s);}
+	/// writes entries of fields set, container begin and end are written by caller
+	template<typename S>
+	static void writeEntries(ChainPackWriter &wr, const S &s) {FieldList::writeEntries(wr, s);}
+	/// reads entries up to container end, fields not present in data are left untouched
+	template<typename S>
+	static void readEntries(ChainPackReader &rd, S &s)
+	{
+		while(!rd.readContainerEnd()) {
+			int key = static_cast<int>(rd.readIMapKey());
+			if(!FieldList::readEntry(rd, key, s))
+				rd.read();
+		}
+	}
+	template<typename S>
+	static void write(ChainPackWriter &wr, const S &s)
+	{
+		wr.writeContainerBegin(RpcValue::Type::IMap);
+		writeEntries(wr, s);
+		wr.writeContainerEnd(RpcValue::Type::IMap);
+	}
+	/// meta data of IMap read is skipped
+	template<typename S>
+	static void read(ChainPackReader &rd, S &s)
+	{
+		rd.skipMetaData();
+		rd.readContainerBegin(RpcValue::Type::IMap);
+		readEntries(rd, s);
+	}
+	template<typename S>
+	static RpcValue::IMap toIMap(const S &s)
+	{
+		RpcValue::IMap ret;
+		FieldList::toIMap(s, ret);
+		return ret;
+	}
+	template<typename S>
+	static void fromIMap(const RpcValue::IMap &m, S &s) {FieldList::fromIMap(m, s);}
+};
+
+}}}
@@ -1,5 +1,6 @@
 #include "metatypes.h"
 #include "exception.h"
+#include "rpcmessage.h"
 
 #include <necrolog.h>
 
@@ -9,28 +10,43 @@ namespace shv {
 namespace chainpack {
 namespace meta {
 
+namespace {
+
+constexpr MetaInfo embeded_tags[] = {
+	{(int)Tag::MetaTypeId, "T"},
+	{(int)Tag::MetaTypeNameSpaceId, "NS"},
+};
+static_assert(MetaInfoTable(embeded_tags, Tag::MetaTypeId).isConsecutive(), "Embeded tags table is not consecutive");
+
+const MetaInfo& invalid_meta_info()
+{
+	static MetaInfo invalid(-1, "");
+	return invalid;
+}
+
+}
+
 const MetaInfo &MetaType::tagById(int id) const
 {
-	static std::map<int, MetaInfo> embeded_mi = {
-		{(int)Tag::Invalid, {(int)Tag::Invalid, ""}},
-		{(int)Tag::MetaTypeId, {(int)Tag::MetaTypeId, "T"}},
-		{(int)Tag::MetaTypeNameSpaceId, {(int)Tag::MetaTypeNameSpaceId, "NS"}},
-	};
-	if(id <= (int)Tag::MetaTypeNameSpaceId)
-		return embeded_mi[id];
+	static const MetaInfoTable embeded(embeded_tags, Tag::MetaTypeId);
+	if(const MetaInfo *mi = embeded.find(id))
+		return *mi;
+	if(const MetaInfo *mi = m_tagTable.find(id))
+		return *mi;
 	auto it = m_tags.find(id);
 	if(it == m_tags.end())
-		return embeded_mi[(int)Tag::Invalid];
-	return m_tags.at(id);
+		return invalid_meta_info();
+	return it->second;
 }
 
 const MetaInfo &MetaType::keyById(int id) const
 {
-	static MetaInfo invalid(-1, "");
+	if(const MetaInfo *mi = m_keyTable.find(id))
+		return *mi;
 	auto it = m_keys.find(id);
 	if(it == m_keys.end())
-		return invalid;
-	return m_keys.at(id);
+		return invalid_meta_info();
+	return it->second;
 }
 
 GlobalNS::GlobalNS()
@@ -40,47 +56,87 @@ GlobalNS::GlobalNS()
 
 namespace {
 
-std::map<int, MetaNameSpace*> registered_ns;
+struct Registry
+{
+	GlobalNS globalNS;
+	MetaNameSpace *global = &globalNS;
+	/// GlobalNS types with small ids, indexed by type id
+	MetaType *globalTypes[GlobalNS::RegisteredMetaTypes::MAX] = {};
+	std::map<int, MetaNameSpace*> nameSpaces;
+
+	/// built-in types are registered before the first lookup, static initialization order does not matter
+	Registry()
+	{
+		static RpcMessage::MetaType rpc_message_type;
+		globalNS.types()[RpcMessage::MetaType::ID] = &rpc_message_type;
+		globalTypes[RpcMessage::MetaType::ID] = &rpc_message_type;
+	}
+};
 
+Registry& registry()
+{
+	static Registry r;
+	return r;
 }
 
-static void initMetaTypes()
+bool is_global_type_id(int type_id)
 {
-	static bool is_init = false;
-	if(!is_init) {
-		is_init = true;
-		static GlobalNS def;
-		registerNameSpace(GlobalNS::ID, &def);
-	}
+	return type_id >= 0 && type_id < GlobalNS::RegisteredMetaTypes::MAX;
+}
+
 }
 
 void registerNameSpace(int ns_id, MetaNameSpace *ns)
 {
-	initMetaTypes();
-	if(ns == nullptr)
-		registered_ns.erase(ns_id);
-	else
-		registered_ns[ns_id] = ns;
+	Registry &r = registry();
+	if(ns_id == GlobalNS::ID) {
+		r.global = ns;
+		for(MetaType *&type : r.globalTypes)
+			type = nullptr;
+		if(ns) {
+			for(const auto &kv : ns->types())
+				if(is_global_type_id(kv.first))
+					r.globalTypes[kv.first] = kv.second;
+		}
+	}
+	else if(ns == nullptr) {
+		r.nameSpaces.erase(ns_id);
+	}
+	else {
+		r.nameSpaces[ns_id] = ns;
+	}
 }
 
 void registerType(int ns_id, int type_id, MetaType *type)
 {
-	initMetaTypes();
-	auto it = registered_ns.find(ns_id);
-	if(it == registered_ns.end())
+	Registry &r = registry();
+	MetaNameSpace *ns = nullptr;
+	if(ns_id == GlobalNS::ID) {
+		ns = r.global;
+	}
+	else {
+		auto it = r.nameSpaces.find(ns_id);
+		if(it != r.nameSpaces.end())
+			ns = it->second;
+	}
+	if(ns == nullptr)
 		SHVCHP_EXCEPTION("Unknown namespace id!");
 	if(type == nullptr)
-		it->second->types().erase(type_id);
+		ns->types().erase(type_id);
 	else
-		it->second->types()[type_id] = type;
+		ns->types()[type_id] = type;
+	if(ns_id == GlobalNS::ID && is_global_type_id(type_id))
+		r.globalTypes[type_id] = type;
 }
 
 const MetaNameSpace &registeredNameSpace(int ns_id)
 {
-	initMetaTypes();
 	static MetaNameSpace invalid("");
-	auto it = registered_ns.find(ns_id);
-	if(it == registered_ns.end())
+	Registry &r = registry();
+	if(ns_id == GlobalNS::ID)
+		return r.global? *r.global: invalid;
+	auto it = r.nameSpaces.find(ns_id);
+	if(it == r.nameSpaces.end())
 		return invalid;
 	return *(it->second);
 }
@@ -88,6 +144,10 @@ const MetaNameSpace &registeredNameSpace(int ns_id)
 const MetaType &registeredType(int ns_id, int type_id)
 {
 	static MetaType invalid("");
+	if(ns_id == GlobalNS::ID && is_global_type_id(type_id)) {
+		const MetaType *type = registry().globalTypes[type_id];
+		return type? *type: invalid;
+	}
 	const MetaNameSpace &ns = registeredNameSpace(ns_id);
 	if(ns.isValid()) {
 		auto it = ns.types().find(type_id);
@@ -4,9 +4,11 @@
 
 #include <cstddef>
 #include <map>
+#include <utility>
 
 #define RPC_META_TAG_DEF(tag_name) {(int)Tag::tag_name, {(int)Tag::tag_name, #tag_name }}
 #define RPC_META_KEY_DEF(key_name) {(int)Key::key_name, {(int)Key::key_name, #key_name }}
+#define RPC_META_KEY_INFO(key_name) shv::chainpack::meta::MetaInfo{(int)Key::key_name, #key_name}
 
 namespace shv {
 namespace chainpack {
@@ -30,12 +32,34 @@ public:
 	int id = 0;
 	const char *name = nullptr;
 
-	MetaInfo() : id(0), name(nullptr) {}
-	MetaInfo(int id, const char *name) : id(id), name(name) {}
+	constexpr MetaInfo() : id(0), name(nullptr) {}
+	constexpr MetaInfo(int id, const char *name) : id(id), name(name) {}
 
 	bool isValid() const {return (name && name[0]);}
 };
 
+/// value of typed struct field with explicit presence, 0 or empty string can be set as well, see StructSchema
+template<typename T>
+class Optional
+{
+public:
+	Optional() : m_value(), m_isSet(false) {}
+	Optional(const T &v) : m_value(v), m_isSet(true) {}
+	Optional(T &&v) : m_value(std::move(v)), m_isSet(true) {}
+
+	bool isSet() const {return m_isSet;}
+	const T& value() const {return m_value;}
+	/// marks value as set, returned reference can be used to assign it
+	T& set() {m_isSet = true; return m_value;}
+	void reset() {m_value = T(); m_isSet = false;}
+
+	bool operator==(const Optional &o) const {return m_isSet == o.m_isSet && m_value == o.m_value;}
+	bool operator!=(const Optional &o) const {return !(*this == o);}
+private:
+	T m_value;
+	bool m_isSet;
+};
+
 class MetaType;
 class MetaNameSpace
 {
@@ -51,20 +75,51 @@ protected:
 	std::map<int, MetaType*> m_types;
 };
 
+/// constant array of MetaInfo with consecutive ids starting at firstId
+struct MetaInfoTable
+{
+	const MetaInfo *infos;
+	size_t size;
+	int firstId;
+
+	constexpr MetaInfoTable() : infos(nullptr), size(0), firstId(0) {}
+	template<size_t N>
+	constexpr MetaInfoTable(const MetaInfo (&table)[N], int first_id) : infos(table), size(N), firstId(first_id) {}
+
+	/// to check table definition in static_assert
+	constexpr bool isConsecutive(size_t ix = 0) const
+	{
+		return ix >= size || (infos[ix].id == firstId + static_cast<int>(ix) && isConsecutive(ix + 1));
+	}
+	const MetaInfo* find(int id) const
+	{
+		size_t ix = static_cast<size_t>(id - firstId);
+		if(id < firstId || ix >= size)
+			return nullptr;
+		return infos + ix;
+	}
+};
+
 class MetaType
 {
 public:
 	MetaType(const char *name) : m_name(name) {}
+	/// meta type with tags and keys defined in constant tables, ids are looked up without m_tags and m_keys maps
+	MetaType(const char *name, const MetaInfoTable &tags, const MetaInfoTable &keys) : m_name(name), m_tagTable(tags), m_keyTable(keys) {}
 	const char *name() const {return m_name;}
 	const MetaInfo& tagById(int id) const;
 	const MetaInfo& keyById(int id) const;
 	bool isValid() const {return (m_name && m_name[0]);}
 protected:
 	const char *m_name;
+	MetaInfoTable m_tagTable;
+	MetaInfoTable m_keyTable;
 	std::map<int, MetaInfo> m_tags;
 	std::map<int, MetaInfo> m_keys;
 };
 
+/// types of GlobalNS with id < GlobalNS::RegisteredMetaTypes::MAX are looked up in array,
+/// other namespaces and types in maps
 SHVCHAINPACK_DECL_EXPORT void registerNameSpace(int ns_id, MetaNameSpace *ns);
 SHVCHAINPACK_DECL_EXPORT void registerType(int ns_id, int type_id, MetaType *tid);
 SHVCHAINPACK_DECL_EXPORT const MetaNameSpace& registeredNameSpace(int ns_id);
@@ -83,6 +138,7 @@ public:
 			ChainPackRpcMessage = 1,
 			RpcTunnelParams,
 			RpcTunnelHandle,
+			MAX
 		};
 	};
 };
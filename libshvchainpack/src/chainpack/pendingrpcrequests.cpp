@@ -0,0 +1,165 @@
+#include "pendingrpcrequests.h"
+
+#include <memory>
+
+namespace shv {
+namespace chainpack {
+
+PendingRpcRequests::PendingRpcRequests()
+	: m_timerWheel(100)
+	, m_count(0)
+{
+}
+
+void PendingRpcRequests::addRequest(unsigned request_id, int time_out_ms, ResponseCallback &&callback)
+{
+	bool was_empty = false;
+	bool is_duplicate;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto ret = m_requests.emplace(request_id, PendingRequest());
+		is_duplicate = !ret.second;
+		if(!is_duplicate) {
+			PendingRequest &rq = ret.first->second;
+			rq.callback = std::move(callback);
+			rq.sendTimeUsec = (m_metrics && RpcMetrics::isTimingEnabled())? RpcMetrics::monotonicUsec(): 0;
+			if(time_out_ms > 0) {
+				rq.timerId = m_timerWheel.addTimer(TimerWheel::monotonicMsec(), time_out_ms, [this, request_id]() {
+					m_timedOutRequestIds.push_back(request_id);
+				});
+			}
+			was_empty = (m_count == 0);
+			updateCount_locked();
+		}
+	}
+	if(is_duplicate) {
+		// callback of pending request with the same id must not be lost, the new one gets error instead
+		callback(createErrorResponse(request_id, RpcResponse::Error::create(RpcResponse::Error::InvalidRequest
+																			, "Duplicate request id: " + std::to_string(request_id))));
+		return;
+	}
+	if(was_empty && m_requestsPendingCallback)
+		m_requestsPendingCallback();
+}
+
+std::future<RpcResponse> PendingRpcRequests::addRequest(unsigned request_id, int time_out_ms)
+{
+	auto promise = std::make_shared<std::promise<RpcResponse>>();
+	std::future<RpcResponse> ret = promise->get_future();
+	addRequest(request_id, time_out_ms, [promise](const RpcResponse &response) {
+		promise->set_value(response);
+	});
+	return ret;
+}
+
+PendingRpcRequests::ResponseCallback PendingRpcRequests::takeCallback_locked(unsigned request_id, int64_t *send_time_usec)
+{
+	ResponseCallback ret;
+	auto it = m_requests.find(request_id);
+	if(it != m_requests.end()) {
+		if(it->second.timerId != TimerWheel::INVALID_TIMER_ID)
+			m_timerWheel.cancelTimer(it->second.timerId);
+		ret = std::move(it->second.callback);
+		if(send_time_usec)
+			*send_time_usec = it->second.sendTimeUsec;
+		m_requests.erase(it);
+		updateCount_locked();
+	}
+	return ret;
+}
+
+void PendingRpcRequests::updateCount_locked()
+{
+	m_count = m_requests.size();
+	if(m_metrics)
+		m_metrics->setGauge(RpcMetrics::Gauge::PendingRequests, static_cast<int64_t>(m_requests.size()));
+}
+
+bool PendingRpcRequests::processResponse(const RpcResponse &response)
+{
+	if(m_count == 0)
+		return false;
+	ResponseCallback cb;
+	int64_t send_time_usec = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		cb = takeCallback_locked(response.requestId().toUInt(), &send_time_usec);
+	}
+	if(!cb)
+		return false;
+	if(send_time_usec > 0)
+		m_metrics->record(RpcMetrics::HistogramId::RequestLatencyUsec, static_cast<uint64_t>(RpcMetrics::monotonicUsec() - send_time_usec));
+	cb(response);
+	return true;
+}
+
+bool PendingRpcRequests::cancelRequest(unsigned request_id, const std::string &reason)
+{
+	ResponseCallback cb;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		cb = takeCallback_locked(request_id);
+	}
+	if(!cb)
+		return false;
+	cb(createErrorResponse(request_id, RpcResponse::Error::create(RpcResponse::Error::SyncMethodCallCancelled
+																  , reason.empty()? "Method call cancelled": reason)));
+	return true;
+}
+
+void PendingRpcRequests::cancelAll(const std::string &reason)
+{
+	std::unordered_map<unsigned, PendingRequest> requests;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		requests.swap(m_requests);
+		for(const auto &kv : requests) {
+			if(kv.second.timerId != TimerWheel::INVALID_TIMER_ID)
+				m_timerWheel.cancelTimer(kv.second.timerId);
+		}
+		updateCount_locked();
+	}
+	for(auto &kv : requests) {
+		kv.second.callback(createErrorResponse(kv.first, RpcResponse::Error::create(RpcResponse::Error::SyncMethodCallCancelled
+																				   , reason.empty()? "Method call cancelled": reason)));
+	}
+}
+
+void PendingRpcRequests::checkTimeouts()
+{
+	if(m_count == 0)
+		return;
+	std::vector<std::pair<unsigned, ResponseCallback>> timed_out;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_timerWheel.advance(TimerWheel::monotonicMsec());
+		for(unsigned id : m_timedOutRequestIds) {
+			auto it = m_requests.find(id);
+			if(it == m_requests.end())
+				continue;
+			timed_out.emplace_back(id, std::move(it->second.callback));
+			m_requests.erase(it);
+		}
+		m_timedOutRequestIds.clear();
+		updateCount_locked();
+	}
+	for(auto &p : timed_out)
+		p.second(createErrorResponse(p.first, RpcResponse::Error::createSyncMethodCallTimeout()));
+}
+
+size_t PendingRpcRequests::count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_requests.size();
+}
+
+RpcResponse PendingRpcRequests::createErrorResponse(unsigned request_id, const RpcResponse::Error &error)
+{
+	RpcResponse ret;
+	ret.setRequestId(request_id);
+	ret.setError(error);
+	return ret;
+}
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "rpcmessage.h"
+#include "rpcmetrics.h"
+#include "timerwheel.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+namespace shv {
+namespace chainpack {
+
+/// Table of sent RPC requests waiting for response, keyed by request id.
+/// All the methods are thread safe, callbacks are called without internal lock held.
+class SHVCHAINPACK_DECL_EXPORT PendingRpcRequests
+{
+public:
+	using ResponseCallback = std::function<void (const RpcResponse &response)>;
+public:
+	PendingRpcRequests();
+
+	/// callback is called exactly once, with response or with error on timeout or cancel,
+	/// request_id which is pending already is refused, callback is called with InvalidRequest error immediately then
+	/// time_out_ms <= 0 means no timeout
+	void addRequest(unsigned request_id, int time_out_ms, ResponseCallback &&callback);
+	std::future<RpcResponse> addRequest(unsigned request_id, int time_out_ms);
+
+	/// @return true if response was pending and its callback was called
+	bool processResponse(const RpcResponse &response);
+	bool cancelRequest(unsigned request_id, const std::string &reason = std::string());
+	void cancelAll(const std::string &reason = std::string());
+	/// resolve timed out requests, should be called periodically (tickMsec() is enough) while !isEmpty()
+	void checkTimeouts();
+	int tickMsec() const {return m_timerWheel.tickMsec();}
+
+	size_t count() const;
+	bool isEmpty() const {return m_count == 0;}
+
+	/// called when the first request is added to the empty table,
+	/// checkTimeouts() calling should be scheduled then
+	using RequestsPendingCallback = std::function<void ()>;
+	void setRequestsPendingCallback(RequestsPendingCallback &&callback) {m_requestsPendingCallback = std::move(callback);}
+	/// pending requests count and request latency are reported to metrics, must be set before the first request is added
+	void setMetrics(RpcMetrics *metrics) {m_metrics = metrics;}
+private:
+	struct PendingRequest
+	{
+		ResponseCallback callback;
+		TimerWheel::TimerId timerId = TimerWheel::INVALID_TIMER_ID;
+		/// 0 if timing is not measured
+		int64_t sendTimeUsec = 0;
+	};
+private:
+	ResponseCallback takeCallback_locked(unsigned request_id, int64_t *send_time_usec = nullptr);
+	void updateCount_locked();
+	static RpcResponse createErrorResponse(unsigned request_id, const RpcResponse::Error &error);
+private:
+	mutable std::mutex m_mutex;
+	std::unordered_map<unsigned, PendingRequest> m_requests;
+	TimerWheel m_timerWheel;
+	std::vector<unsigned> m_timedOutRequestIds;
+	std::atomic<size_t> m_count;
+	RequestsPendingCallback m_requestsPendingCallback;
+	RpcMetrics *m_metrics = nullptr;
+};
+
+} // namespace chainpack
+} // namespace shv
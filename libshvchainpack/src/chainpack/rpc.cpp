@@ -9,6 +9,9 @@ const char* Rpc::KEY_CLIENT_ID = "clientId";
 const char* Rpc::KEY_MOUT_POINT = "mountPoint";
 const char* Rpc::KEY_DEVICE_ID = "deviceId";
 const char* Rpc::KEY_TUNNEL_HANDLE = "tunnelHandle";
+const char* Rpc::KEY_SESSION_TOKEN = "sessionToken";
+const char* Rpc::KEY_SESSION_RESUMED = "sessionResumed";
+const char* Rpc::KEY_SESSION = "session";
 
 const char* Rpc::TYPE_CLIENT = "client";
 const char* Rpc::TYPE_DEVICE = "device";
@@ -19,6 +19,9 @@ public:
 	static const char* KEY_MOUT_POINT;
 	static const char* KEY_DEVICE_ID;
 	static const char* KEY_TUNNEL_HANDLE;
+	static const char* KEY_SESSION_TOKEN;
+	static const char* KEY_SESSION_RESUMED;
+	static const char* KEY_SESSION;
 
 	static const char* TYPE_CLIENT;
 	static const char* TYPE_DEVICE;
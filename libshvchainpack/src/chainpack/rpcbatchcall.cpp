@@ -0,0 +1,156 @@
+#include "rpcbatchcall.h"
+#include "abstractrpcconnection.h"
+#include "timerwheel.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace shv {
+namespace chainpack {
+
+constexpr size_t RpcBatchCall::DEFAULT_MAX_IN_FLIGHT;
+
+RpcBatchCall::RpcBatchCall(AbstractRpcConnection *connection, std::vector<Request> &&requests)
+	: m_connection(connection)
+	, m_requests(std::move(requests))
+	, m_results(m_requests.size())
+	, m_isItemFinished(m_requests.size(), false)
+{
+}
+
+std::shared_ptr<RpcBatchCall> RpcBatchCall::create(AbstractRpcConnection *connection, std::vector<Request> &&requests)
+{
+	return std::shared_ptr<RpcBatchCall>(new RpcBatchCall(connection, std::move(requests)));
+}
+
+void RpcBatchCall::start()
+{
+	if(m_requests.empty()) {
+		if(m_finishedCallback)
+			m_finishedCallback(*this);
+		return;
+	}
+	sendNextRequests();
+}
+
+void RpcBatchCall::cancel()
+{
+	if(m_isCancelled || isFinished())
+		return;
+	m_isCancelled = true;
+	// keep this alive, the last callback can release the last reference
+	std::shared_ptr<RpcBatchCall> self = shared_from_this();
+	while(m_nextIndex < m_requests.size()) {
+		size_t ix = m_nextIndex++;
+		Result result;
+		result.response.setError(RpcResponse::Error::create(RpcResponse::Error::SyncMethodCallCancelled, "Batch call cancelled"));
+		finishItem(ix, std::move(result));
+	}
+	std::vector<unsigned> in_flight_ids = m_inFlightRequestIds;
+	for(unsigned rq_id : in_flight_ids)
+		m_connection->cancelMessageAsync(rq_id);
+}
+
+void RpcBatchCall::sendNextRequests()
+{
+	std::shared_ptr<RpcBatchCall> self = shared_from_this();
+	while(!m_isCancelled && m_nextIndex < m_requests.size() && m_inFlightRequestIds.size() < m_maxInFlight) {
+		size_t ix = m_nextIndex++;
+		const Request &rq = m_requests[ix];
+		int64_t send_time = TimerWheel::monotonicMsec();
+		unsigned rq_id;
+		try {
+			rq_id = m_connection->callShvMethodAsync(rq.shvPath, rq.method, rq.params, [self, ix, send_time](const RpcResponse &response) {
+				self->onResponse(ix, send_time, response);
+			}, m_timeout);
+		}
+		catch (std::exception &e) {
+			// callback might be registered already, it is ignored then when called
+			Result result;
+			result.response.setError(RpcResponse::Error::create(RpcResponse::Error::MethodInvocationException, e.what()));
+			finishItem(ix, std::move(result));
+			continue;
+		}
+		// request id is known after the call returns, response could be processed already
+		if(!m_isItemFinished[ix])
+			m_inFlightRequestIds.push_back(rq_id);
+	}
+}
+
+void RpcBatchCall::onResponse(size_t index, int64_t send_time, const RpcResponse &response)
+{
+	auto it = std::find(m_inFlightRequestIds.begin(), m_inFlightRequestIds.end(), response.requestId().toUInt());
+	if(it != m_inFlightRequestIds.end())
+		m_inFlightRequestIds.erase(it);
+	Result result;
+	result.response = response;
+	result.latencyMsec = static_cast<int>(TimerWheel::monotonicMsec() - send_time);
+	finishItem(index, std::move(result));
+	sendNextRequests();
+}
+
+void RpcBatchCall::finishItem(size_t index, Result &&result)
+{
+	if(m_isItemFinished[index])
+		return;
+	m_isItemFinished[index] = true;
+	m_results[index] = std::move(result);
+	m_finishedCount++;
+	if(m_itemFinishedCallback)
+		m_itemFinishedCallback(index, m_results[index]);
+	if(isFinished() && m_finishedCallback)
+		m_finishedCallback(*this);
+}
+
+RpcValue::List RpcBatchCall::resultList() const
+{
+	RpcValue::List ret;
+	ret.reserve(m_results.size());
+	for(const Result &r : m_results)
+		ret.push_back(r.response.isError()? RpcValue(nullptr): r.response.result());
+	return ret;
+}
+
+size_t RpcBatchCall::errorCount() const
+{
+	size_t n = 0;
+	for(const Result &r : m_results) {
+		if(r.response.isError())
+			n++;
+	}
+	return n;
+}
+
+int RpcBatchCall::minLatencyMsec() const
+{
+	int ret = -1;
+	for(const Result &r : m_results) {
+		if(r.latencyMsec >= 0 && (ret < 0 || r.latencyMsec < ret))
+			ret = r.latencyMsec;
+	}
+	return ret;
+}
+
+int RpcBatchCall::maxLatencyMsec() const
+{
+	int ret = -1;
+	for(const Result &r : m_results)
+		ret = std::max(ret, r.latencyMsec);
+	return ret;
+}
+
+double RpcBatchCall::averageLatencyMsec() const
+{
+	int64_t sum = 0;
+	size_t n = 0;
+	for(const Result &r : m_results) {
+		if(r.latencyMsec >= 0) {
+			sum += r.latencyMsec;
+			n++;
+		}
+	}
+	return n > 0? static_cast<double>(sum) / n: 0;
+}
+
+} // namespace chainpack
+} // namespace shv
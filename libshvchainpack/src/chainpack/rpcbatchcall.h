@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+#include "rpcmessage.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shv {
+namespace chainpack {
+
+class AbstractRpcConnection;
+
+/// Pipelined calls of many methods, at most maxInFlight() requests are sent and not answered at once.
+/// Callbacks are called in the connection thread, RpcBatchCall is not thread safe otherwise.
+/// Batch is kept alive by its pending requests, so the shared pointer returned by create() need not be stored.
+/// Call which cannot be sent, callShvMethodAsync() throws, is finished with MethodInvocationException error.
+class SHVCHAINPACK_DECL_EXPORT RpcBatchCall : public std::enable_shared_from_this<RpcBatchCall>
+{
+public:
+	static constexpr size_t DEFAULT_MAX_IN_FLIGHT = 32;
+
+	struct Request
+	{
+		std::string shvPath;
+		std::string method;
+		RpcValue params;
+
+		Request() {}
+		Request(std::string shv_path, std::string method_, RpcValue params_ = RpcValue())
+			: shvPath(std::move(shv_path)), method(std::move(method_)), params(std::move(params_)) {}
+	};
+	struct Result
+	{
+		RpcResponse response;
+		/// time from request sent to response received, -1 if request was not sent
+		int latencyMsec = -1;
+	};
+	using ItemFinishedCallback = std::function<void (size_t index, const Result &result)>;
+	using FinishedCallback = std::function<void (const RpcBatchCall &batch)>;
+public:
+	static std::shared_ptr<RpcBatchCall> create(AbstractRpcConnection *connection, std::vector<Request> &&requests);
+
+	size_t maxInFlight() const {return m_maxInFlight;}
+	void setMaxInFlight(size_t n) {m_maxInFlight = n > 0? n: 1;}
+	/// 0 means AbstractRpcConnection::defaultRpcTimeout()
+	void setTimeout(int time_out_ms) {m_timeout = time_out_ms;}
+	void setItemFinishedCallback(ItemFinishedCallback &&callback) {m_itemFinishedCallback = std::move(callback);}
+	void setFinishedCallback(FinishedCallback &&callback) {m_finishedCallback = std::move(callback);}
+
+	void start();
+	/// in flight requests are cancelled, not sent ones are finished with the same error
+	void cancel();
+
+	size_t count() const {return m_requests.size();}
+	size_t finishedCount() const {return m_finishedCount;}
+	size_t inFlightCount() const {return m_inFlightRequestIds.size();}
+	bool isFinished() const {return m_finishedCount == m_requests.size();}
+
+	const std::vector<Result>& results() const {return m_results;}
+	/// response results in request order, null for failed calls
+	RpcValue::List resultList() const;
+	size_t errorCount() const;
+	/// latency statistics of finished calls
+	int minLatencyMsec() const;
+	int maxLatencyMsec() const;
+	double averageLatencyMsec() const;
+private:
+	RpcBatchCall(AbstractRpcConnection *connection, std::vector<Request> &&requests);
+
+	void sendNextRequests();
+	void onResponse(size_t index, int64_t send_time, const RpcResponse &response);
+	/// item is finished once, later results of the same item are ignored
+	void finishItem(size_t index, Result &&result);
+private:
+	AbstractRpcConnection *m_connection;
+	std::vector<Request> m_requests;
+	std::vector<Result> m_results;
+	std::vector<bool> m_isItemFinished;
+	std::vector<unsigned> m_inFlightRequestIds;
+	size_t m_nextIndex = 0;
+	size_t m_finishedCount = 0;
+	size_t m_maxInFlight = DEFAULT_MAX_IN_FLIGHT;
+	int m_timeout = 0;
+	bool m_isCancelled = false;
+	ItemFinishedCallback m_itemFinishedCallback;
+	FinishedCallback m_finishedCallback;
+};
+
+} // namespace chainpack
+} // namespace shv
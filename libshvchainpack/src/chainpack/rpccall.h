@@ -0,0 +1,156 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+#include "rpcmessage.h"
+
+#ifdef SHVCHAINPACK_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace shv {
+namespace chainpack {
+
+/// Awaitable RPC call, available when compiled with C++20 coroutines support.
+///
+/// Request is sent when RpcCall is created, so any number of calls can be in flight
+/// before the first one is awaited:
+///
+///   RpcCall c1 = conn->call("node/a", "get");
+///   RpcCall c2 = conn->call("node/b", "get");
+///   RpcResponse r1 = co_await c1;
+///   RpcResponse r2 = co_await c2;
+///
+/// Awaiting coroutine is resumed in the thread where connection delivers responses.
+/// Timeout, disconnection or cancel() resume it with error response.
+/// Destroying unfinished RpcCall cancels the request.
+class RpcCall
+{
+public:
+	using ResponseCallback = std::function<void (const RpcResponse &response)>;
+	/// sends request with response callback passed, returns request id
+	using SendFunction = std::function<unsigned (ResponseCallback &&callback)>;
+	using CancelFunction = std::function<void (unsigned request_id)>;
+public:
+	RpcCall(const SendFunction &send_fn, CancelFunction &&cancel_fn)
+		: m_state(std::make_shared<State>())
+		, m_cancelFunction(std::move(cancel_fn))
+	{
+		std::shared_ptr<State> state = m_state;
+		m_requestId = send_fn([state](const RpcResponse &response) {
+			state->setResponse(response);
+		});
+	}
+	RpcCall(RpcCall &&) = default;
+	RpcCall& operator=(RpcCall &&other)
+	{
+		if(this != &other) {
+			release();
+			m_state = std::move(other.m_state);
+			m_cancelFunction = std::move(other.m_cancelFunction);
+			m_requestId = other.m_requestId;
+		}
+		return *this;
+	}
+	RpcCall(const RpcCall &) = delete;
+	RpcCall& operator=(const RpcCall &) = delete;
+	~RpcCall() {release();}
+
+	unsigned requestId() const {return m_requestId;}
+	bool isFinished() const
+	{
+		if(!m_state)
+			return true;
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		return m_state->isFinished;
+	}
+	/// awaiting coroutine is resumed with error response, no-op if call is already finished
+	void cancel()
+	{
+		if(!m_state)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			if(m_state->isFinished)
+				return;
+		}
+		if(m_cancelFunction)
+			m_cancelFunction(m_requestId);
+	}
+
+	bool await_ready() const {return isFinished();}
+	bool await_suspend(std::coroutine_handle<> awaiter)
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		if(m_state->isFinished)
+			return false;
+		m_state->awaiter = awaiter;
+		return true;
+	}
+	RpcResponse await_resume()
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		return m_state->response;
+	}
+private:
+	void release()
+	{
+		if(m_state) {
+			// awaiting coroutine frame is being destroyed, it must not be resumed
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			m_state->awaiter = nullptr;
+		}
+		cancel();
+	}
+private:
+	struct State
+	{
+		std::mutex mutex;
+		bool isFinished = false;
+		RpcResponse response;
+		std::coroutine_handle<> awaiter;
+
+		void setResponse(const RpcResponse &resp)
+		{
+			std::coroutine_handle<> h;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(isFinished)
+					return;
+				isFinished = true;
+				response = resp;
+				h = awaiter;
+				awaiter = nullptr;
+			}
+			if(h)
+				h.resume();
+		}
+	};
+private:
+	std::shared_ptr<State> m_state;
+	CancelFunction m_cancelFunction;
+	unsigned m_requestId = 0;
+};
+
+/// Return type of fire and forget coroutines awaiting RpcCall-s,
+/// coroutine starts immediately and its frame is freed when it returns.
+/// Like std::thread, uncaught exception terminates the application.
+struct RpcTask
+{
+	struct promise_type
+	{
+		RpcTask get_return_object() {return RpcTask{};}
+		std::suspend_never initial_suspend() noexcept {return {};}
+		std::suspend_never final_suspend() noexcept {return {};}
+		void return_void() {}
+		void unhandled_exception() {std::terminate();}
+	};
+};
+
+} // namespace chainpack
+} // namespace shv
+
+#endif
@@ -3,19 +3,18 @@
 #include "chainpack.h"
 #include "exception.h"
 #include "cponwriter.h"
-#include "cponreader.h"
+#include "cponbufferreader.h"
 #include "chainpackwriter.h"
 #include "chainpackreader.h"
-
-#include <necrolog.h>
+#include "jsonrpctranscoder.h"
+#include "datatranscoder.h"
+#include "encodedmessage.h"
+#include "rpclog.h"
+#include "stringoutbuf.h"
 
 #include <sstream>
 #include <iostream>
 
-#define logRpcMsg() nCDebug("RpcMsg")
-#define logRpcData() nCDebug("RpcData")
-//#define logRpcSyncCalls() nCDebug("RpcSyncCalls")
-
 namespace shv {
 namespace chainpack {
 
@@ -24,8 +23,91 @@ const char * RpcDriver::RCV_LOG_ARROW = "==>";
 
 int RpcDriver::s_defaultRpcTimeout = 5000;
 
+constexpr size_t RpcDriver::BufferPool::MIN_CLASS_CAPACITY;
+constexpr size_t RpcDriver::BufferPool::CLASS_COUNT;
+constexpr size_t RpcDriver::BufferPool::MAX_CLASS_BUFFERS;
+constexpr size_t RpcDriver::MAX_COALESCED_NOTIFIES;
+
+namespace {
+
+/// Broker forwards the same notification to all the subscribers, the last notification transcoded
+/// is kept within NotifyFanOutScope, so the notification data are transcoded once per destination protocol.
+struct TranscodedNotify
+{
+	Rpc::ProtocolType fromProtocol = Rpc::ProtocolType::Invalid;
+	Rpc::ProtocolType toProtocol = Rpc::ProtocolType::Invalid;
+	std::string data;
+	std::string transcodedData;
+
+	void clear()
+	{
+		fromProtocol = toProtocol = Rpc::ProtocolType::Invalid;
+		// release memory, assignment of empty string keeps capacity
+		std::string().swap(data);
+		std::string().swap(transcodedData);
+	}
+};
+thread_local TranscodedNotify s_lastTranscodedNotify;
+thread_local int s_notifyFanOutScopeDepth = 0;
+
+} // namespace
+
+RpcDriver::NotifyFanOutScope::NotifyFanOutScope()
+{
+	s_notifyFanOutScopeDepth++;
+}
+
+RpcDriver::NotifyFanOutScope::~NotifyFanOutScope()
+{
+	if(--s_notifyFanOutScopeDepth == 0)
+		s_lastTranscodedNotify.clear();
+}
+
+std::string RpcDriver::BufferPool::take(size_t size_hint)
+{
+	for (size_t i = 0; i < CLASS_COUNT; ++i) {
+		if(classCapacity(i) < size_hint)
+			continue;
+		std::vector<std::string> &buffers = m_buffers[i];
+		if(!buffers.empty()) {
+			m_stats.bufferPoolHits++;
+			std::string ret = std::move(buffers.back());
+			buffers.pop_back();
+			return ret;
+		}
+		break;
+	}
+	m_stats.bufferPoolMisses++;
+	std::string ret;
+	ret.reserve(size_hint < MIN_CLASS_CAPACITY? MIN_CLASS_CAPACITY: size_hint);
+	return ret;
+}
+
+void RpcDriver::BufferPool::give(std::string &&buff)
+{
+	size_t capacity = buff.capacity();
+	if(capacity < MIN_CLASS_CAPACITY)
+		return;
+	// the largest class which capacity is not greater than buffer capacity
+	size_t class_ix = 0;
+	while(class_ix + 1 < CLASS_COUNT && classCapacity(class_ix + 1) <= capacity)
+		class_ix++;
+	if(capacity > 4 * classCapacity(CLASS_COUNT - 1)) {
+		// do not hold huge buffers
+		return;
+	}
+	std::vector<std::string> &buffers = m_buffers[class_ix];
+	if(buffers.size() < MAX_CLASS_BUFFERS) {
+		buff.clear();
+		buffers.push_back(std::move(buff));
+	}
+}
+
 RpcDriver::RpcDriver()
+	: m_pendingRequestsHandle(std::make_shared<PendingRpcRequests*>(&m_pendingRequests))
+	, m_bufferPool(m_sendQueueStats)
 {
+	m_pendingRequests.setMetrics(&m_metrics);
 }
 
 RpcDriver::~RpcDriver()
@@ -33,37 +115,103 @@ RpcDriver::~RpcDriver()
 }
 
 void RpcDriver::sendRpcValue(const RpcValue &msg)
+{
+	if(m_notifyCoalescingWindow > 0 && isCoalescedNotify(msg.metaData())) {
+		coalesceNotify(CoalescedNotify{msg, RpcValue::MetaData(), std::string()});
+		return;
+	}
+	sendRpcValue_helper(msg);
+}
+
+void RpcDriver::sendEncodedMessage(const EncodedMessage &msg)
+{
+	const RpcValue &val = msg.value();
+	if(m_notifyCoalescingWindow > 0 && isCoalescedNotify(val.metaData())) {
+		coalesceNotify(CoalescedNotify{val, RpcValue::MetaData(), std::string()});
+		return;
+	}
+	logRpcMsg() << SND_LOG_ARROW << val.toPrettyString();
+	int64_t start_usec = RpcMetrics::startTiming();
+	EncodedMessage::Data data = msg.data(protocolType());
+	m_metrics.recordTiming(RpcMetrics::HistogramId::EncodeTimeUsec, start_usec);
+	if(m_maxMessageSize > 0 && data->size() > m_maxMessageSize)
+		SHVCHP_EXCEPTION("Message size " + std::to_string(data->size()) + " exceeds limit " + std::to_string(m_maxMessageSize));
+	Chunk chunk{std::move(data)};
+	chunk.isNotify = RpcMessage::isNotify(val.metaData());
+	chunk.priority = messagePriority(val.metaData(), chunk.size());
+	enqueueDataToSend(std::move(chunk));
+}
+
+void RpcDriver::sendRpcValue_helper(const RpcValue &msg)
 {
 	using namespace std;
 	//shvLogFuncFrame() << msg.toStdString();
 	logRpcMsg() << SND_LOG_ARROW << msg.toPrettyString();
-	std::string packed_data = codeRpcValue(protocolType(), msg);
+	size_t msg_size = 0;
+	if(protocolType() == Rpc::ProtocolType::ChainPack) {
+		msg_size = ChainPackWriter::encodedSize(msg);
+		if(m_maxMessageSize > 0 && msg_size > m_maxMessageSize)
+			SHVCHP_EXCEPTION("Message size " + std::to_string(msg_size) + " exceeds limit " + std::to_string(m_maxMessageSize));
+	}
+	std::string packed_data = m_bufferPool.take(msg_size);
+	int64_t start_usec = RpcMetrics::startTiming();
+	codeRpcValue(protocolType(), msg, packed_data);
+	m_metrics.recordTiming(RpcMetrics::HistogramId::EncodeTimeUsec, start_usec);
 	logRpcData() << "protocol:" << Rpc::ProtocolTypeToString(protocolType())
 				 << "packed data:"
 				 << ((protocolType() == Rpc::ProtocolType::ChainPack)? Utils::toHex(packed_data, 0, 250): packed_data.substr(0, 250));
-	enqueueDataToSend(Chunk{std::move(packed_data)});
+	Chunk chunk{std::move(packed_data)};
+	chunk.isNotify = RpcMessage::isNotify(msg.metaData());
+	chunk.priority = messagePriority(msg.metaData(), chunk.size());
+	enqueueDataToSend(std::move(chunk));
+}
+
+void RpcDriver::sendRpcRequest(const RpcRequest &request, PendingRpcRequests::ResponseCallback &&callback, int time_out_ms)
+{
+	if(time_out_ms == 0)
+		time_out_ms = defaultRpcTimeout();
+	m_pendingRequests.addRequest(request.requestId().toUInt(), time_out_ms, std::move(callback));
+	sendRpcValue(request.value());
 }
 
 void RpcDriver::sendRawData(std::string &&data)
 {
 	logRpcMsg() << "send raw data: " << (data.size() > 250? "<... long data ...>" : Utils::toHex(data));
-	enqueueDataToSend(Chunk{std::move(data)});
+	Chunk chunk{std::move(data)};
+	if(m_bulkMessageSize > 0 && chunk.size() > m_bulkMessageSize)
+		chunk.priority = MessagePriority::Bulk;
+	enqueueDataToSend(std::move(chunk));
 }
 
 void RpcDriver::sendRawData(const RpcValue::MetaData &meta_data, std::string &&data)
+{
+	if(m_notifyCoalescingWindow > 0 && isCoalescedNotify(meta_data)) {
+		coalesceNotify(CoalescedNotify{RpcValue(), RpcValue::MetaData(meta_data), std::move(data)});
+		return;
+	}
+	sendRawData_helper(meta_data, std::move(data));
+}
+
+void RpcDriver::sendRawData_helper(const RpcValue::MetaData &meta_data, std::string &&data)
 {
 	logRpcMsg() << "protocol:" << Rpc::ProtocolTypeToString(protocolType()) << "send raw meta + data: " << meta_data.toStdString()
 				<< Utils::toHex(data, 0, 250);
 	using namespace std;
 	//shvLogFuncFrame() << msg.toStdString();
-	std::ostringstream os_packed_meta_data;
+	std::string packed_meta_data;
 	switch (protocolType()) {
 	case Rpc::ProtocolType::Cpon: {
+		packed_meta_data = m_bufferPool.take(0);
+		StringOutBuf buf(packed_meta_data);
+		std::ostream os_packed_meta_data(&buf);
 		CponWriter wr(os_packed_meta_data);
 		wr << meta_data;
 		break;
 	}
 	case Rpc::ProtocolType::ChainPack: {
+		packed_meta_data = m_bufferPool.take(ChainPackWriter::encodedSize(meta_data));
+		StringOutBuf buf(packed_meta_data);
+		std::ostream os_packed_meta_data(&buf);
 		ChainPackWriter wr(os_packed_meta_data);
 		wr << meta_data;
 		break;
@@ -79,23 +227,112 @@ void RpcDriver::sendRawData(const RpcValue::MetaData &meta_data, std::string &&d
 		// JSON RPC must be handled separately
 		if(packed_data_ver == Rpc::ProtocolType::Invalid)
 			SHVCHP_EXCEPTION("Cannot serialize to JSON-RPC data without protocol version specified.")
-		// recode data;
+		// recode data, meta data are mapped to JSON-RPC members directly
+		int64_t start_usec = RpcMetrics::startTiming();
 		RpcValue val = decodeData(packed_data_ver, data, 0);
-		val.setMetaData(RpcValue::MetaData(meta_data));
-		enqueueDataToSend(Chunk(codeRpcValue(Rpc::ProtocolType::JsonRpc, val)));
+		std::string packed_data = m_bufferPool.take(0);
+		{
+			StringOutBuf buf(packed_data);
+			std::ostream os_packed_data(&buf);
+			JsonRpcTranscoder::writeJsonRpc(os_packed_data, meta_data, val);
+		}
+		m_metrics.recordTiming(RpcMetrics::HistogramId::EncodeTimeUsec, start_usec);
+		Chunk chunk(std::move(packed_data));
+		chunk.isNotify = RpcMessage::isNotify(meta_data);
+		chunk.priority = messagePriority(meta_data, chunk.size());
+		enqueueDataToSend(std::move(chunk));
 	}
 	else {
 		if(packed_data_ver == Rpc::ProtocolType::Invalid || packed_data_ver == protocolType()) {
-			enqueueDataToSend(Chunk(os_packed_meta_data.str(), std::move(data)));
+			if(m_maxMessageSize > 0 && packed_meta_data.size() + data.size() > m_maxMessageSize)
+				SHVCHP_EXCEPTION("Message size " + std::to_string(packed_meta_data.size() + data.size()) + " exceeds limit " + std::to_string(m_maxMessageSize));
+			Chunk chunk(std::move(packed_meta_data), std::move(data));
+			chunk.isNotify = RpcMessage::isNotify(meta_data);
+			chunk.priority = messagePriority(meta_data, chunk.size());
+			enqueueDataToSend(std::move(chunk));
 		}
 		else {
-			// recode data;
-			RpcValue val = decodeData(packed_data_ver, data, 0);
-			enqueueDataToSend(Chunk(os_packed_meta_data.str(), codeRpcValue(protocolType(), val)));
+			// recode data
+			int64_t start_usec = RpcMetrics::startTiming();
+			std::string packed_data = m_bufferPool.take(data.size());
+			bool is_notify = RpcMessage::isNotify(meta_data);
+			bool use_cache = is_notify && s_notifyFanOutScopeDepth > 0;
+			TranscodedNotify &last_notify = s_lastTranscodedNotify;
+			if(use_cache
+					&& last_notify.fromProtocol == packed_data_ver
+					&& last_notify.toProtocol == protocolType()
+					&& last_notify.data == data) {
+				packed_data.append(last_notify.transcodedData);
+				m_sendQueueStats.transcodeCacheHits++;
+			}
+			else {
+				transcodeData(packed_data_ver, protocolType(), data, packed_data);
+				if(use_cache) {
+					last_notify.fromProtocol = packed_data_ver;
+					last_notify.toProtocol = protocolType();
+					last_notify.data = std::move(data);
+					last_notify.transcodedData = packed_data;
+				}
+			}
+			m_metrics.recordTiming(RpcMetrics::HistogramId::EncodeTimeUsec, start_usec);
+			Chunk chunk(std::move(packed_meta_data), std::move(packed_data));
+			chunk.isNotify = is_notify;
+			chunk.priority = messagePriority(meta_data, chunk.size());
+			enqueueDataToSend(std::move(chunk));
 		}
 	}
 }
 
+void RpcDriver::setNotifyCoalescingWindow(int msec)
+{
+	m_notifyCoalescingWindow = msec;
+	if(msec <= 0)
+		flushCoalescedNotifies();
+}
+
+bool RpcDriver::isCoalescedNotify(const RpcValue::MetaData &meta_data)
+{
+	return RpcMessage::isNotify(meta_data) && RpcMessage::method(meta_data).toString() == Rpc::NTF_VAL_CHANGED;
+}
+
+void RpcDriver::coalesceNotify(CoalescedNotify &&ntf)
+{
+	const RpcValue::MetaData &meta_data = ntf.value.isValid()? ntf.value.metaData(): ntf.metaData;
+	std::string key = RpcMessage::shvPath(meta_data).toString();
+	key += ':';
+	key += RpcMessage::method(meta_data).toString();
+	auto it = m_coalescedNotifyIndex.find(key);
+	if(it == m_coalescedNotifyIndex.end()) {
+		m_coalescedNotifyIndex[key] = m_coalescedNotifies.size();
+		m_coalescedNotifies.push_back(std::move(ntf));
+		if(m_coalescedNotifies.size() == 1)
+			onCoalescedNotifyPending(m_notifyCoalescingWindow);
+		else if(m_coalescedNotifies.size() >= MAX_COALESCED_NOTIFIES)
+			flushCoalescedNotifies();
+	}
+	else {
+		// last value wins
+		m_sendQueueStats.mergedNotifies++;
+		m_coalescedNotifies[it->second] = std::move(ntf);
+	}
+}
+
+void RpcDriver::flushCoalescedNotifies()
+{
+	if(m_coalescedNotifies.empty())
+		return;
+	logRpcData() << "flushing" << m_coalescedNotifies.size() << "coalesced notifies";
+	std::vector<CoalescedNotify> notifies;
+	notifies.swap(m_coalescedNotifies);
+	m_coalescedNotifyIndex.clear();
+	for(CoalescedNotify &ntf : notifies) {
+		if(ntf.value.isValid())
+			sendRpcValue_helper(ntf.value);
+		else
+			sendRawData_helper(ntf.metaData, std::move(ntf.data));
+	}
+}
+
 RpcMessage RpcDriver::composeRpcMessage(RpcValue::MetaData &&meta_data, const std::string &data, std::string *errmsg)
 {
 	Rpc::ProtocolType packed_data_ver = RpcMessage::protocolType(meta_data);
@@ -119,25 +356,179 @@ void RpcDriver::enqueueDataToSend(RpcDriver::Chunk &&chunk_to_enqueue)
 	/// LOCK_FOR_SEND lock mutex here in the multithreaded environment
 	lockSendQueue();
 	if(!chunk_to_enqueue.empty()) {
-		m_chunkQueue.push_back(std::move(chunk_to_enqueue));
+		if(chunk_to_enqueue.isNotify)
+			m_sendQueueStats.sentNotifies++;
+		m_sendQueueStats.queuedBytes += chunk_to_enqueue.size();
+		if(m_sendQueueStats.queuedBytes > m_sendQueueStats.peakQueuedBytes)
+			m_sendQueueStats.peakQueuedBytes = m_sendQueueStats.queuedBytes;
+		m_chunkQueues[(int)chunk_to_enqueue.priority].push_back(std::move(chunk_to_enqueue));
+		checkSendQueueHighWatermark();
+		updateSendQueueGauges();
 	}
 	if(!isOpen()) {
 		nError() << "write data error, socket is not open!";
+		unlockSendQueue();
 		return;
 	}
 	flush();
-	writeQueue();
+	if(!isWriteBufferFull())
+		writeQueue();
+	else if(sendQueueDepth() > 0)
+		m_metrics.increment(RpcMetrics::Counter::WriteStalls);
 	/// UNLOCK_FOR_SEND unlock mutex here in the multithreaded environment
 	unlockSendQueue();
 }
 
-void RpcDriver::writeQueue()
+void RpcDriver::updateSendQueueGauges()
+{
+	m_metrics.setGauge(RpcMetrics::Gauge::SendQueueDepth, static_cast<int64_t>(sendQueueDepth()));
+	m_metrics.setGauge(RpcMetrics::Gauge::SendQueueBytes, static_cast<int64_t>(m_sendQueueStats.queuedBytes));
+}
+
+size_t RpcDriver::sendQueueDepth() const
+{
+	size_t ret = 0;
+	for(const std::deque<Chunk> &queue : m_chunkQueues)
+		ret += queue.size();
+	return ret;
+}
+
+RpcDriver::MessagePriority RpcDriver::messagePriority(const RpcValue::MetaData &meta_data, size_t message_size) const
+{
+	if(RpcMessage::isRequest(meta_data)) {
+		const RpcValue method = RpcMessage::method(meta_data);
+		const RpcValue::String &m = method.toString();
+		if(m == Rpc::METH_PING || m == Rpc::METH_HELLO || m == Rpc::METH_LOGIN)
+			return MessagePriority::Control;
+	}
+	// big notification must not be overtaken by later one for the same path, notifications are never demoted to bulk lane
+	if(RpcMessage::isNotify(meta_data))
+		return MessagePriority::Notify;
+	if(m_bulkMessageSize > 0 && message_size > m_bulkMessageSize)
+		return MessagePriority::Bulk;
+	return MessagePriority::Response;
+}
+
+void RpcDriver::setSendQueueWatermarks(size_t low_watermark, size_t high_watermark)
+{
+	m_sendQueueLowWatermark = (low_watermark > high_watermark)? high_watermark: low_watermark;
+	m_sendQueueHighWatermark = high_watermark;
+	if(m_sendQueueFull && (m_sendQueueHighWatermark == 0 || m_sendQueueStats.queuedBytes <= m_sendQueueLowWatermark))
+		setSendQueueFull(false);
+}
+
+void RpcDriver::checkSendQueueHighWatermark()
+{
+	if(m_sendQueueHighWatermark == 0 || m_sendQueueStats.queuedBytes <= m_sendQueueHighWatermark)
+		return;
+	switch (m_sendQueueOverflowPolicy) {
+	case SendQueueOverflowPolicy::DropOldestNotify:
+		dropOldestNotifications();
+		if(m_sendQueueStats.queuedBytes > m_sendQueueHighWatermark)
+			setSendQueueFull(true);
+		break;
+	case SendQueueOverflowPolicy::Disconnect:
+		nError() << "send queue overflow, queued bytes:" << m_sendQueueStats.queuedBytes << "high watermark:" << m_sendQueueHighWatermark << "closing connection.";
+		clearSendQueue();
+		onSendQueueOverflow();
+		break;
+	case SendQueueOverflowPolicy::PauseProducer:
+		setSendQueueFull(true);
+		break;
+	}
+}
+
+void RpcDriver::dropOldestNotifications()
+{
+	for(MessagePriority lane : {MessagePriority::Notify, MessagePriority::Bulk}) {
+		std::deque<Chunk> &queue = m_chunkQueues[(int)lane];
+		// partially written chunk must be finished
+		size_t ix = (m_currentSendLane == (int)lane)? 1: 0;
+		while(ix < queue.size() && m_sendQueueStats.queuedBytes > m_sendQueueLowWatermark) {
+			Chunk &chunk = queue[ix];
+			if(chunk.isNotify) {
+				m_sendQueueStats.queuedBytes -= chunk.size();
+				m_sendQueueStats.droppedNotifies++;
+				m_bufferPool.give(std::move(chunk.metaData));
+				m_bufferPool.give(std::move(chunk.data));
+				queue.erase(queue.begin() + ix);
+			}
+			else {
+				ix++;
+			}
+		}
+	}
+	updateSendQueueGauges();
+}
+
+void RpcDriver::clearSendQueue()
 {
-	if(m_chunkQueue.empty())
+	m_coalescedNotifies.clear();
+	m_coalescedNotifyIndex.clear();
+	for(std::deque<Chunk> &queue : m_chunkQueues)
+		queue.clear();
+	for(unsigned &cnt : m_sendLaneWaitCount)
+		cnt = 0;
+	m_currentSendLane = -1;
+	m_topChunkHeaderWritten = false;
+	m_topChunkBytesWrittenSoFar = 0;
+	m_sendQueueStats.queuedBytes = 0;
+	updateSendQueueGauges();
+	setSendQueueFull(false);
+}
+
+void RpcDriver::setSendQueueFull(bool b)
+{
+	if(b == m_sendQueueFull)
 		return;
-	logRpcData() << "writePendingData(), queue len:" << m_chunkQueue.size();
+	m_sendQueueFull = b;
+	if(b)
+		m_sendQueueStats.sendQueueFullCount++;
+	logRpcData() << "send queue full:" << b << "queued bytes:" << m_sendQueueStats.queuedBytes;
+	onSendQueueFullChanged(b);
+}
+
+void RpcDriver::onSendQueueFullChanged(bool is_full)
+{
+	if(m_sendQueueFullChangedCallback)
+		m_sendQueueFullChangedCallback(is_full);
+}
+
+int RpcDriver::nextSendLane()
+{
+	/// lower priority lane gets its turn after this number of messages sent from higher priority lanes
+	static constexpr unsigned MAX_LANE_WAIT_COUNT = 16;
+	int ret = -1;
+	for (int i = 0; i < (int)MessagePriority::Count; ++i) {
+		if(m_chunkQueues[i].empty())
+			continue;
+		if(ret < 0)
+			ret = i;
+		else if(m_sendLaneWaitCount[i] >= MAX_LANE_WAIT_COUNT) {
+			ret = i;
+			break;
+		}
+	}
+	for (int i = 0; i < (int)MessagePriority::Count; ++i) {
+		if(i == ret)
+			m_sendLaneWaitCount[i] = 0;
+		else if(!m_chunkQueues[i].empty())
+			m_sendLaneWaitCount[i]++;
+	}
+	return ret;
+}
+
+void RpcDriver::writeQueue()
+{
+	if(m_currentSendLane < 0) {
+		m_currentSendLane = nextSendLane();
+		if(m_currentSendLane < 0)
+			return;
+	}
+	std::deque<Chunk> &queue = m_chunkQueues[m_currentSendLane];
+	logRpcData() << "writePendingData(), lane:" << m_currentSendLane << "queue len:" << queue.size();
 	//static int hi_cnt = 0;
-	const Chunk &chunk = m_chunkQueue[0];
+	const Chunk &chunk = queue[0];
 
 	if(!m_topChunkHeaderWritten) {
 		std::string protocol_type_data;
@@ -157,6 +548,7 @@ void RpcDriver::writeQueue()
 				SHVCHP_EXCEPTION("Write socket error!");
 			if(len < (int)packet_len_data.length())
 				SHVCHP_EXCEPTION("Design error! Chunk length shall be always written at once to the socket");
+			m_metrics.increment(RpcMetrics::Counter::BytesOut, packet_len_data.length());
 		}
 		{
 			auto len = writeBytes(protocol_type_data.data(), protocol_type_data.length());
@@ -164,6 +556,7 @@ void RpcDriver::writeQueue()
 				SHVCHP_EXCEPTION("Write socket error!");
 			if(len != 1)
 				SHVCHP_EXCEPTION("Design error! Protocol version shall be always written at once to the socket");
+			m_metrics.increment(RpcMetrics::Counter::BytesOut, protocol_type_data.length());
 		}
 		m_topChunkHeaderWritten = true;
 	}
@@ -171,15 +564,26 @@ void RpcDriver::writeQueue()
 		m_topChunkBytesWrittenSoFar += writeBytes_helper(chunk.metaData, m_topChunkBytesWrittenSoFar, chunk.metaData.size() - m_topChunkBytesWrittenSoFar);
 	}
 	if(m_topChunkBytesWrittenSoFar >= chunk.metaData.size()) {
-		m_topChunkBytesWrittenSoFar += writeBytes_helper(chunk.data
+		const std::string &payload = chunk.payload();
+		m_topChunkBytesWrittenSoFar += writeBytes_helper(payload
 														 , m_topChunkBytesWrittenSoFar - chunk.metaData.size()
-														 , chunk.data.size() - (m_topChunkBytesWrittenSoFar - chunk.metaData.size()));
+														 , payload.size() - (m_topChunkBytesWrittenSoFar - chunk.metaData.size()));
 		//logRpc() << "writeQueue - data len:" << chunk.length() << "start index:" << m_topChunkBytesWrittenSoFar << "bytes written:" << len << "remaining:" << (chunk.length() - m_topChunkBytesWrittenSoFar - len);
 	}
 	if(m_topChunkBytesWrittenSoFar == chunk.size()) {
 		m_topChunkHeaderWritten = false;
 		m_topChunkBytesWrittenSoFar = 0;
-		m_chunkQueue.pop_front();
+		Chunk &written_chunk = queue.front();
+		m_metrics.increment(RpcMetrics::Counter::FramesOut);
+		m_metrics.record(RpcMetrics::HistogramId::MessageSizeOut, written_chunk.size());
+		m_sendQueueStats.queuedBytes -= written_chunk.size();
+		m_bufferPool.give(std::move(written_chunk.metaData));
+		m_bufferPool.give(std::move(written_chunk.data));
+		queue.pop_front();
+		m_currentSendLane = -1;
+		updateSendQueueGauges();
+		if(m_sendQueueFull && m_sendQueueStats.queuedBytes <= m_sendQueueLowWatermark)
+			setSendQueueFull(false);
 	}
 }
 
@@ -190,6 +594,9 @@ int64_t RpcDriver::writeBytes_helper(const std::string &str, size_t from, size_t
 		SHVCHP_EXCEPTION("Write socket error!");
 	if(len == 0)
 		SHVCHP_EXCEPTION("Design error! At least 1 byte of data shall be always written to the socket");
+	m_metrics.increment(RpcMetrics::Counter::BytesOut, static_cast<uint64_t>(len));
+	if((size_t)len < length)
+		m_metrics.increment(RpcMetrics::Counter::WriteStalls);
 	return len;
 }
 
@@ -244,9 +651,30 @@ int RpcDriver::processReadData(const std::string &read_data)
 		m_protocolType = protocol_type;
 	}
 
+	m_metrics.increment(RpcMetrics::Counter::FramesIn);
+	m_metrics.increment(RpcMetrics::Counter::BytesIn, read_len);
+	// message size without frame header, the same as MessageSizeOut
+	m_metrics.record(RpcMetrics::HistogramId::MessageSizeIn, read_len - (size_t)in.tellg());
+
 	RpcValue::MetaData meta_data;
-	size_t meta_data_end_pos = decodeMetaData(meta_data, protocol_type, read_data, in.tellg());
+	size_t meta_data_end_pos = in.tellg();
+	if(protocol_type == Rpc::ProtocolType::JsonRpc) {
+		// JSON meta data are members of the same object as message data, parse it once only
+		try {
+			JsonRpcTranscoder::readJsonRpc(read_data, meta_data_end_pos, meta_data, m_receivedJsonRpcData);
+		}
+		catch(AbstractStreamReader::ParseException &e) {
+			m_metrics.increment(RpcMetrics::Counter::DecodeErrors);
+			nError() << "Throwing away invalid JSON-RPC message:" << e.what();
+			return read_len;
+		}
+	}
+	else {
+		meta_data_end_pos = decodeMetaData(meta_data, protocol_type, read_data, meta_data_end_pos);
+	}
 	onRpcDataReceived(protocol_type, std::move(meta_data), read_data, meta_data_end_pos, read_len - meta_data_end_pos);
+	// overridden onRpcDataReceived() might not take it
+	m_receivedJsonRpcData = RpcValue();
 
 	return read_len;
 }
@@ -254,41 +682,22 @@ int RpcDriver::processReadData(const std::string &read_data)
 size_t RpcDriver::decodeMetaData(RpcValue::MetaData &meta_data, Rpc::ProtocolType protocol_type, const std::string &data, size_t start_pos)
 {
 	size_t meta_data_end_pos = start_pos;
-	std::istringstream in(data);
-	in.seekg(start_pos);
 	try {
 		switch (protocol_type) {
 		case Rpc::ProtocolType::JsonRpc: {
-			CponReader rd(in);
-			RpcValue msg;
-			rd.read(msg);
-			if(!msg.isMap()) {
-				nError() << "JSON message cannot be translated to ChainPack";
-			}
-			else {
-				const RpcValue::Map &map = msg.toMap();
-				unsigned id = map.value(Rpc::JSONRPC_ID).toUInt();
-				unsigned caller_id = map.value(Rpc::JSONRPC_CALLER_ID).toUInt();
-				RpcValue::String method = map.value(Rpc::JSONRPC_METHOD).toString();
-				std::string shv_path = map.value(Rpc::JSONRPC_SHV_PATH).toString();
-				if(id > 0)
-					RpcMessage::setRequestId(meta_data, id);
-				if(!method.empty())
-					RpcMessage::setMethod(meta_data, method);
-				if(!shv_path.empty())
-					RpcMessage::setShvPath(meta_data, shv_path);
-				if(caller_id > 0)
-					RpcMessage::setCallerIds(meta_data, caller_id);
-			}
+			RpcValue msg_data;
+			JsonRpcTranscoder::readJsonRpc(data, start_pos, meta_data, msg_data);
 			break;
 		}
 		case Rpc::ProtocolType::Cpon: {
-			CponReader rd(in);
+			CponBufferReader rd(data, start_pos);
 			rd.read(meta_data);
-			meta_data_end_pos = (in.tellg() < 0)? data.size(): (size_t)in.tellg();
+			meta_data_end_pos = rd.pos();
 			break;
 		}
 		case Rpc::ProtocolType::ChainPack: {
+			std::istringstream in(data);
+			in.seekg(start_pos);
 			ChainPackReader rd(in);
 			rd.read(meta_data);
 			meta_data_end_pos = (in.tellg() < 0)? data.size(): (size_t)in.tellg();
@@ -300,7 +709,7 @@ size_t RpcDriver::decodeMetaData(RpcValue::MetaData &meta_data, Rpc::ProtocolTyp
 			break;
 		}
 	}
-	catch(CponReader::ParseException &e) {
+	catch(AbstractStreamReader::ParseException &e) {
 		nError() << e.what();
 	}
 	return meta_data_end_pos;
@@ -309,39 +718,21 @@ size_t RpcDriver::decodeMetaData(RpcValue::MetaData &meta_data, Rpc::ProtocolTyp
 RpcValue RpcDriver::decodeData(Rpc::ProtocolType protocol_type, const std::string &data, size_t start_pos)
 {
 	RpcValue ret;
-	std::istringstream in(data);
-	in.seekg(start_pos);
 	try {
 		switch (protocol_type) {
 		case Rpc::ProtocolType::JsonRpc: {
-			CponReader rd(in);
-			rd.read(ret);
-			RpcValue::Map map = ret.toMap();
-			RpcValue::IMap imap;
-			RpcValue params = map.value(Rpc::JSONRPC_PARAMS);
-			if(params.isValid()) {
-				imap[RpcMessage::MetaType::Key::Params] = params;
-			}
-			else {
-				RpcValue result = map.value(Rpc::JSONRPC_RESULT);
-				if(result.isValid()) {
-					imap[RpcMessage::MetaType::Key::Result] = result;
-				}
-				else {
-					RpcValue error = map.value(Rpc::JSONRPC_ERROR);
-					if(error.isValid())
-						imap[RpcMessage::MetaType::Key::Error] = error;
-				}
-			}
-			ret = imap;
+			RpcValue::MetaData meta_data;
+			JsonRpcTranscoder::readJsonRpc(data, start_pos, meta_data, ret);
 			break;
 		}
 		case Rpc::ProtocolType::Cpon: {
-			CponReader rd(in);
+			CponBufferReader rd(data, start_pos);
 			rd.read(ret);
 			break;
 		}
 		case Rpc::ProtocolType::ChainPack: {
+			std::istringstream in(data);
+			in.seekg(start_pos);
 			ChainPackReader rd(in);
 			rd.read(ret);
 			break;
@@ -351,7 +742,7 @@ RpcValue RpcDriver::decodeData(Rpc::ProtocolType protocol_type, const std::strin
 			break;
 		}
 	}
-	catch(CponReader::ParseException &e) {
+	catch(AbstractStreamReader::ParseException &e) {
 		nError() << e.what();
 	}
 	return ret;
@@ -359,42 +750,20 @@ RpcValue RpcDriver::decodeData(Rpc::ProtocolType protocol_type, const std::strin
 
 std::string RpcDriver::codeRpcValue(Rpc::ProtocolType protocol_type, const RpcValue &val)
 {
-	std::ostringstream os_packed_data;
+	std::string packed_data;
+	if(protocol_type == Rpc::ProtocolType::ChainPack)
+		packed_data.reserve(ChainPackWriter::encodedSize(val));
+	codeRpcValue(protocol_type, val, packed_data);
+	return packed_data;
+}
+
+void RpcDriver::codeRpcValue(Rpc::ProtocolType protocol_type, const RpcValue &val, std::string &out_data)
+{
+	StringOutBuf buf(out_data);
+	std::ostream os_packed_data(&buf);
 	switch (protocol_type) {
 	case Rpc::ProtocolType::JsonRpc: {
-		RpcValue::Map json_msg;
-		RpcMessage rpc_msg(val);
-
-		const RpcValue rq_id = rpc_msg.requestId();
-		if(rq_id.isValid())
-			json_msg[Rpc::JSONRPC_ID] = rq_id;
-
-		const RpcValue shv_path = rpc_msg.shvPath();
-		if(shv_path.isString())
-			json_msg[Rpc::JSONRPC_SHV_PATH] = shv_path.toString();
-
-		const RpcValue caller_id = rpc_msg.callerIds();
-		if(caller_id.isValid())
-			json_msg[Rpc::JSONRPC_CALLER_ID] = caller_id;
-					;
-		if(rpc_msg.isResponse()) {
-			// response
-			RpcResponse resp(rpc_msg);
-			if(resp.isError())
-				json_msg[Rpc::JSONRPC_ERROR] = resp.error().toJson();
-			else
-				json_msg[Rpc::JSONRPC_RESULT] = resp.result();
-		}
-		else {
-			// request
-			RpcRequest rq(rpc_msg);
-			json_msg[Rpc::JSONRPC_METHOD] = rq.method();
-			json_msg[Rpc::JSONRPC_PARAMS] = rq.params();
-		}
-		CponWriterOptions opts;
-		opts.setJsonFormat(true);
-		CponWriter wr(os_packed_data, opts);
-		wr.write(json_msg);
+		JsonRpcTranscoder::writeJsonRpc(os_packed_data, val.metaData(), val);
 		break;
 	}
 	case Rpc::ProtocolType::Cpon: {
@@ -410,20 +779,56 @@ std::string RpcDriver::codeRpcValue(Rpc::ProtocolType protocol_type, const RpcVa
 	default:
 		SHVCHP_EXCEPTION("Cannot serialize data without protocol version specified.")
 	}
-	return os_packed_data.str();
+}
+
+void RpcDriver::transcodeData(Rpc::ProtocolType from_protocol, Rpc::ProtocolType to_protocol, const std::string &data, std::string &out_data)
+{
+	size_t out_data_size = out_data.size();
+	try {
+		StringOutBuf buf(out_data);
+		std::ostream os_packed_data(&buf);
+		if(from_protocol == Rpc::ProtocolType::ChainPack && to_protocol == Rpc::ProtocolType::Cpon) {
+			DataTranscoder::chainPackToCpon(data, 0, os_packed_data);
+			return;
+		}
+		if(from_protocol == Rpc::ProtocolType::Cpon && to_protocol == Rpc::ProtocolType::ChainPack) {
+			DataTranscoder::cponToChainPack(data, 0, os_packed_data);
+			return;
+		}
+	}
+	catch(AbstractStreamReader::ParseException &e) {
+		nError() << e.what();
+		out_data.resize(out_data_size);
+	}
+	RpcValue val = decodeData(from_protocol, data, 0);
+	codeRpcValue(to_protocol, val, out_data);
 }
 
 void RpcDriver::onRpcDataReceived(Rpc::ProtocolType protocol_type, RpcValue::MetaData &&md, const std::string &data, size_t start_pos, size_t data_len)
 {
 	//nInfo() << __FILE__ << RCV_LOG_ARROW << md.toStdString() << shv::chainpack::Utils::toHexElided(data, start_pos, 100);
 	(void)data_len;
-	RpcValue msg = decodeData(protocol_type, data, start_pos);
+	int64_t start_usec = RpcMetrics::startTiming();
+	RpcValue msg;
+	if(protocol_type == Rpc::ProtocolType::JsonRpc && m_receivedJsonRpcData.isValid())
+		msg = std::move(m_receivedJsonRpcData);
+	else
+		msg = decodeData(protocol_type, data, start_pos);
+	m_metrics.recordTiming(RpcMetrics::HistogramId::DecodeTimeUsec, start_usec);
 	if(msg.isValid()) {
 		msg.setMetaData(std::move(md));
 		logRpcMsg() << RCV_LOG_ARROW << msg.toPrettyString();
+		if(!m_pendingRequests.isEmpty() && RpcMessage::isResponse(msg.metaData())) {
+			// response with caller ids is forwarded to other peer, its request id can collide with own request
+			RpcValue caller_ids = RpcMessage::callerIds(msg.metaData());
+			bool is_forwarded = caller_ids.isValid() && !(caller_ids.isList() && caller_ids.toList().empty());
+			if(!is_forwarded && m_pendingRequests.processResponse(RpcResponse(RpcMessage(msg))))
+				return;
+		}
 		onRpcValueReceived(msg);
 	}
 	else {
+		m_metrics.increment(RpcMetrics::Counter::DecodeErrors);
 		nError() << "Throwing away message with unknown protocol version:" << (unsigned)protocol_type;
 	}
 }
@@ -3,17 +3,25 @@
 #include "../shvchainpackglobal.h"
 #include "rpcmessage.h"
 #include "rpc.h"
+#include "pendingrpcrequests.h"
+#include "rpccall.h"
+#include "rpcmetrics.h"
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <deque>
 #include <map>
+#include <vector>
 
 namespace shv {
 namespace chainpack {
 
+class EncodedMessage;
+
 class SHVCHAINPACK_DECL_EXPORT RpcDriver
 {
+	friend class EncodedMessage;
 public:
 	static const char * SND_LOG_ARROW;
 	static const char * RCV_LOG_ARROW;
@@ -25,28 +33,167 @@ public:
 	void setProtocolType(Rpc::ProtocolType v) {m_protocolType = v;}
 
 	void sendRpcValue(const RpcValue &msg);
+	/// message data encoded for driver protocol are queued by reference, they are shared with other drivers
+	void sendEncodedMessage(const EncodedMessage &msg);
 	void sendRawData(std::string &&data);
 	void sendRawData(const RpcValue::MetaData &meta_data, std::string &&data);
+	/// notification data transcoded by sendRawData() for one driver are reused by the other drivers
+	/// while the scope exists, create it on stack around the loop forwarding notification to subscribers,
+	/// cached data are released when the outermost scope ends
+	class SHVCHAINPACK_DECL_EXPORT NotifyFanOutScope
+	{
+	public:
+		NotifyFanOutScope();
+		~NotifyFanOutScope();
+		NotifyFanOutScope(const NotifyFanOutScope &) = delete;
+		NotifyFanOutScope& operator=(const NotifyFanOutScope &) = delete;
+	};
 	using MessageReceivedCallback = std::function< void (const RpcValue &msg)>;
 	void setMessageReceivedCallback(const MessageReceivedCallback &callback) {m_messageReceivedCallback = callback;}
 
+	/// responses to requests registered in pending requests table are delivered to their callbacks
+	/// instead of MessageReceivedCallback
+	PendingRpcRequests& pendingRequests() {return m_pendingRequests;}
+	/// send request and register callback for its response
+	/// time_out_ms == 0 means defaultRpcTimeout(), time_out_ms < 0 means no timeout
+	void sendRpcRequest(const RpcRequest &request, PendingRpcRequests::ResponseCallback &&callback, int time_out_ms = 0);
+#ifdef SHVCHAINPACK_HAS_COROUTINES
+	/// co_await driver.sendRpcRequest(rq), coroutine is resumed from driver's receive/timeout processing
+	/// RpcCall can outlive the driver, it must be destroyed in the driver thread then
+	RpcCall sendRpcRequest(const RpcRequest &request, int time_out_ms = 0)
+	{
+		std::weak_ptr<PendingRpcRequests*> pending_requests = m_pendingRequestsHandle;
+		return RpcCall([&](RpcCall::ResponseCallback &&callback) {
+			sendRpcRequest(request, std::move(callback), time_out_ms);
+			return request.requestId().toUInt();
+		}, [pending_requests](unsigned request_id) {
+			if(std::shared_ptr<PendingRpcRequests*> pending = pending_requests.lock())
+				(*pending)->cancelRequest(request_id);
+		});
+	}
+#endif
+
+	/// maximal size of encoded message, 0 means unlimited
+	size_t maxMessageSize() const {return m_maxMessageSize;}
+	void setMaxMessageSize(size_t n) {m_maxMessageSize = n;}
+
 	static int defaultRpcTimeout() {return s_defaultRpcTimeout;}
 	static void setDefaultRpcTimeout(int tm) {s_defaultRpcTimeout = tm;}
 
 	static RpcMessage composeRpcMessage(RpcValue::MetaData &&meta_data, const std::string &data, std::string *errmsg = nullptr);
+
+	struct SendQueueStats
+	{
+		uint64_t bufferPoolHits = 0;
+		uint64_t bufferPoolMisses = 0;
+		size_t queuedBytes = 0;
+		size_t peakQueuedBytes = 0;
+		uint64_t droppedNotifies = 0;
+		/// notifies replaced by newer value before they were sent
+		uint64_t mergedNotifies = 0;
+		uint64_t sentNotifies = 0;
+		/// how many times the send queue has exceeded high watermark
+		uint64_t sendQueueFullCount = 0;
+		/// notifications sent without transcoding, because the same data were transcoded for another connection
+		uint64_t transcodeCacheHits = 0;
+
+		double bufferPoolHitRate() const
+		{
+			uint64_t n = bufferPoolHits + bufferPoolMisses;
+			return n? (double)bufferPoolHits / n: 0;
+		}
+	};
+	const SendQueueStats& sendQueueStats() const {return m_sendQueueStats;}
+
+	/// traffic counters and histograms, can be read from any thread, see RpcMetrics::globalSnapshot()
+	RpcMetrics& metrics() {return m_metrics;}
+	const RpcMetrics& metrics() const {return m_metrics;}
+
+	/// what to do when queued bytes exceed high watermark
+	enum class SendQueueOverflowPolicy {
+		PauseProducer, /// report send queue full until queued bytes drop under low watermark
+		DropOldestNotify, /// drop oldest unsent notifications, pause producer if it is not enough
+		Disconnect, /// close the connection
+	};
+	/// high_watermark == 0 means unbounded send queue
+	void setSendQueueWatermarks(size_t low_watermark, size_t high_watermark);
+	size_t sendQueueLowWatermark() const {return m_sendQueueLowWatermark;}
+	size_t sendQueueHighWatermark() const {return m_sendQueueHighWatermark;}
+	SendQueueOverflowPolicy sendQueueOverflowPolicy() const {return m_sendQueueOverflowPolicy;}
+	void setSendQueueOverflowPolicy(SendQueueOverflowPolicy p) {m_sendQueueOverflowPolicy = p;}
+
+	/// Send queue lanes, lane with lower number is sent first.
+	/// Lanes are switched on message boundaries only.
+	enum class MessagePriority {
+		Control = 0, /// hello, login, ping
+		Response, /// responses and requests
+		Notify,
+		Bulk, /// responses and requests bigger than bulkMessageSize()
+		Count
+	};
+	/// responses and requests bigger than this are sent in MessagePriority::Bulk lane, 0 means no bulk lane,
+	/// notifications stay in MessagePriority::Notify lane to be delivered in order
+	size_t bulkMessageSize() const {return m_bulkMessageSize;}
+	void setBulkMessageSize(size_t n) {m_bulkMessageSize = n;}
+	/// number of messages waiting in send queue
+	size_t sendQueueDepth() const;
+	size_t sendQueueDepth(MessagePriority priority) const {return m_chunkQueues[(int)priority].size();}
+	size_t sendQueueBytes() const {return m_sendQueueStats.queuedBytes;}
+	/// producers should not send more messages when send queue is full
+	bool isSendQueueFull() const {return m_sendQueueFull;}
+	using SendQueueFullChangedCallback = std::function< void (bool is_full)>;
+	void setSendQueueFullChangedCallback(const SendQueueFullChangedCallback &callback) {m_sendQueueFullChangedCallback = callback;}
+
+	/// Value change notifies (Rpc::NTF_VAL_CHANGED) are held for msec before they are sent,
+	/// held notify for the same shvPath and method is replaced by the newer one.
+	/// 0 disables coalescing.
+	int notifyCoalescingWindow() const {return m_notifyCoalescingWindow;}
+	void setNotifyCoalescingWindow(int msec);
+	/// send all held notifies
+	void flushCoalescedNotifies();
+	size_t coalescedNotifiesCount() const {return m_coalescedNotifies.size();}
+protected:
+	/// Recycles chunk buffers to avoid malloc/free per message on the send path.
+	/// Buffers are sorted to size classes by capacity, each class keeps at most MAX_CLASS_BUFFERS buffers.
+	class SHVCHAINPACK_DECL_EXPORT BufferPool
+	{
+	public:
+		static constexpr size_t MIN_CLASS_CAPACITY = 128;
+		static constexpr size_t CLASS_COUNT = 6;
+		static constexpr size_t MAX_CLASS_BUFFERS = 16;
+
+		BufferPool(SendQueueStats &stats) : m_stats(stats) {}
+
+		/// @return empty buffer with capacity at least size_hint
+		std::string take(size_t size_hint);
+		void give(std::string &&buff);
+	private:
+		static size_t classCapacity(size_t class_ix) {return MIN_CLASS_CAPACITY << (2 * class_ix);}
+	private:
+		SendQueueStats &m_stats;
+		std::vector<std::string> m_buffers[CLASS_COUNT];
+	};
 protected:
 	struct Chunk
 	{
 		std::string metaData;
 		std::string data;
+		/// encoded message shared with other drivers, it is sent instead of data
+		std::shared_ptr<const std::string> sharedData;
+		/// notifications can be dropped from full send queue
+		bool isNotify = false;
+		MessagePriority priority = MessagePriority::Response;
 
 		Chunk() {}
 		Chunk(std::string &&meta_data, std::string &&data) : metaData(std::move(meta_data)), data(std::move(data)) {}
 		Chunk(std::string &&data) : data(std::move(data)) {}
+		Chunk(std::shared_ptr<const std::string> &&shared_data) : sharedData(std::move(shared_data)) {}
 		Chunk(Chunk &&) = default;
+		Chunk& operator=(Chunk &&) = default;
 
-		bool empty() const {return metaData.empty() && data.empty();}
-		size_t size() const {return metaData.size() + data.size();}
+		const std::string& payload() const {return sharedData? *sharedData: data;}
+		bool empty() const {return metaData.empty() && payload().empty();}
+		size_t size() const {return metaData.size() + payload().size();}
 	};
 protected:
 	virtual bool isOpen() = 0;
@@ -68,20 +215,78 @@ protected:
 	static size_t decodeMetaData(RpcValue::MetaData &meta_data, Rpc::ProtocolType protocol_type, const std::string &data, size_t start_pos);
 	static RpcValue decodeData(Rpc::ProtocolType protocol_type, const std::string &data, size_t start_pos);
 	static std::string codeRpcValue(Rpc::ProtocolType protocol_type, const RpcValue &val);
+	/// append encoded val to out_data
+	static void codeRpcValue(Rpc::ProtocolType protocol_type, const RpcValue &val, std::string &out_data);
+	/// append data transcoded from from_protocol to to_protocol to out_data,
+	/// ChainPack and Cpon are transcoded directly without RpcValue
+	static void transcodeData(Rpc::ProtocolType from_protocol, Rpc::ProtocolType to_protocol, const std::string &data, std::string &out_data);
 
 	virtual void lockSendQueue() {}
 	virtual void unlockSendQueue() {}
+	/// @return true if write buffer cannot accept more data, data will stay in send queue then
+	virtual bool isWriteBufferFull() {return false;}
+
+	virtual void onSendQueueFullChanged(bool is_full);
+	/// first notify is held by coalescing, flushCoalescedNotifies() should be called after msec
+	virtual void onCoalescedNotifyPending(int msec) {(void)msec;}
+	/// called with SendQueueOverflowPolicy::Disconnect, the connection should be closed
+	virtual void onSendQueueOverflow() {}
+	void clearSendQueue();
 private:
+	struct CoalescedNotify
+	{
+		RpcValue value;
+		/// raw notify meta data and data, if value is not valid
+		RpcValue::MetaData metaData;
+		std::string data;
+	};
+	static constexpr size_t MAX_COALESCED_NOTIFIES = 1024;
+
+	void sendRpcValue_helper(const RpcValue &msg);
+	void sendRawData_helper(const RpcValue::MetaData &meta_data, std::string &&data);
+	static bool isCoalescedNotify(const RpcValue::MetaData &meta_data);
+	void coalesceNotify(CoalescedNotify &&ntf);
+
 	int processReadData(const std::string &read_data);
+	void checkSendQueueHighWatermark();
+	void updateSendQueueGauges();
+	void setSendQueueFull(bool b);
+	void dropOldestNotifications();
+	MessagePriority messagePriority(const RpcValue::MetaData &meta_data, size_t message_size) const;
+	int nextSendLane();
 	void writeQueue();
 	int64_t writeBytes_helper(const std::string &str, size_t from, size_t length);
 private:
 	MessageReceivedCallback m_messageReceivedCallback = nullptr;
-	std::deque<Chunk> m_chunkQueue;
+	RpcMetrics m_metrics;
+	PendingRpcRequests m_pendingRequests;
+	/// expires before m_pendingRequests is destroyed, RpcCall-s cancel requests through it
+	std::shared_ptr<PendingRpcRequests*> m_pendingRequestsHandle;
+	SendQueueStats m_sendQueueStats;
+	BufferPool m_bufferPool;
+	std::deque<Chunk> m_chunkQueues[(int)MessagePriority::Count];
+	/// lane of partially written chunk, -1 if no chunk is being written
+	int m_currentSendLane = -1;
+	/// number of messages sent from higher priority lanes while lane was not empty
+	unsigned m_sendLaneWaitCount[(int)MessagePriority::Count] = {};
+	size_t m_bulkMessageSize = 64 * 1024;
 	bool m_topChunkHeaderWritten = false;
 	size_t m_topChunkBytesWrittenSoFar = 0;
 	std::string m_readData;
+	/// JSON-RPC message data parsed together with meta data in processReadData(),
+	/// valid during onRpcDataReceived() call only
+	RpcValue m_receivedJsonRpcData;
 	Rpc::ProtocolType m_protocolType = Rpc::ProtocolType::Invalid;
+	size_t m_maxMessageSize = 0;
+	size_t m_sendQueueLowWatermark = 0;
+	size_t m_sendQueueHighWatermark = 0;
+	SendQueueOverflowPolicy m_sendQueueOverflowPolicy = SendQueueOverflowPolicy::PauseProducer;
+	bool m_sendQueueFull = false;
+	SendQueueFullChangedCallback m_sendQueueFullChangedCallback = nullptr;
+	int m_notifyCoalescingWindow = 0;
+	std::vector<CoalescedNotify> m_coalescedNotifies;
+	/// shvPath:method -> index to m_coalescedNotifies
+	std::map<std::string, size_t> m_coalescedNotifyIndex;
 	static int s_defaultRpcTimeout;
 };
 
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <necrolog.h>
+
+/// Log topic is checked before the statement arguments are evaluated,
+/// expensive formatting like toPrettyString() or hexDump() costs nothing when the topic is disabled.
+#ifdef NECROLOG_NO_DEBUG_LOG
+#define nCDebugLazy(topic) while(false) nCDebug(topic)
+#else
+#define nCDebugLazy(topic) for(bool en = NecroLog::shouldLog(NecroLog::Level::Debug, NecroLog::LogContext(__FILE__, __LINE__, topic)); en; en = false) nCDebug(topic)
+#endif
+
+#define logRpcMsg() nCDebugLazy("RpcMsg")
+#define logRpcData() nCDebugLazy("RpcData")
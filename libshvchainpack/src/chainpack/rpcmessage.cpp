@@ -1,6 +1,7 @@
 #include "rpcmessage.h"
 #include "chainpack.h"
 #include "metatypes.h"
+#include "metastruct.h"
 #include "abstractstreamwriter.h"
 
 #include <cassert>
@@ -8,34 +9,83 @@
 namespace shv {
 namespace chainpack {
 
+namespace {
+
+using Tag = RpcMessage::MetaType::Tag;
+using Key = RpcMessage::MetaType::Key;
+
+constexpr meta::MetaInfo rpc_message_tags[] = {
+	{(int)Tag::RequestId, "id"},
+	{(int)Tag::ShvPath, "shvPath"},
+	{(int)Tag::Method, "method"},
+	{(int)Tag::CallerIds, "callerIds"},
+	{(int)Tag::ProtocolType, "protocol"},
+	{(int)Tag::TunnelHandle, "tunnelHandle"},
+};
+static_assert(meta::MetaInfoTable(rpc_message_tags, Tag::RequestId).isConsecutive(), "RpcMessage tags table is not consecutive");
+
+constexpr meta::MetaInfo rpc_message_keys[] = {
+	{(int)Key::Params, "params"},
+	{(int)Key::Result, "result"},
+	{(int)Key::Error, "error"},
+	{(int)Key::ErrorCode, "errorCode"},
+	{(int)Key::ErrorMessage, "errorMessage"},
+};
+static_assert(meta::MetaInfoTable(rpc_message_keys, Key::Params).isConsecutive(), "RpcMessage keys table is not consecutive");
+
+using HeaderSchema = meta::StructSchema<
+	SHV_META_FIELD(meta::Tag::MetaTypeId, RpcMessage::Header, metaTypeId),
+	SHV_META_FIELD(Tag::RequestId, RpcMessage::Header, requestId),
+	SHV_META_FIELD(Tag::ShvPath, RpcMessage::Header, shvPath),
+	SHV_META_FIELD(Tag::Method, RpcMessage::Header, method),
+	SHV_META_FIELD(Tag::CallerIds, RpcMessage::Header, callerIds),
+	SHV_META_FIELD(Tag::ProtocolType, RpcMessage::Header, protocolType),
+	SHV_META_FIELD(Tag::TunnelHandle, RpcMessage::Header, tunnelHandle)
+>;
+
+}
+
 RpcMessage::MetaType::MetaType()
-	: Super("RpcMessage")
-{
-	m_keys = {
-		{(int)Key::Params, {(int)Key::Params, "params"}},
-		{(int)Key::Result, {(int)Key::Result, "result"}},
-		{(int)Key::Error, {(int)Key::Error, "error"}},
-		{(int)Key::ErrorCode, {(int)Key::ErrorCode, "errorCode"}},
-		{(int)Key::ErrorMessage, {(int)Key::ErrorMessage, "errorMessage"}},
-	};
-	m_tags = {
-		{(int)Tag::RequestId, {(int)Tag::RequestId, "id"}},
-		{(int)Tag::ShvPath, {(int)Tag::ShvPath, "shvPath"}},
-		{(int)Tag::Method, {(int)Tag::Method, "method"}},
-		{(int)Tag::CallerIds, {(int)Tag::CallerIds, "callerIds"}},
-		{(int)Tag::ProtocolType, {(int)Tag::ProtocolType, "protocol"}},
-		{(int)Tag::TunnelHandle, {(int)Tag::TunnelHandle, Rpc::KEY_TUNNEL_HANDLE}},
-	};
+	: Super("RpcMessage", meta::MetaInfoTable(rpc_message_tags, Tag::RequestId), meta::MetaInfoTable(rpc_message_keys, Key::Params))
+{
 }
 
 void RpcMessage::MetaType::registerMetaType()
 {
-	static bool is_init = false;
-	if(!is_init) {
-		is_init = true;
-		static MetaType s;
-		meta::registerType(meta::GlobalNS::ID, MetaType::ID, &s);
-	}
+	// RpcMessage is registered by meta types registry itself on its first use
+	(void)meta::registeredType(meta::GlobalNS::ID, MetaType::ID);
+}
+
+//==================================================================
+// RpcMessage::Header
+//==================================================================
+RpcMessage::Header RpcMessage::Header::fromMetaData(const RpcValue::MetaData &meta)
+{
+	Header ret;
+	HeaderSchema::fromIMap(meta.iValues(), ret);
+	return ret;
+}
+
+RpcValue::MetaData RpcMessage::Header::toMetaData() const
+{
+	return RpcValue::MetaData(HeaderSchema::toIMap(*this));
+}
+
+void RpcMessage::Header::write(ChainPackWriter &wr) const
+{
+	if(HeaderSchema::isEmpty(*this))
+		return;
+	wr.writeMetaDataBegin();
+	HeaderSchema::writeEntries(wr, *this);
+	wr.writeContainerEnd();
+}
+
+RpcMessage::Header RpcMessage::Header::read(ChainPackReader &rd)
+{
+	Header ret;
+	while(rd.readMetaDataBegin())
+		HeaderSchema::readEntries(rd, ret);
+	return ret;
 }
 
 //==================================================================
@@ -45,7 +95,6 @@ bool RpcMessage::m_isMetaTypeExplicit = false;
 
 RpcMessage::RpcMessage()
 {
-	MetaType::registerMetaType();
 }
 
 RpcMessage::RpcMessage(const RpcValue &val)
@@ -196,6 +245,13 @@ void RpcMessage::setCallerIds(RpcValue::MetaData &meta, const RpcValue &caller_i
 
 void RpcMessage::pushCallerId(RpcValue::MetaData &meta, RpcValue::UInt caller_id)
 {
+	// caller ids array owned by meta only is modified in place, every broker hop would allocate new one otherwise
+	RpcValue *caller_ids = meta.valueRef(RpcMessage::MetaType::Tag::CallerIds);
+	RpcValue::Array *array = caller_ids? caller_ids->uniqueArray(): nullptr;
+	if(array && array->type() == RpcValue::Type::UInt) {
+		array->push_back(RpcValue::ArrayElement(caller_id));
+		return;
+	}
 	RpcValue curr_caller_id = RpcMessage::callerIds(meta);
 	if(curr_caller_id.isArray()) {
 		RpcValue::Array array = curr_caller_id.toArray();
@@ -234,6 +290,15 @@ RpcValue RpcMessage::popCallerId(const RpcValue &caller_ids, RpcValue::UInt &id)
 
 RpcValue::UInt RpcMessage::popCallerId(RpcValue::MetaData &meta)
 {
+	RpcValue *caller_ids = meta.valueRef(RpcMessage::MetaType::Tag::CallerIds);
+	RpcValue::Array *array = caller_ids? caller_ids->uniqueArray(): nullptr;
+	if(array) {
+		if(array->empty())
+			return 0;
+		RpcValue::UInt ret = array->back().uint_value;
+		array->pop_back();
+		return ret;
+	}
 	RpcValue::UInt ret = 0;
 	setCallerIds(meta, popCallerId(callerIds(meta), ret));
 	return ret;
@@ -413,12 +478,13 @@ RpcResponse& RpcResponse::setResult(const RpcValue& res)
 RpcResponse::Error::ErrorType RpcResponse::Error::code() const
 {
 	auto iter = find(KeyCode);
-	return (iter == end()) ? NoError : (ErrorType)(iter->second.toUInt());
+	return (iter == end()) ? NoError : (ErrorType)(iter->second.toInt());
 }
 
 RpcResponse::Error& RpcResponse::Error::setCode(ErrorType c)
 {
-	(*this)[KeyCode] = RpcValue{(RpcValue::UInt)c};
+	// JSON-RPC error codes are negative
+	(*this)[KeyCode] = RpcValue{(RpcValue::Int)c};
 	return *this;
 }
 
@@ -7,11 +7,14 @@
 #include "../shvchainpackglobal.h"
 
 #include <functional>
+#include <vector>
 
 namespace shv {
 namespace chainpack {
 
 class AbstractStreamWriter;
+class ChainPackReader;
+class ChainPackWriter;
 
 class SHVCHAINPACK_DECL_EXPORT RpcMessage
 {
@@ -34,6 +37,29 @@ public:
 
 		static void registerMetaType();
 	};
+	/// typed meta data of message, read and written from ChainPack without MetaData maps,
+	/// request id must be UInt, fields not set are not written.
+	/// Use read() where it replaces decoding of whole MetaData, MetaData lookups are cheaper when MetaData exists already.
+	struct SHVCHAINPACK_DECL_EXPORT Header
+	{
+		meta::Optional<RpcValue::Int> metaTypeId;
+		meta::Optional<RpcValue::UInt> requestId;
+		meta::Optional<RpcValue::String> shvPath;
+		meta::Optional<RpcValue::String> method;
+		meta::Optional<std::vector<RpcValue::UInt>> callerIds;
+		meta::Optional<RpcValue::UInt> protocolType;
+		RpcValue tunnelHandle;
+
+		bool isRequest() const {return requestId.isSet() && !method.value().empty();}
+		bool isResponse() const {return requestId.isSet() && method.value().empty();}
+		bool isNotify() const {return !requestId.isSet() && !method.value().empty();}
+
+		static Header fromMetaData(const RpcValue::MetaData &meta);
+		RpcValue::MetaData toMetaData() const;
+		void write(ChainPackWriter &wr) const;
+		/// entries of all the meta data IMaps are read, meta data with string keys is skipped
+		static Header read(ChainPackReader &rd);
+	};
 public:
 	RpcMessage();
 	RpcMessage(const RpcValue &val);
@@ -0,0 +1,284 @@
+#include "rpcmetrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace shv {
+namespace chainpack {
+
+constexpr size_t RpcMetrics::Histogram::BUCKET_COUNT;
+
+std::atomic<bool> RpcMetrics::s_timingEnabled(true);
+
+namespace {
+struct Registry
+{
+	std::mutex mutex;
+	std::vector<RpcMetrics*> metrics;
+	/// totals of destroyed metrics
+	RpcMetrics::Snapshot retired;
+};
+
+Registry& registry()
+{
+	static Registry s_registry;
+	return s_registry;
+}
+
+size_t bucket_index(uint64_t value)
+{
+	size_t ix;
+#ifdef __GNUC__
+	ix = value? 64 - __builtin_clzll(value): 0;
+#else
+	ix = 0;
+	while(value) {
+		value >>= 1;
+		ix++;
+	}
+#endif
+	return ix < RpcMetrics::Histogram::BUCKET_COUNT? ix: RpcMetrics::Histogram::BUCKET_COUNT - 1;
+}
+
+uint64_t relaxed_load(const std::atomic<uint64_t> &a)
+{
+	return a.load(std::memory_order_relaxed);
+}
+}
+
+//==========================================================
+// RpcMetrics::Histogram
+//==========================================================
+RpcMetrics::Histogram::Histogram()
+	: m_count(0)
+	, m_sum(0)
+	, m_max(0)
+{
+	for(std::atomic<uint64_t> &b : m_buckets)
+		b.store(0, std::memory_order_relaxed);
+}
+
+void RpcMetrics::Histogram::record(uint64_t value)
+{
+	m_buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(value, std::memory_order_relaxed);
+	uint64_t max = m_max.load(std::memory_order_relaxed);
+	while(value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		;
+}
+
+RpcMetrics::Histogram::Snapshot RpcMetrics::Histogram::snapshot() const
+{
+	Snapshot ret;
+	ret.count = relaxed_load(m_count);
+	ret.sum = relaxed_load(m_sum);
+	ret.max = relaxed_load(m_max);
+	for(size_t i = 0; i < BUCKET_COUNT; i++)
+		ret.buckets[i] = relaxed_load(m_buckets[i]);
+	return ret;
+}
+
+void RpcMetrics::Histogram::Snapshot::add(const Snapshot &o)
+{
+	count += o.count;
+	sum += o.sum;
+	max = std::max(max, o.max);
+	for(size_t i = 0; i < BUCKET_COUNT; i++)
+		buckets[i] += o.buckets[i];
+}
+
+uint64_t RpcMetrics::Histogram::Snapshot::percentile(double p) const
+{
+	// buckets are read one by one, count can differ from their sum slightly
+	uint64_t total = 0;
+	for(uint64_t b : buckets)
+		total += b;
+	if(total == 0)
+		return 0;
+	uint64_t rank = static_cast<uint64_t>(p * total + 0.5);
+	if(rank == 0)
+		rank = 1;
+	uint64_t n = 0;
+	for(size_t i = 0; i < BUCKET_COUNT; i++) {
+		n += buckets[i];
+		if(n >= rank) {
+			if(i == 0)
+				return 0;
+			uint64_t upper = (i + 1 < BUCKET_COUNT)? (((uint64_t)1 << i) - 1): max;
+			return std::min(upper, max);
+		}
+	}
+	return max;
+}
+
+RpcValue RpcMetrics::Histogram::Snapshot::toRpcValue() const
+{
+	RpcValue::List lst;
+	// trailing empty buckets are omitted
+	size_t n = BUCKET_COUNT;
+	while(n > 0 && buckets[n - 1] == 0)
+		n--;
+	for(size_t i = 0; i < n; i++)
+		lst.push_back(RpcValue(buckets[i]));
+	return RpcValue::Map {
+		{"count", RpcValue(count)},
+		{"sum", RpcValue(sum)},
+		{"max", RpcValue(max)},
+		{"avg", average()},
+		{"p50", RpcValue(percentile(0.5))},
+		{"p90", RpcValue(percentile(0.9))},
+		{"p99", RpcValue(percentile(0.99))},
+		{"log2Buckets", lst},
+	};
+}
+
+//==========================================================
+// RpcMetrics
+//==========================================================
+RpcMetrics::RpcMetrics()
+{
+	for(std::atomic<uint64_t> &c : m_counters)
+		c.store(0, std::memory_order_relaxed);
+	for(std::atomic<int64_t> &g : m_gauges)
+		g.store(0, std::memory_order_relaxed);
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.metrics.push_back(this);
+}
+
+RpcMetrics::~RpcMetrics()
+{
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	Snapshot snapshot = snapshot_helper();
+	for(int64_t &g : snapshot.gauges)
+		g = 0;
+	reg.retired.add(snapshot);
+	reg.metrics.erase(std::find(reg.metrics.begin(), reg.metrics.end(), this));
+}
+
+void RpcMetrics::setLabel(const std::string &label)
+{
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	m_label = label;
+}
+
+RpcMetrics::Snapshot RpcMetrics::snapshot() const
+{
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return snapshot_helper();
+}
+
+RpcMetrics::Snapshot RpcMetrics::snapshot_helper() const
+{
+	Snapshot ret;
+	ret.label = m_label;
+	for(int i = 0; i < (int)Counter::Count; i++)
+		ret.counters[i] = relaxed_load(m_counters[i]);
+	for(int i = 0; i < (int)Gauge::Count; i++)
+		ret.gauges[i] = m_gauges[i].load(std::memory_order_relaxed);
+	for(int i = 0; i < (int)HistogramId::Count; i++)
+		ret.histograms[i] = m_histograms[i].snapshot();
+	return ret;
+}
+
+RpcMetrics::Snapshot RpcMetrics::globalSnapshot()
+{
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	Snapshot ret = reg.retired;
+	for(const RpcMetrics *m : reg.metrics)
+		ret.add(m->snapshot_helper());
+	ret.label.clear();
+	return ret;
+}
+
+void RpcMetrics::forEachSnapshot(const std::function<void (const Snapshot &)> &fn)
+{
+	std::vector<Snapshot> snapshots;
+	{
+		Registry &reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		snapshots.reserve(reg.metrics.size());
+		for(const RpcMetrics *m : reg.metrics)
+			snapshots.push_back(m->snapshot_helper());
+	}
+	for(const Snapshot &s : snapshots)
+		fn(s);
+}
+
+int64_t RpcMetrics::monotonicUsec()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+const char *RpcMetrics::counterName(Counter c)
+{
+	switch(c) {
+	case Counter::FramesIn: return "framesIn";
+	case Counter::FramesOut: return "framesOut";
+	case Counter::BytesIn: return "bytesIn";
+	case Counter::BytesOut: return "bytesOut";
+	case Counter::WriteStalls: return "writeStalls";
+	case Counter::DecodeErrors: return "decodeErrors";
+	case Counter::Count: break;
+	}
+	return "???";
+}
+
+const char *RpcMetrics::gaugeName(Gauge g)
+{
+	switch(g) {
+	case Gauge::SendQueueDepth: return "sendQueueDepth";
+	case Gauge::SendQueueBytes: return "sendQueueBytes";
+	case Gauge::PendingRequests: return "pendingRequests";
+	case Gauge::Count: break;
+	}
+	return "???";
+}
+
+const char *RpcMetrics::histogramName(HistogramId h)
+{
+	switch(h) {
+	case HistogramId::MessageSizeIn: return "messageSizeIn";
+	case HistogramId::MessageSizeOut: return "messageSizeOut";
+	case HistogramId::DecodeTimeUsec: return "decodeTimeUsec";
+	case HistogramId::EncodeTimeUsec: return "encodeTimeUsec";
+	case HistogramId::RequestLatencyUsec: return "requestLatencyUsec";
+	case HistogramId::Count: break;
+	}
+	return "???";
+}
+
+void RpcMetrics::Snapshot::add(const Snapshot &o)
+{
+	for(int i = 0; i < (int)Counter::Count; i++)
+		counters[i] += o.counters[i];
+	for(int i = 0; i < (int)Gauge::Count; i++)
+		gauges[i] += o.gauges[i];
+	for(int i = 0; i < (int)HistogramId::Count; i++)
+		histograms[i].add(o.histograms[i]);
+}
+
+RpcValue RpcMetrics::Snapshot::toRpcValue() const
+{
+	RpcValue::Map ret;
+	if(!label.empty())
+		ret["label"] = label;
+	for(int i = 0; i < (int)Counter::Count; i++)
+		ret[counterName((Counter)i)] = RpcValue(counters[i]);
+	for(int i = 0; i < (int)Gauge::Count; i++)
+		ret[gaugeName((Gauge)i)] = RpcValue(gauges[i]);
+	for(int i = 0; i < (int)HistogramId::Count; i++)
+		ret[histogramName((HistogramId)i)] = histograms[i].toRpcValue();
+	return ret;
+}
+
+} // namespace chainpack
+} // namespace shv
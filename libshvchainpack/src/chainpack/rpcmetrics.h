@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+#include "rpcvalue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace shv {
+namespace chainpack {
+
+/// Counters, gauges and histograms of one RpcDriver.
+/// Values are relaxed atomics updated by the driver thread and read by any thread,
+/// no lock is taken on the hot path, so metrics can stay enabled in production.
+/// Every instance is registered in a global list, globalSnapshot() sums the live instances
+/// and the totals of already destroyed ones.
+class SHVCHAINPACK_DECL_EXPORT RpcMetrics
+{
+public:
+	/// log2 histogram, bucket 0 counts value 0, bucket i > 0 counts values in <2^(i-1), 2^i)
+	class SHVCHAINPACK_DECL_EXPORT Histogram
+	{
+	public:
+		static constexpr size_t BUCKET_COUNT = 40;
+
+		struct SHVCHAINPACK_DECL_EXPORT Snapshot
+		{
+			uint64_t count = 0;
+			uint64_t sum = 0;
+			uint64_t max = 0;
+			uint64_t buckets[BUCKET_COUNT] = {};
+
+			void add(const Snapshot &o);
+			double average() const {return count? static_cast<double>(sum) / count: 0;}
+			/// upper bound of the bucket containing p-quantile, p in <0, 1>
+			uint64_t percentile(double p) const;
+			RpcValue toRpcValue() const;
+		};
+	public:
+		Histogram();
+
+		void record(uint64_t value);
+		Snapshot snapshot() const;
+	private:
+		std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+		std::atomic<uint64_t> m_count;
+		std::atomic<uint64_t> m_sum;
+		std::atomic<uint64_t> m_max;
+	};
+
+	enum class Counter {
+		FramesIn = 0,
+		FramesOut,
+		BytesIn,
+		BytesOut,
+		/// data left in send queue, because socket write buffer was full or partially written
+		WriteStalls,
+		DecodeErrors,
+		Count
+	};
+	enum class Gauge {
+		SendQueueDepth = 0,
+		SendQueueBytes,
+		PendingRequests,
+		Count
+	};
+	enum class HistogramId {
+		MessageSizeIn = 0,
+		MessageSizeOut,
+		DecodeTimeUsec,
+		EncodeTimeUsec,
+		/// request sent to response received, for requests registered in PendingRpcRequests
+		RequestLatencyUsec,
+		Count
+	};
+
+	struct SHVCHAINPACK_DECL_EXPORT Snapshot
+	{
+		std::string label;
+		uint64_t counters[(int)Counter::Count] = {};
+		int64_t gauges[(int)Gauge::Count] = {};
+		Histogram::Snapshot histograms[(int)HistogramId::Count];
+
+		void add(const Snapshot &o);
+		RpcValue toRpcValue() const;
+	};
+public:
+	RpcMetrics();
+	~RpcMetrics();
+	RpcMetrics(const RpcMetrics &) = delete;
+	RpcMetrics& operator=(const RpcMetrics &) = delete;
+
+	/// connection name or id shown in metrics listing
+	void setLabel(const std::string &label);
+
+	void increment(Counter c, uint64_t n = 1) {m_counters[(int)c].fetch_add(n, std::memory_order_relaxed);}
+	uint64_t counter(Counter c) const {return m_counters[(int)c].load(std::memory_order_relaxed);}
+	void setGauge(Gauge g, int64_t val) {m_gauges[(int)g].store(val, std::memory_order_relaxed);}
+	int64_t gauge(Gauge g) const {return m_gauges[(int)g].load(std::memory_order_relaxed);}
+	void record(HistogramId h, uint64_t value) {m_histograms[(int)h].record(value);}
+	const Histogram& histogram(HistogramId h) const {return m_histograms[(int)h];}
+
+	Snapshot snapshot() const;
+
+	static const char* counterName(Counter c);
+	static const char* gaugeName(Gauge g);
+	static const char* histogramName(HistogramId h);
+
+	/// encode/decode time and request latency measuring, enabled by default
+	static bool isTimingEnabled() {return s_timingEnabled.load(std::memory_order_relaxed);}
+	static void setTimingEnabled(bool b) {s_timingEnabled.store(b, std::memory_order_relaxed);}
+	static int64_t monotonicUsec();
+	/// @return start time for recordTiming() or 0 when timing is disabled
+	static int64_t startTiming() {return isTimingEnabled()? monotonicUsec(): 0;}
+	void recordTiming(HistogramId h, int64_t start_usec)
+	{
+		if(start_usec > 0)
+			record(h, static_cast<uint64_t>(monotonicUsec() - start_usec));
+	}
+
+	/// sum of all the drivers, including already destroyed ones, gauges are summed over live drivers only
+	static Snapshot globalSnapshot();
+	/// snapshot of every live driver
+	static void forEachSnapshot(const std::function<void (const Snapshot &snapshot)> &fn);
+private:
+	Snapshot snapshot_helper() const;
+private:
+	std::atomic<uint64_t> m_counters[(int)Counter::Count];
+	std::atomic<int64_t> m_gauges[(int)Gauge::Count];
+	Histogram m_histograms[(int)HistogramId::Count];
+	/// guarded by global registry mutex
+	std::string m_label;
+	static std::atomic<bool> s_timingEnabled;
+};
+
+} // namespace chainpack
+} // namespace shv
@@ -2,8 +2,9 @@
 #include "cponwriter.h"
 
 #include "chainpackwriter.h"
-#include "cponreader.h"
+#include "cponbufferreader.h"
 #include "exception.h"
+#include "stringoutbuf.h"
 #include "utils.h"
 
 #include <necrolog.h>
@@ -16,43 +17,6 @@
 #include <iostream>
 //#include <utility>
 
-namespace {
-#if defined _WIN32 || defined LIBC_NEWLIB
-// see http://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap04.html#tag_04_15
-int is_leap(unsigned y)
-{
-	y += 1900;
-	return (y % 4) == 0 && ((y % 100) != 0 || (y % 400) == 0);
-}
-
-time_t timegm(struct tm *tm)
-{
-	static const unsigned ndays[2][12] = {
-		{31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
-		{31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}
-	};
-	time_t res = 0;
-	int i;
-
-	for (i = 70; i < tm->tm_year; ++i) {
-		res += is_leap(i) ? 366 : 365;
-	}
-
-	for (i = 0; i < tm->tm_mon; ++i) {
-		res += ndays[is_leap(tm->tm_year)][i];
-	}
-	res += tm->tm_mday - 1;
-	res *= 24;
-	res += tm->tm_hour;
-	res *= 60;
-	res += tm->tm_min;
-	res *= 60;
-	res += tm->tm_sec;
-	return res;
-}
-#endif
-} // namespace
-
 namespace shv {
 namespace chainpack {
 
@@ -531,6 +495,14 @@ size_t RpcValue::count() const { return m_ptr? m_ptr->count(): 0; }
 const RpcValue::List & RpcValue::toList() const { return m_ptr? m_ptr->toList(): static_empty_list(); }
 const RpcValue::Array & RpcValue::toArray() const { return m_ptr? m_ptr->toArray(): static_empty_array(); }
 const RpcValue::Map & RpcValue::toMap() const { return m_ptr? m_ptr->toMap(): static_empty_map(); }
+
+RpcValue::Array *RpcValue::uniqueArray()
+{
+	if(!m_ptr || m_ptr.use_count() != 1 || m_ptr->type() != Type::Array)
+		return nullptr;
+	// nobody else can see the change, array data are not const
+	return const_cast<Array*>(&m_ptr->toArray());
+}
 const RpcValue::IMap &RpcValue::toIMap() const { return m_ptr? m_ptr->toIMap(): static_empty_imap(); }
 RpcValue RpcValue::at (RpcValue::UInt i) const { return m_ptr? m_ptr->at(i): RpcValue(); }
 RpcValue RpcValue::at (const RpcValue::String &key) const { return m_ptr? m_ptr->at(key): RpcValue(); }
@@ -563,26 +535,30 @@ void RpcValue::append(const RpcValue &val)
 
 std::string RpcValue::toPrettyString(const std::string &indent) const
 {
-	std::ostringstream out;
+	std::string ret;
 	{
+		StringOutBuf buf(ret);
+		std::ostream out(&buf);
 		CponWriterOptions opts;
 		opts.setTranslateIds(true).setIndent(indent);
 		CponWriter wr(out, opts);
 		wr << *this;
 	}
-	return out.str();
+	return ret;
 }
 
 std::string RpcValue::toCpon() const
 {
-	std::ostringstream out;
+	std::string ret;
 	{
+		StringOutBuf buf(ret);
+		std::ostream out(&buf);
 		CponWriterOptions opts;
 		opts.setTranslateIds(false);
 		CponWriter wr(out, opts);
 		wr << *this;
 	}
-	return out.str();
+	return ret;
 }
 
 const std::string & RpcValue::AbstractValueData::toString() const { return static_empty_string(); }
@@ -668,20 +644,11 @@ bool ChainPack::operator< (const ChainPack &other) const
 RpcValue RpcValue::fromCpon(const std::string &str, std::string *err)
 {
 	RpcValue ret;
-	std::istringstream in(str);
-	CponReader rd(in);
-	if(err) {
-		err->clear();
-		try {
-			rd >> ret;
-		}
-		catch(CponReader::ParseException &e) {
-			*err = e.what();
-		}
-	}
-	else {
-		rd >> ret;
-	}
+	CponBufferReader rd(str);
+	if(err)
+		rd.read(ret, *err);
+	else
+		rd.read(ret);
 	return ret;
 }
 
@@ -825,106 +792,210 @@ std::string RpcValue::DateTimeEpoch::toUtcString() const
 }
 #endif
 
-static bool parse_ISO_DateTime(const std::string &s, std::tm &tm, unsigned &msec, int8_t &utc_offset)
+namespace {
+
+/// broken down ISO 8601 date time
+struct CivilDateTime
+{
+	int64_t year = 0;
+	int month = 1;
+	int day = 1;
+	int hour = 0;
+	int min = 0;
+	int sec = 0;
+	int msec = 0;
+	/// UTC offset in quarters of hour
+	int utcOffset = 0;
+};
+
+constexpr int64_t SEC_PER_DAY = 24 * 60 * 60;
+/// range of 57 bit DateTime msec field
+constexpr int64_t MAX_MSEC = (int64_t(1) << 56) - 1;
+constexpr int64_t MIN_MSEC = -(int64_t(1) << 56);
+
+int64_t floor_div(int64_t a, int64_t b)
 {
-	std::istringstream iss(s);
-	char sep;
+	int64_t q = a / b;
+	if((a % b != 0) && ((a < 0) != (b < 0)))
+		q--;
+	return q;
+}
 
-	tm.tm_year = 0;
-	tm.tm_mon = 0;
-	tm.tm_mday = 0;
-	tm.tm_hour = 0;
-	tm.tm_min = 0;
-	tm.tm_sec = 0;
-	tm.tm_isdst = -1;
+/// days since 1970-01-01 of proleptic Gregorian calendar date, see http://howardhinnant.github.io/date_algorithms.html
+int64_t days_from_civil(int64_t y, int m, int d)
+{
+	y -= m <= 2;
+	const int64_t era = floor_div(y, 400);
+	const int64_t yoe = y - era * 400;
+	const int64_t doy = (153 * (m > 2? m - 3: m + 9) + 2) / 5 + d - 1;
+	const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
 
-	msec = 0;
-	utc_offset = 0;
+void civil_from_days(int64_t z, int64_t &y, int &m, int &d)
+{
+	z += 719468;
+	const int64_t era = floor_div(z, 146097);
+	const int64_t doe = z - era * 146097;
+	const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	const int64_t mp = (5 * doy + 2) / 153;
+	d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+	m = static_cast<int>(mp < 10? mp + 3: mp - 9);
+	y = yoe + era * 400 + (m <= 2);
+}
 
-	if (iss >> tm.tm_year >> sep >> tm.tm_mon >> sep >> tm.tm_mday) {
-		tm.tm_year -= 1900;
-		tm.tm_mon -= 1;
-	}
-	else {
-		nError() << "Invalid date string:" << s << "too short";
+/// @return number of digits parsed, max_digits at most
+int parse_digits(const char *&p, const char *end, int max_digits, int64_t &val)
+{
+	val = 0;
+	int n = 0;
+	for(; n < max_digits && p < end && *p >= '0' && *p <= '9'; ++p, ++n)
+		val = val * 10 + (*p - '0');
+	return n;
+}
+
+bool parse_field(const char *&p, const char *end, int max_digits, int min_val, int max_val, int &val)
+{
+	int64_t v;
+	if(parse_digits(p, end, max_digits, v) == 0 || v < min_val || v > max_val)
 		return false;
+	val = static_cast<int>(v);
+	return true;
+}
+
+bool skip_char(const char *&p, const char *end, char c)
+{
+	if(p < end && *p == c) {
+		++p;
+		return true;
 	}
-	iss.get();
-	if (iss >> tm.tm_hour >> sep >> tm.tm_min >> sep >> tm.tm_sec) {
+	return false;
+}
+
+/// YYYY-MM-DDTHH:mm:ss[.sss][Z|+hh[[:]mm]|-hh[[:]mm]], T can be a space
+bool parse_iso_date_time(const char *p, const char *end, CivilDateTime &dt)
+{
+	bool negative_year = skip_char(p, end, '-');
+	// msec since epoch fits into 57 bits for years with 7 digits at most
+	if(parse_digits(p, end, 7, dt.year) == 0)
+		return false;
+	if(negative_year)
+		dt.year = -dt.year;
+	if(!skip_char(p, end, '-') || !parse_field(p, end, 2, 1, 12, dt.month))
+		return false;
+	if(!skip_char(p, end, '-') || !parse_field(p, end, 2, 1, 31, dt.day))
+		return false;
+	if(!(skip_char(p, end, 'T') || skip_char(p, end, ' ')))
+		return false;
+	if(!parse_field(p, end, 2, 0, 23, dt.hour))
+		return false;
+	if(!skip_char(p, end, ':') || !parse_field(p, end, 2, 0, 59, dt.min))
+		return false;
+	// leap second is accepted and normalized to the next minute
+	if(!skip_char(p, end, ':') || !parse_field(p, end, 2, 0, 60, dt.sec))
+		return false;
+	if(skip_char(p, end, '.')) {
+		int64_t frac;
+		int n = parse_digits(p, end, 3, frac);
+		if(n == 0)
+			return false;
+		for(; n < 3; n++)
+			frac *= 10;
+		dt.msec = static_cast<int>(frac);
+		// digits beyond msec precision are ignored
+		int64_t ignored;
+		parse_digits(p, end, 9, ignored);
 	}
-	else {
-		nError() << "Invalid time string:" << s << "too short";
+	if(p == end || skip_char(p, end, 'Z'))
+		return p == end;
+	bool negative_offset = *p == '-';
+	if(!(skip_char(p, end, '+') || skip_char(p, end, '-')))
 		return false;
+	int64_t hours;
+	int n = parse_digits(p, end, 2, hours);
+	if(n == 0)
+		return false;
+	int64_t mins = 0;
+	if(n == 2) {
+		bool colon = skip_char(p, end, ':');
+		int m = parse_digits(p, end, 2, mins);
+		if(m == 1 || (colon && m == 0))
+			return false;
 	}
+	if(p != end)
+		return false;
+	int off_min = static_cast<int>(hours * 60 + mins);
+	dt.utcOffset = (negative_offset? -off_min: off_min) / 15;
+	return dt.utcOffset >= -63 && dt.utcOffset <= 63;
+}
 
-	while(!iss.eof()) {
-		iss >> sep;
-		if(sep == '.') {
-			if(!(iss >> msec)) {
-				nError() << "Invalid date time string:" << s << "msecs missing";
-				return false;
-			}
-		}
-		else if(sep == '+' || sep == '-') {
-			int off;
-			if(!(iss >> off)) {
-				nError() << "Invalid date time string:" << s << "UTC offset missing";
-				return false;
-			}
-			if(off < 99)
-				off *= 100;
-			off = off / 100 * 60 + (off % 100);
-			off /= 15;
-			utc_offset = (sep == '-')? -off: off;
-		}
-		else if(sep == 'Z') {
-		}
-		else {
-			nError() << "Invalid date time string:" << s << "illegal UTC separator:" << sep;
-			return false;
-		}
+char* write_digits(char *p, int64_t val, int width)
+{
+	char *end = p + width;
+	for(char *q = end - 1; q >= p; --q) {
+		*q = static_cast<char>('0' + val % 10);
+		val /= 10;
 	}
+	return end;
+}
 
-	return true;
 }
 
 RpcValue::DateTime RpcValue::DateTime::fromLocalString(const std::string &local_date_time_str)
 {
-	std::tm tm;
-	unsigned msec;
-	int8_t utc_offset;
+	CivilDateTime dt;
 	DateTime ret;
-	if(!parse_ISO_DateTime(local_date_time_str, tm, msec, utc_offset))
+	if(!parse_iso_date_time(local_date_time_str.data(), local_date_time_str.data() + local_date_time_str.size(), dt)) {
+		nError() << "Invalid date time string:" << local_date_time_str;
 		return ret;
-
+	}
+	std::tm tm;
+	tm.tm_year = static_cast<int>(dt.year - 1900);
+	tm.tm_mon = dt.month - 1;
+	tm.tm_mday = dt.day;
+	tm.tm_hour = dt.hour;
+	tm.tm_min = dt.min;
+	tm.tm_sec = dt.sec;
+	tm.tm_isdst = -1;
 	std::time_t tim = std::mktime(&tm);
 	if(tim == -1) {
 		nError() << "Invalid date time string:" << local_date_time_str;
 		return ret;
 	}
-	ret.m_dtm.msec = (tim - utc_offset * 15 * 60) * 1000 + msec;
-	ret.m_dtm.tz = utc_offset;
+	ret.m_dtm.msec = (tim - dt.utcOffset * 15 * 60) * 1000 + dt.msec;
+	ret.m_dtm.tz = dt.utcOffset;
 
 	return ret;
 }
 
 RpcValue::DateTime RpcValue::DateTime::fromUtcString(const std::string &utc_date_time_str)
 {
-	std::tm tm;
-	unsigned msec;
-	int8_t utc_offset;
+	bool ok;
+	DateTime ret = fromUtcString(utc_date_time_str.data(), utc_date_time_str.size(), &ok);
+	if(!ok)
+		nError() << "Invalid date time string:" << utc_date_time_str;
+	return ret;
+}
+
+RpcValue::DateTime RpcValue::DateTime::fromUtcString(const char *str, size_t len, bool *ok)
+{
+	CivilDateTime dt;
 	DateTime ret;
-	if(!parse_ISO_DateTime(utc_date_time_str, tm, msec, utc_offset))
+	bool parsed = parse_iso_date_time(str, str + len, dt);
+	if(ok)
+		*ok = parsed;
+	if(!parsed)
 		return ret;
-
-	std::time_t tim = timegm(&tm);
-	if(tim == -1) {
-		nError() << "Invalid date time string:" << utc_date_time_str;
+	int64_t sec = days_from_civil(dt.year, dt.month, dt.day) * SEC_PER_DAY + dt.hour * 3600 + dt.min * 60 + dt.sec;
+	int64_t msec = (sec - dt.utcOffset * 15 * 60) * 1000 + dt.msec;
+	if(msec < MIN_MSEC || msec > MAX_MSEC) {
+		if(ok)
+			*ok = false;
 		return ret;
 	}
-	ret.m_dtm.msec = (tim - utc_offset * 15 * 60) * 1000 + msec;
-	ret.m_dtm.tz = utc_offset;
-
+	ret.m_dtm.msec = msec;
+	ret.m_dtm.tz = dt.utcOffset;
 	return ret;
 }
 
@@ -963,33 +1034,58 @@ std::string RpcValue::DateTime::toLocalString() const
 
 std::string RpcValue::DateTime::toUtcString() const
 {
-	std::time_t tim = m_dtm.msec / 1000 + m_dtm.tz * 15 * 60;
-	std::tm *tm = std::gmtime(&tim);
-	if(tm == nullptr) {
-		nError() << "Invalid date time: " << m_dtm.msec;
-		return std::string();
+	char buff[UTC_STRING_MAX_LEN];
+	return std::string(buff, toUtcString(buff));
+}
+
+size_t RpcValue::DateTime::toUtcString(char *buff) const
+{
+	// date and time fields are in local time of UTC offset
+	const int64_t msec = m_dtm.msec + static_cast<int64_t>(m_dtm.tz) * 15 * 60 * 1000;
+	const int64_t sec = floor_div(msec, 1000);
+	const int64_t days = floor_div(sec, SEC_PER_DAY);
+	const int64_t sec_of_day = sec - days * SEC_PER_DAY;
+	int64_t year;
+	int month, day;
+	civil_from_days(days, year, month, day);
+
+	char *p = buff;
+	if(year < 0) {
+		*p++ = '-';
+		year = -year;
+	}
+	int year_width = 4;
+	for(int64_t y = year; y >= 10000; y /= 10)
+		year_width++;
+	p = write_digits(p, year, year_width);
+	*p++ = '-';
+	p = write_digits(p, month, 2);
+	*p++ = '-';
+	p = write_digits(p, day, 2);
+	*p++ = 'T';
+	p = write_digits(p, sec_of_day / 3600, 2);
+	*p++ = ':';
+	p = write_digits(p, sec_of_day / 60 % 60, 2);
+	*p++ = ':';
+	p = write_digits(p, sec_of_day % 60, 2);
+	const int64_t msec_of_sec = msec - sec * 1000;
+	if(msec_of_sec > 0) {
+		*p++ = '.';
+		p = write_digits(p, msec_of_sec, 3);
 	}
-	char buffer[80];
-	std::strftime(buffer, sizeof(buffer),"%Y-%m-%dT%H:%M:%S",tm);
-	std::string ret(buffer);
-	int msecs = m_dtm.msec % 1000;
-	if(msecs > 0)
-		ret += '.' + Utils::toString(msecs % 1000, 3);
 	if(m_dtm.tz == 0) {
-		ret += 'Z';
+		*p++ = 'Z';
 	}
 	else {
 		int min = offsetFromUtc();
+		*p++ = (min < 0)? '-': '+';
 		if(min < 0)
 			min = -min;
-		int hour = min / 60;
-		min = min % 60;
-		std::string tz = Utils::toString(hour, 2);
-		if(min != 0)
-			tz += Utils::toString(min, 2);
-		ret += ((m_dtm.tz < 0)? '-': '+') + tz;
+		p = write_digits(p, min / 60, 2);
+		if(min % 60 != 0)
+			p = write_digits(p, min % 60, 2);
 	}
-	return ret;
+	return static_cast<size_t>(p - buff);
 }
 
 RpcValue::MetaData::MetaData(RpcValue::MetaData &&o)
@@ -1068,6 +1164,16 @@ RpcValue RpcValue::MetaData::value(RpcValue::String key) const
 	return RpcValue();
 }
 
+RpcValue *RpcValue::MetaData::valueRef(RpcValue::UInt key)
+{
+	if(!m_imap)
+		return nullptr;
+	auto it = m_imap->find(key);
+	if(it == m_imap->end())
+		return nullptr;
+	return &it->second;
+}
+
 void RpcValue::MetaData::setValue(RpcValue::UInt key, const RpcValue &val)
 {
 	if(val.isValid()) {
@@ -1126,14 +1232,16 @@ const RpcValue::Map &RpcValue::MetaData::sValues() const
 
 std::string RpcValue::MetaData::toStdString() const
 {
-	std::ostringstream out;
+	std::string ret;
 	{
+		StringOutBuf buf(ret);
+		std::ostream out(&buf);
 		CponWriterOptions opts;
 		opts.setTranslateIds(true);
 		CponWriter wr(out, opts);
 		wr << *this;
 	}
-	return out.str();
+	return ret;
 }
 
 void RpcValue::MetaData::swap(RpcValue::MetaData &o)
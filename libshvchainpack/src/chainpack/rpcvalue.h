@@ -80,6 +80,8 @@ public:
 		// UTC msec since 2.2. 2018 folowed by signed UTC offset in 1/4 hour
 		// Fri Feb 02 2018 00:00:00 == 1517529600 EPOCH
 		static constexpr int64_t SHV_EPOCH_MSEC = 1517529600000;
+		/// buffer size sufficient for toUtcString(char*)
+		static constexpr size_t UTC_STRING_MAX_LEN = 40;
 	public:
 		DateTime() {}
 		int64_t msecsSinceEpoch() const { return m_dtm.msec; }
@@ -88,10 +90,15 @@ public:
 
 		static DateTime fromLocalString(const std::string &local_date_time_str);
 		static DateTime fromUtcString(const std::string &utc_date_time_str);
+		/// ISO 8601 date time with optional msecs and UTC offset, converted without libc time functions
+		static DateTime fromUtcString(const char *str, size_t len, bool *ok = nullptr);
 		static DateTime fromMSecsSinceEpoch(int64_t msecs, int utc_offset_min = 0);
 
 		std::string toLocalString() const;
 		std::string toUtcString() const;
+		/// writes not zero terminated ISO 8601 string to buff of UTC_STRING_MAX_LEN size
+		/// @return number of chars written
+		size_t toUtcString(char *buff) const;
 
 		bool operator ==(const DateTime &o) const {return m_dtm.msec == o.m_dtm.msec && m_dtm.tz == o.m_dtm.tz;}
 	private:
@@ -259,6 +266,8 @@ public:
 		std::vector<RpcValue::String> sKeys() const;
 		RpcValue value(RpcValue::UInt key) const;
 		RpcValue value(RpcValue::String key) const;
+		/// stored value for in-place modification, nullptr if key does not exist
+		RpcValue* valueRef(RpcValue::UInt key);
 		void setValue(RpcValue::UInt key, const RpcValue &val);
 		void setValue(RpcValue::String key, const RpcValue &val);
 		bool isEmpty() const;
@@ -366,6 +375,8 @@ public:
 	const Blob &toBlob() const;
 	const List &toList() const;
 	const Array &toArray() const;
+	/// Array for in-place modification, nullptr if value is not Array or array data are shared with other RpcValue
+	Array* uniqueArray();
 	const Map &toMap() const;
 	const IMap &toIMap() const;
 
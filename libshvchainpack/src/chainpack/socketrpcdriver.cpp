@@ -1,7 +1,7 @@
 #include "socketrpcdriver.h"
+#include "rpclog.h"
 
-#include <necrolog.h>
-
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 
@@ -24,7 +24,11 @@ namespace shv {
 namespace chainpack {
 
 SocketRpcDriver::SocketRpcDriver()
+	: m_timerWheel(TIMER_WHEEL_TICK_MSEC)
 {
+	pendingRequests().setRequestsPendingCallback([this]() {
+		schedulePendingRequestsCheck();
+	});
 }
 
 SocketRpcDriver::~SocketRpcDriver()
@@ -37,6 +41,7 @@ void SocketRpcDriver::closeConnection()
 	if(isOpen())
 		::close(m_socket);
 	m_socket = -1;
+	pendingRequests().cancelAll("Connection closed");
 }
 
 bool SocketRpcDriver::isOpen()
@@ -61,13 +66,13 @@ int64_t SocketRpcDriver::writeBytes(const char *bytes, size_t length)
 bool SocketRpcDriver::flush()
 {
 	if(m_writeBuffer.empty()) {
-		nDebug() << "write buffer is empty";
+		logRpcData() << "write buffer is empty";
 		return false;
 	}
-	nDebug() << "Flushing write buffer, buffer len:" << m_writeBuffer.size() << "...";
-	nDebug() << "writing to socket:" << Utils::toHex(m_writeBuffer);
+	logRpcData() << "Flushing write buffer, buffer len:" << m_writeBuffer.size() << "...";
+	logRpcData() << "writing to socket:" << Utils::toHex(m_writeBuffer);
 	int64_t n = ::write(m_socket, m_writeBuffer.data(), m_writeBuffer.length());
-	nDebug() << "\t" << n << "bytes written";
+	logRpcData() << "\t" << n << "bytes written";
 	if(n > 0)
 		m_writeBuffer = m_writeBuffer.substr(n);
 	return (n > 0);
@@ -132,9 +137,16 @@ void SocketRpcDriver::exec()
 	memset(&in, 0, BUFF_LEN);
 	memset(&out, 0, BUFF_LEN);
 
+	static constexpr int64_t IDLE_TIMEOUT_MSEC = 5000;
+	/// last socket activity or idle task call, timer ticks do not count
+	int64_t last_idle_msec = TimerWheel::monotonicMsec();
 	while(1) {
-		waitd.tv_sec = 5;
-		waitd.tv_usec = 0;
+		int64_t idle_wait_msec = last_idle_msec + IDLE_TIMEOUT_MSEC - TimerWheel::monotonicMsec();
+		if(idle_wait_msec < 0)
+			idle_wait_msec = 0;
+		int64_t wait_msec = m_timerWheel.isEmpty()? idle_wait_msec: std::min<int64_t>(m_timerWheel.tickMsec(), idle_wait_msec);
+		waitd.tv_sec = wait_msec / 1000;
+		waitd.tv_usec = (wait_msec % 1000) * 1000;
 
 		FD_ZERO(&read_flags);
 		FD_ZERO(&write_flags);
@@ -145,6 +157,8 @@ void SocketRpcDriver::exec()
 		//FD_SET(STDIN_FILENO, &write_flags);
 
 		int sel = select(FD_SETSIZE, &read_flags, &write_flags, (fd_set*)0, &waitd);
+		const int64_t now = TimerWheel::monotonicMsec();
+		m_timerWheel.advance(now);
 
 		//ESP_LOGI(__FILE__, "select returned, number of active file descriptors: %d", sel);
 		//if an error with select
@@ -153,21 +167,26 @@ void SocketRpcDriver::exec()
 			return;
 		}
 		if(sel == 0) {
-			nInfo() << "\t timeout";
+			// timers ticking for pending requests must not postpone idle task (keep-alive) forever
+			if(now - last_idle_msec < IDLE_TIMEOUT_MSEC)
+				continue;
+			logRpcData() << "\t timeout";
+			last_idle_msec = now;
 			idleTaskOnSelectTimeout();
 			continue;
 		}
+		last_idle_msec = now;
 
 		//socket ready for reading
 		if(FD_ISSET(m_socket, &read_flags)) {
-			nInfo() << "\t read fd is set";
+			logRpcData() << "\t read fd is set";
 			//clear set
 			FD_CLR(m_socket, &read_flags);
 
 			memset(&in, 0, BUFF_LEN);
 
 			auto n = read(m_socket, in, BUFF_LEN);
-			nInfo() << "\t " << n << "bytes read";
+			logRpcData() << "\t " << n << "bytes read";
 			if(n <= 0) {
 				nError() << "Closing socket";
 				closeConnection();
@@ -178,25 +197,47 @@ void SocketRpcDriver::exec()
 
 		//socket ready for writing
 		if(FD_ISSET(m_socket, &write_flags)) {
-			nInfo() << "\t write fd is set";
+			logRpcData() << "\t write fd is set";
 			FD_CLR(m_socket, &write_flags);
 			enqueueDataToSend(Chunk());
 		}
 	}
 }
 
+void SocketRpcDriver::onCoalescedNotifyPending(int msec)
+{
+	if(m_coalescedNotifiesTimerId != TimerWheel::INVALID_TIMER_ID)
+		return;
+	m_coalescedNotifiesTimerId = m_timerWheel.addTimer(TimerWheel::monotonicMsec(), msec, [this]() {
+		m_coalescedNotifiesTimerId = TimerWheel::INVALID_TIMER_ID;
+		flushCoalescedNotifies();
+	});
+}
+
+void SocketRpcDriver::schedulePendingRequestsCheck()
+{
+	if(m_pendingRequestsTimerId != TimerWheel::INVALID_TIMER_ID)
+		return;
+	m_pendingRequestsTimerId = m_timerWheel.addTimer(TimerWheel::monotonicMsec(), pendingRequests().tickMsec(), [this]() {
+		m_pendingRequestsTimerId = TimerWheel::INVALID_TIMER_ID;
+		pendingRequests().checkTimeouts();
+		if(!pendingRequests().isEmpty())
+			schedulePendingRequestsCheck();
+	});
+}
+
 void SocketRpcDriver::sendResponse(unsigned request_id, const cp::RpcValue &result)
 {
 	cp::RpcResponse resp;
 	resp.setRequestId(request_id);
 	resp.setResult(result);
-	nInfo() << "sending response:" << resp.toCpon();
+	logRpcMsg() << "sending response:" << resp.toCpon();
 	sendRpcValue(resp.value());
 }
 
 void SocketRpcDriver::sendNotify(std::string &&method, const cp::RpcValue &result)
 {
-	nInfo() << "sending notify:" << method;
+	logRpcMsg() << "sending notify:" << method;
 	cp::RpcNotify ntf;
 	ntf.setMethod(std::move(method));
 	ntf.setParams(result);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "rpcdriver.h"
+#include "timerwheel.h"
 
 #include <string>
 
@@ -19,18 +20,32 @@ public:
 
 	void sendResponse(unsigned request_id, const RpcValue &result);
 	void sendNotify(std::string &&method, const RpcValue &result);
+
+	/// timers driven by exec() loop, request timeouts and notify coalescing use it too
+	/// application can add its own watchdogs here, callbacks are called from exec()
+	TimerWheel& timerWheel() {return m_timerWheel;}
 protected:
 	bool isOpen() override;
 	int64_t writeBytes(const char *bytes, size_t length) override;
 	bool flush() override;
+	bool isWriteBufferFull() override {return m_writeBuffer.size() >= m_maxWriteBufferLength;}
+	void onSendQueueOverflow() override {closeConnection();}
+	void onCoalescedNotifyPending(int msec) override;
 
 	virtual void idleTaskOnSelectTimeout() {}
 	//virtual void connectedToHost(bool ) {}
 	//virtual void connectionClosed() {}
 private:
+	void schedulePendingRequestsCheck();
+private:
+	static constexpr int TIMER_WHEEL_TICK_MSEC = 10;
+
 	int m_socket = -1;
 	std::string m_writeBuffer;
 	size_t m_maxWriteBufferLength = 1024;
+	TimerWheel m_timerWheel;
+	TimerWheel::TimerId m_coalescedNotifiesTimerId = TimerWheel::INVALID_TIMER_ID;
+	TimerWheel::TimerId m_pendingRequestsTimerId = TimerWheel::INVALID_TIMER_ID;
 };
 
 }}
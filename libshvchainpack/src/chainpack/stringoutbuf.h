@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <streambuf>
+#include <string>
+
+namespace shv {
+namespace chainpack {
+
+/// std::streambuf appending to std::string, std::ostream writes go directly to the string memory.
+/// String is kept resized to its capacity while the buffer is alive and trimmed to the written data
+/// in destructor, so the string must not be used before the buffer is destroyed.
+class StringOutBuf : public std::streambuf
+{
+public:
+	explicit StringOutBuf(std::string &str) : m_str(str)
+	{
+		reserve(str.size(), 0);
+	}
+	~StringOutBuf() override
+	{
+		m_str.resize(written());
+	}
+protected:
+	int_type overflow(int_type c) override
+	{
+		if(traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+		reserve(written(), 1);
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+		return c;
+	}
+	std::streamsize xsputn(const char *s, std::streamsize n) override
+	{
+		if(epptr() - pptr() < n)
+			reserve(written(), (size_t)n);
+		std::memcpy(pptr(), s, (size_t)n);
+		setp(pptr() + n, epptr());
+		return n;
+	}
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+	{
+		// tellp() support only
+		if(off == 0 && dir == std::ios_base::cur && (which & std::ios_base::out))
+			return pos_type((off_type)written());
+		return pos_type(off_type(-1));
+	}
+private:
+	size_t written() const {return (size_t)(pptr() - m_str.data());}
+	void reserve(size_t used, size_t n)
+	{
+		size_t size = m_str.capacity();
+		if(size < used + n)
+			size = std::max(used + n, 2 * size);
+		if(size < MIN_SIZE)
+			size = MIN_SIZE;
+		m_str.resize(size);
+		char *data = &m_str[0];
+		setp(data + used, data + size);
+	}
+private:
+	static constexpr size_t MIN_SIZE = 64;
+	std::string &m_str;
+};
+
+} // namespace chainpack
+} // namespace shv
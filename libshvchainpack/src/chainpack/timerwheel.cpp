@@ -0,0 +1,131 @@
+#include "timerwheel.h"
+
+#include <chrono>
+
+namespace shv {
+namespace chainpack {
+
+constexpr TimerWheel::TimerId TimerWheel::INVALID_TIMER_ID;
+constexpr int TimerWheel::LEVEL_BITS;
+constexpr int TimerWheel::SLOT_COUNT;
+constexpr int TimerWheel::LEVEL_COUNT;
+
+TimerWheel::TimerWheel(int tick_msec)
+	: m_tickMsec(tick_msec > 0? tick_msec: 1)
+	, m_slots(LEVEL_COUNT * SLOT_COUNT)
+{
+}
+
+int64_t TimerWheel::monotonicMsec()
+{
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+TimerWheel::TimerId TimerWheel::addTimer(int64_t now_msec, int timeout_msec, Callback &&callback)
+{
+	// empty wheel can be re-based, advance() would have to walk all the ticks since it was used last time otherwise
+	int64_t now_tick = now_msec / m_tickMsec;
+	if(m_currentTick < 0 || (m_timers.empty() && now_tick > m_currentTick))
+		m_currentTick = now_tick;
+	int64_t expire_tick = tickCeil(now_msec + (timeout_msec > 0? timeout_msec: 0));
+	if(expire_tick <= m_currentTick)
+		expire_tick = m_currentTick + 1;
+	TimerId id = ++m_lastTimerId;
+	Slot tmp;
+	tmp.push_back(Timer{id, expire_tick, 0, 0, std::move(callback)});
+	Slot::iterator it = tmp.begin();
+	placeTimer(tmp, it);
+	m_timers[id] = it;
+	return id;
+}
+
+void TimerWheel::placeTimer(Slot &from_slot, Slot::iterator it)
+{
+	int64_t delta = it->expireTick - m_currentTick;
+	int level = 0;
+	while(level < LEVEL_COUNT - 1 && delta >= ((int64_t)1 << (LEVEL_BITS * (level + 1))))
+		level++;
+	int64_t slot_tick = it->expireTick;
+	// timers beyond the wheel range wait in the farthest top level slot and they are placed again from there
+	int64_t max_tick = m_currentTick + ((int64_t)1 << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+	if(slot_tick > max_tick)
+		slot_tick = max_tick;
+	it->level = level;
+	it->slotIndex = (int)((slot_tick >> (LEVEL_BITS * level)) & (SLOT_COUNT - 1));
+	if(level == 0)
+		m_levelZeroCount++;
+	Slot &to_slot = slot(it->level, it->slotIndex);
+	to_slot.splice(to_slot.end(), from_slot, it);
+}
+
+bool TimerWheel::cancelTimer(TimerId id)
+{
+	auto it = m_timers.find(id);
+	if(it == m_timers.end())
+		return false;
+	Slot::iterator timer_it = it->second;
+	if(timer_it->level == 0)
+		m_levelZeroCount--;
+	slot(timer_it->level, timer_it->slotIndex).erase(timer_it);
+	m_timers.erase(it);
+	return true;
+}
+
+void TimerWheel::cascade(int level, int64_t tick)
+{
+	Slot &from_slot = slot(level, (int)((tick >> (LEVEL_BITS * level)) & (SLOT_COUNT - 1)));
+	Slot pending;
+	pending.splice(pending.end(), from_slot);
+	while(!pending.empty())
+		placeTimer(pending, pending.begin());
+}
+
+size_t TimerWheel::advance(int64_t now_msec)
+{
+	int64_t now_tick = now_msec / m_tickMsec;
+	if(m_currentTick < 0)
+		m_currentTick = now_tick;
+	if(now_tick <= m_currentTick)
+		return 0;
+	std::vector<Callback> expired;
+	while(m_currentTick < now_tick) {
+		if(m_timers.empty()) {
+			m_currentTick = now_tick;
+			break;
+		}
+		int64_t tick = m_currentTick + 1;
+		if(m_levelZeroCount == 0) {
+			// nothing can expire before the next cascade
+			int64_t next_cascade_tick = (m_currentTick | (SLOT_COUNT - 1)) + 1;
+			if(next_cascade_tick > now_tick) {
+				m_currentTick = now_tick;
+				break;
+			}
+			tick = next_cascade_tick;
+		}
+		m_currentTick = tick;
+		if((tick & (SLOT_COUNT - 1)) == 0) {
+			// higher levels first, timers can be cascaded more than one level down
+			int top_level = 1;
+			while(top_level < LEVEL_COUNT - 1 && (tick & (((int64_t)1 << (LEVEL_BITS * (top_level + 1))) - 1)) == 0)
+				top_level++;
+			for(int level = top_level; level >= 1; level--)
+				cascade(level, tick);
+		}
+		Slot &slot0 = slot(0, (int)(tick & (SLOT_COUNT - 1)));
+		for(Timer &timer : slot0) {
+			expired.push_back(std::move(timer.callback));
+			m_timers.erase(timer.id);
+		}
+		m_levelZeroCount -= slot0.size();
+		slot0.clear();
+	}
+	// callbacks can add or cancel timers
+	for(Callback &cb : expired)
+		cb();
+	return expired.size();
+}
+
+} // namespace chainpack
+} // namespace shv
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../shvchainpackglobal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace shv {
+namespace chainpack {
+
+/// Hierarchical timing wheel, timers are inserted and cancelled in O(1).
+/// Level 0 has one slot per tick, each next level slot spans whole previous level,
+/// timers are cascaded to lower level when their slot is reached.
+/// Timer expiration is rounded up to tick resolution.
+/// Class is not thread safe.
+class SHVCHAINPACK_DECL_EXPORT TimerWheel
+{
+public:
+	using TimerId = uint64_t;
+	using Callback = std::function<void ()>;
+	static constexpr TimerId INVALID_TIMER_ID = 0;
+public:
+	explicit TimerWheel(int tick_msec = 10);
+
+	int tickMsec() const {return m_tickMsec;}
+
+	TimerId addTimer(int64_t now_msec, int timeout_msec, Callback &&callback);
+	bool cancelTimer(TimerId id);
+	/// call callbacks of timers expired till now_msec
+	/// @return number of expired timers
+	size_t advance(int64_t now_msec);
+	size_t timerCount() const {return m_timers.size();}
+	bool isEmpty() const {return m_timers.empty();}
+
+	/// milliseconds from some unspecified point in the past, not affected by system time changes
+	static int64_t monotonicMsec();
+private:
+	static constexpr int LEVEL_BITS = 6;
+	static constexpr int SLOT_COUNT = 1 << LEVEL_BITS;
+	static constexpr int LEVEL_COUNT = 4;
+
+	struct Timer
+	{
+		TimerId id;
+		int64_t expireTick;
+		int level;
+		int slotIndex;
+		Callback callback;
+	};
+	using Slot = std::list<Timer>;
+private:
+	int64_t tickCeil(int64_t msec) const {return (msec + m_tickMsec - 1) / m_tickMsec;}
+	Slot& slot(int level, int slot_index) {return m_slots[level * SLOT_COUNT + slot_index];}
+	/// move timer at it from slot from_slot to the slot given by its expireTick
+	void placeTimer(Slot &from_slot, Slot::iterator it);
+	void cascade(int level, int64_t tick);
+private:
+	int m_tickMsec;
+	std::vector<Slot> m_slots;
+	/// timers are spliced between slots, so the iterators stay valid
+	std::unordered_map<TimerId, Slot::iterator> m_timers;
+	size_t m_levelZeroCount = 0;
+	/// last processed tick, -1 if wheel was not used yet
+	int64_t m_currentTick = -1;
+	TimerId m_lastTimerId = INVALID_TIMER_ID;
+};
+
+} // namespace chainpack
+} // namespace shv
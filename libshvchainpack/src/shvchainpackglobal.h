@@ -17,3 +17,10 @@
 #define SHVCHAINPACK_DECL_EXPORT _SHVCHAINPACK_DECL_IMPORT
 #endif
 
+
+/// C++20 coroutines are supported by compiler, RpcCall is awaitable then
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define SHVCHAINPACK_HAS_COROUTINES
+#endif
+#endif
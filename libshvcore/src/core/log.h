@@ -21,6 +21,13 @@
 
 #define shvLogFuncFrame() nLogFuncFrame()
 
+/// topic is checked before the arguments are evaluated, use it when they are expensive to format
+#ifdef NECROLOG_NO_DEBUG_LOG
+#define shvCDebugLazy(category) while(false) nCDebug(category)
+#else
+#define shvCDebugLazy(category) for(bool en = NecroLog::shouldLog(NecroLog::Level::Debug, NecroLog::LogContext(__FILE__, __LINE__, category)); en; en = false) nCDebug(category)
+#endif
+
 #else
 
 #include "shvlog.h"
@@ -54,6 +61,9 @@ shv::core::ShvLog(shv::core::ShvLog::Level::Invalid, shv::core::ShvLog::LogConte
 shvDebug() << ">>>> ENTER FN" << __FUNCTION__
 #endif
 
+/// shvCDebug() checks log filter before the arguments are evaluated already
+#define shvCDebugLazy(category) shvCDebug(category)
+
 #endif
 
 #define shvDebug() shvCDebug("")
@@ -0,0 +1 @@
+#include "../../../../src/rpc/loginbatcher.h"
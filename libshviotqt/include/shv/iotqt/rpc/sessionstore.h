@@ -0,0 +1 @@
+#include "../../../../src/rpc/sessionstore.h"
@@ -0,0 +1 @@
+#include "../../../../src/rpc/subscriptionindex.h"
@@ -2,12 +2,14 @@ HEADERS += \
     $$PWD/shvnodetree.h \
     $$PWD/shvnode.h \
     $$PWD/localfsnode.h \
+    $$PWD/rpcmetricsnode.h \
     $$PWD/shvtreenode.h
 
 SOURCES += \
     $$PWD/shvnodetree.cpp \
     $$PWD/shvnode.cpp \
     $$PWD/localfsnode.cpp \
+    $$PWD/rpcmetricsnode.cpp \
     $$PWD/shvtreenode.cpp
 
 
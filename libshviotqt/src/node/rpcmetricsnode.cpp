@@ -0,0 +1,65 @@
+#include "rpcmetricsnode.h"
+
+#include <shv/chainpack/metamethod.h>
+#include <shv/chainpack/rpc.h>
+#include <shv/chainpack/rpcmetrics.h>
+#include <shv/core/exception.h>
+
+namespace cp = shv::chainpack;
+
+namespace shv {
+namespace iotqt {
+namespace node {
+
+static const char M_GET[] = "get";
+static const char M_CONNECTIONS[] = "connections";
+static const char M_SET_TIMING_ENABLED[] = "setTimingEnabled";
+
+static std::vector<cp::MetaMethod> meta_methods {
+	{cp::Rpc::METH_DIR, cp::MetaMethod::Signature::RetParam, false},
+	{cp::Rpc::METH_LS, cp::MetaMethod::Signature::RetParam, false},
+	{M_GET, cp::MetaMethod::Signature::RetVoid, false},
+	{M_CONNECTIONS, cp::MetaMethod::Signature::RetVoid, false},
+	{M_SET_TIMING_ENABLED, cp::MetaMethod::Signature::RetParam, false},
+};
+
+RpcMetricsNode::RpcMetricsNode(ShvNode *parent)
+	: Super(parent)
+{
+	setNodeId("metrics");
+}
+
+size_t RpcMetricsNode::methodCount()
+{
+	return meta_methods.size();
+}
+
+const chainpack::MetaMethod *RpcMetricsNode::metaMethod(size_t ix)
+{
+	if(meta_methods.size() <= ix)
+		SHV_EXCEPTION("Invalid method index: " + std::to_string(ix) + " of: " + std::to_string(meta_methods.size()));
+	return &(meta_methods[ix]);
+}
+
+chainpack::RpcValue RpcMetricsNode::call(const std::string &method, const chainpack::RpcValue &params)
+{
+	if(method == M_GET) {
+		return cp::RpcMetrics::globalSnapshot().toRpcValue();
+	}
+	if(method == M_CONNECTIONS) {
+		cp::RpcValue::List ret;
+		cp::RpcMetrics::forEachSnapshot([&ret](const cp::RpcMetrics::Snapshot &snapshot) {
+			ret.push_back(snapshot.toRpcValue());
+		});
+		return ret;
+	}
+	if(method == M_SET_TIMING_ENABLED) {
+		cp::RpcMetrics::setTimingEnabled(params.toBool());
+		return true;
+	}
+	return Super::call(method, params);
+}
+
+} // namespace node
+} // namespace iotqt
+} // namespace shv
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "shvnode.h"
+
+namespace shv {
+namespace iotqt {
+namespace node {
+
+/// Exposes shv::chainpack::RpcMetrics of all the RPC drivers in process,
+/// mount it for example as .broker/metrics
+/// methods: get - global totals, connections - list of per connection snapshots
+class SHVIOTQT_DECL_EXPORT RpcMetricsNode : public ShvNode
+{
+	Q_OBJECT
+
+	using Super = ShvNode;
+public:
+	explicit RpcMetricsNode(ShvNode *parent = nullptr);
+
+	size_t methodCount() override;
+	const shv::chainpack::MetaMethod* metaMethod(size_t ix) override;
+
+	shv::chainpack::RpcValue call(const std::string &method, const shv::chainpack::RpcValue &params) override;
+};
+
+} // namespace node
+} // namespace iotqt
+} // namespace shv
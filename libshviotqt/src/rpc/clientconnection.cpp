@@ -2,6 +2,7 @@
 
 #include "clientappclioptions.h"
 #include "rpc.h"
+#include "sessionstore.h"
 #include "socketrpcconnection.h"
 
 #include <shv/coreqt/log.h>
@@ -13,12 +14,18 @@
 
 #include <QTcpSocket>
 #include <QHostAddress>
+#include <QPointer>
 #include <QTimer>
 #include <QCryptographicHash>
 #include <QThread>
 
-#define logRpcMsg() shvCDebug("RpcMsg")
-#define logRpcSyncCalls() shvCDebug("RpcSyncCalls")
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+
+#define logRpcMsg() shvCDebugLazy("RpcMsg")
+#define logRpcSyncCalls() shvCDebugLazy("RpcSyncCalls")
 
 namespace cp = shv::chainpack;
 
@@ -39,6 +46,11 @@ ClientConnection::ClientConnection(SyncCalls sync_calls, QObject *parent)
 	m_connectionId = m_rpcDriver->connectionId();
 
 	connect(this, &ClientConnection::setProtocolTypeRequest, m_rpcDriver, &SocketRpcDriver::setProtocolTypeAsInt);
+	connect(this, &ClientConnection::setSendQueueWatermarksRequest, m_rpcDriver, &SocketRpcDriver::setSendQueueWatermarksAsInt);
+	connect(this, &ClientConnection::setSendQueueOverflowPolicyRequest, m_rpcDriver, &SocketRpcDriver::setSendQueueOverflowPolicyAsInt);
+	connect(this, &ClientConnection::setNotifyCoalescingWindowRequest, m_rpcDriver, [this](int msec) {
+		m_rpcDriver->setNotifyCoalescingWindow(msec);
+	});
 	connect(this, &ClientConnection::sendMessageRequest, m_rpcDriver, &SocketRpcDriver::sendRpcValue);
 	connect(this, &ClientConnection::connectToHostRequest, m_rpcDriver, &SocketRpcDriver::connectToHost);
 	connect(this, &ClientConnection::closeConnectionRequest, m_rpcDriver, &SocketRpcDriver::closeConnection);
@@ -46,18 +58,16 @@ ClientConnection::ClientConnection(SyncCalls sync_calls, QObject *parent)
 
 	connect(m_rpcDriver, &SocketRpcDriver::socketConnectedChanged, this, &ClientConnection::socketConnectedChanged);
 	connect(m_rpcDriver, &SocketRpcDriver::rpcValueReceived, this, &ClientConnection::onRpcValueReceived);
+	connect(m_rpcDriver, &SocketRpcDriver::sendQueueFullChanged, this, [this](bool is_full) {
+		m_isSendQueueFull = is_full;
+		emit sendQueueFullChanged(is_full);
+	});
 
 	if(m_syncCalls == SyncCalls::Enabled) {
-		connect(this, &ClientConnection::sendMessageSyncRequest, m_rpcDriver, &SocketRpcDriver::sendRpcRequestSync_helper, Qt::BlockingQueuedConnection);
 		m_rpcDriverThread = new QThread();
 		m_rpcDriver->moveToThread(m_rpcDriverThread);
 		m_rpcDriverThread->start();
 	}
-	else {
-		connect(this, &ClientConnection::sendMessageSyncRequest, []() {
-			shvError() << "Sync calls are enabled in threaded RPC connection only!";
-		});
-	}
 
 	connect(this, &ClientConnection::socketConnectedChanged, this, &ClientConnection::onSocketConnectedChanged);
 
@@ -69,6 +79,7 @@ ClientConnection::ClientConnection(SyncCalls sync_calls, QObject *parent)
 ClientConnection::~ClientConnection()
 {
 	shvDebug() << __FUNCTION__;
+	releaseCallHandle();
 	abort();
 	if(m_syncCalls == SyncCalls::Enabled) {
 		if(m_rpcDriverThread->isRunning()) {
@@ -198,14 +209,123 @@ void ClientConnection::sendMessage(const cp::RpcMessage &rpc_msg)
 
 cp::RpcResponse ClientConnection::sendMessageSync(const cp::RpcRequest &rpc_request_message, int time_out_ms)
 {
-	cp::RpcResponse res_msg;
-	m_connectionState.maxSyncMessageId = qMax(m_connectionState.maxSyncMessageId, rpc_request_message.requestId().toUInt());
-	//logRpcSyncCalls() << "==> send SYNC MSG id:" << rpc_request_message.id() << "data:" << rpc_request_message.toStdString();
-	emit sendMessageSyncRequest(rpc_request_message, &res_msg, time_out_ms);
-	//logRpcSyncCalls() << "<== RESP SYNC MSG id:" << res_msg.id() << "data:" << res_msg.toStdString();
+	const unsigned rq_id = rpc_request_message.requestId().toUInt();
+	auto error_response = [rq_id](const std::string &err_msg) {
+		shvError() << err_msg;
+		cp::RpcResponse resp;
+		resp.setRequestId(rq_id);
+		resp.setError(cp::RpcResponse::Error::createInternalError(err_msg));
+		return resp;
+	};
+	if(m_syncCalls != SyncCalls::Enabled)
+		return error_response("Sync calls are enabled in threaded RPC connection only!");
+	if(QThread::currentThread() == m_rpcDriverThread)
+		return error_response("Sync calls cannot be called from RPC driver thread!");
+	if(rq_id == 0)
+		return error_response("Attempt to send RPC request with ID not set!");
+	if(time_out_ms == 0)
+		time_out_ms = defaultRpcTimeout();
+	m_connectionState.maxSyncMessageId = qMax(m_connectionState.maxSyncMessageId, rq_id);
+	logRpcSyncCalls() << cp::RpcDriver::SND_LOG_ARROW << "SEND SYNC message id:" << rq_id << "msg:" << rpc_request_message.toCpon();
+	cp::PendingRpcRequests &pending_requests = m_rpcDriver->pendingRequests();
+	std::future<cp::RpcResponse> future = pending_requests.addRequest(rq_id, time_out_ms);
+	emit sendMessageRequest(rpc_request_message.value());
+	if(time_out_ms > 0) {
+		// timeout is resolved in driver thread, wait a bit longer to let it happen there
+		if(future.wait_for(std::chrono::milliseconds(time_out_ms + 2 * pending_requests.tickMsec())) != std::future_status::ready)
+			pending_requests.cancelRequest(rq_id, "Receive message timeout after: " + std::to_string(time_out_ms) + " msec!");
+	}
+	cp::RpcResponse res_msg = future.get();
+	logRpcSyncCalls() << cp::RpcDriver::RCV_LOG_ARROW << "RECV SYNC message id:" << rq_id << "msg:" << res_msg.toCpon();
 	return res_msg;
 }
 
+std::vector<cp::RpcBatchCall::Result> ClientConnection::callShvMethodsSync(const std::vector<cp::RpcBatchCall::Request> &requests, size_t max_in_flight, int time_out_ms)
+{
+	std::vector<cp::RpcBatchCall::Result> ret(requests.size());
+	std::string err_msg;
+	if(m_syncCalls != SyncCalls::Enabled)
+		err_msg = "Sync calls are enabled in threaded RPC connection only!";
+	else if(QThread::currentThread() == m_rpcDriverThread)
+		err_msg = "Sync calls cannot be called from RPC driver thread!";
+	if(!err_msg.empty()) {
+		shvError() << err_msg;
+		for(cp::RpcBatchCall::Result &result : ret)
+			result.response.setError(cp::RpcResponse::Error::createInternalError(err_msg));
+		return ret;
+	}
+	if(time_out_ms == 0)
+		time_out_ms = defaultRpcTimeout();
+	if(max_in_flight == 0)
+		max_in_flight = 1;
+	cp::PendingRpcRequests &pending_requests = m_rpcDriver->pendingRequests();
+	struct InFlight
+	{
+		size_t index;
+		unsigned requestId;
+		std::future<cp::RpcBatchCall::Result> future;
+	};
+	std::deque<InFlight> in_flight;
+	size_t next_ix = 0;
+	while(next_ix < requests.size() || !in_flight.empty()) {
+		while(next_ix < requests.size() && in_flight.size() < max_in_flight) {
+			const cp::RpcBatchCall::Request &rq_def = requests[next_ix];
+			cp::RpcRequest rq;
+			rq.setRequestId(nextRequestId());
+			rq.setMethod(rq_def.method);
+			rq.setParams(rq_def.params);
+			if(!rq_def.shvPath.empty())
+				rq.setShvPath(rq_def.shvPath);
+			unsigned rq_id = rq.requestId().toUInt();
+			m_connectionState.maxSyncMessageId = qMax(m_connectionState.maxSyncMessageId, rq_id);
+			// latency is measured in driver thread, when response is received
+			auto promise = std::make_shared<std::promise<cp::RpcBatchCall::Result>>();
+			int64_t send_time = cp::TimerWheel::monotonicMsec();
+			in_flight.push_back(InFlight{next_ix++, rq_id, promise->get_future()});
+			pending_requests.addRequest(rq_id, time_out_ms, [promise, send_time](const cp::RpcResponse &resp) {
+				cp::RpcBatchCall::Result result;
+				result.response = resp;
+				result.latencyMsec = static_cast<int>(cp::TimerWheel::monotonicMsec() - send_time);
+				promise->set_value(std::move(result));
+			});
+			emit sendMessageRequest(rq.value());
+		}
+		// responses are collected in request order, the window moves when the oldest one is finished
+		InFlight &oldest = in_flight.front();
+		if(time_out_ms > 0) {
+			if(oldest.future.wait_for(std::chrono::milliseconds(time_out_ms + 2 * pending_requests.tickMsec())) != std::future_status::ready)
+				pending_requests.cancelRequest(oldest.requestId, "Receive message timeout after: " + std::to_string(time_out_ms) + " msec!");
+		}
+		ret[oldest.index] = oldest.future.get();
+		in_flight.pop_front();
+	}
+	return ret;
+}
+
+void ClientConnection::sendMessageAsync(const cp::RpcRequest &rpc_request, ResponseCallback &&callback, int time_out_ms)
+{
+	const unsigned rq_id = rpc_request.requestId().toUInt();
+	if(time_out_ms == 0)
+		time_out_ms = defaultRpcTimeout();
+	ResponseCallback cb = std::move(callback);
+	// callback is called from driver thread, response is delivered in connection thread if connection still exists,
+	// self is cleared by ~QObject(), driver thread is joined in ~ClientConnection() before
+	QPointer<ClientConnection> self(this);
+	m_rpcDriver->pendingRequests().addRequest(rq_id, time_out_ms, [self, cb](const cp::RpcResponse &resp) {
+		if(!self)
+			return;
+		QTimer::singleShot(0, self.data(), [cb, resp]() {
+			cb(resp);
+		});
+	});
+	emit sendMessageRequest(rpc_request.value());
+}
+
+void ClientConnection::cancelMessageAsync(unsigned request_id)
+{
+	m_rpcDriver->pendingRequests().cancelRequest(request_id);
+}
+
 void ClientConnection::onRpcMessageReceived(const chainpack::RpcMessage &msg)
 {
 	//logRpcMsg() << msg.toCpon();
@@ -249,16 +369,19 @@ void ClientConnection::sendLogin(const shv::chainpack::RpcValue &server_hello)
 	m_connectionState.loginRequestId = callMethod(cp::Rpc::METH_LOGIN, createLoginParams(server_hello));
 }
 
+std::string ClientConnection::sha1Hex(const std::string &s)
+{
+	// fromRawData does not copy the string
+	QByteArray sha1 = QCryptographicHash::hash(QByteArray::fromRawData(s.data(), static_cast<int>(s.size())), QCryptographicHash::Algorithm::Sha1).toHex();
+	return std::string(sha1.constData(), static_cast<size_t>(sha1.size()));
+}
+
 std::string ClientConnection::passwordHash(const std::string &user)
 {
-	QCryptographicHash hash(QCryptographicHash::Algorithm::Sha1);
 	std::string pass = password();
 	if(pass.empty())
 		pass = user;
-	hash.addData(pass.data(), pass.size());
-	QByteArray sha1 = hash.result().toHex();
-	//shvWarning() << user << pass << sha1;
-	return std::string(sha1.constData(), sha1.length());
+	return sha1Hex(pass);
 }
 
 void ClientConnection::processInitPhase(const chainpack::RpcMessage &msg)
@@ -279,6 +402,7 @@ void ClientConnection::processInitPhase(const chainpack::RpcMessage &msg)
 		}
 		else if(m_connectionState.loginRequestId == id) {
 			m_connectionState.loginResult = resp.result();
+			m_sessionToken = m_connectionState.loginResult.toMap().value(cp::Rpc::KEY_SESSION_TOKEN).toString();
 			setBrokerConnected(true);
 			return;
 		}
@@ -289,21 +413,26 @@ void ClientConnection::processInitPhase(const chainpack::RpcMessage &msg)
 
 chainpack::RpcValue ClientConnection::createLoginParams(const chainpack::RpcValue &server_hello)
 {
-	std::string server_nonce = server_hello.toMap().value("nonce").toString();
-	std::string password = server_nonce + passwordHash(user());
-	QCryptographicHash hash(QCryptographicHash::Algorithm::Sha1);
-	hash.addData(password.c_str(), password.length());
-	QByteArray sha1 = hash.result().toHex();
-	//shvWarning() << password << sha1;
-	return cp::RpcValue::Map {
+	const std::string nonce = server_hello.toMap().value("nonce").toString();
+	std::string password = nonce + passwordHash(user());
+	cp::RpcValue::Map ret {
 		{"login", cp::RpcValue::Map {
 			 {"user", user()},
-			 {"password", std::string(sha1.constData())},
+			 {"password", sha1Hex(password)},
 		 },
 		},
 		{"type", connectionType()},
 		{"options", connectionOptions()},
 	};
+	// broker falls back to password check when session cannot be resumed,
+	// token is not sent, only proof bound to nonce like the password
+	if(!m_sessionToken.empty()) {
+		ret[cp::Rpc::KEY_SESSION] = cp::RpcValue::Map {
+			{"id", SessionStore::sessionId(m_sessionToken)},
+			{"password", SessionStore::sessionProof(nonce, m_sessionToken)},
+		};
+	}
+	return ret;
 }
 
 void ClientConnection::checkBrokerConnected()
@@ -334,6 +463,11 @@ void ClientConnection::setBrokerConnected(bool b)
 	}
 }
 
+bool ClientConnection::isSessionResumed() const
+{
+	return loginResult().toMap().value(cp::Rpc::KEY_SESSION_RESUMED).toBool();
+}
+
 unsigned ClientConnection::brokerClientId() const
 {
 	return loginResult().toMap().value(cp::Rpc::KEY_CLIENT_ID).toUInt();
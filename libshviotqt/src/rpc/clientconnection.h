@@ -57,19 +57,38 @@ public:
 	Q_SIGNAL void socketConnectedChanged(bool is_connected);
 	bool isSocketConnected() const;
 
+	/// see shv::chainpack::RpcDriver::setSendQueueWatermarks()
+	void setSendQueueWatermarks(int low_watermark, int high_watermark) {emit setSendQueueWatermarksRequest(low_watermark, high_watermark);}
+	void setSendQueueOverflowPolicy(shv::chainpack::RpcDriver::SendQueueOverflowPolicy p) {emit setSendQueueOverflowPolicyRequest((int)p);}
+	/// producer should stop sending messages until sendQueueFullChanged(false) is emitted
+	Q_SIGNAL void sendQueueFullChanged(bool is_full);
+	bool isSendQueueFull() const {return m_isSendQueueFull;}
+	/// see shv::chainpack::RpcDriver::setNotifyCoalescingWindow()
+	void setNotifyCoalescingWindow(int msec) {emit setNotifyCoalescingWindowRequest(msec);}
+
 	Q_SIGNAL void rpcMessageReceived(const shv::chainpack::RpcMessage &msg);
 
 	/// AbstractRpcConnection interface implementation
 	/// since RpcDriver is connected to SocketDriver using queued connection. it is safe to call sendMessage from different thread
 	void sendMessage(const shv::chainpack::RpcMessage &rpc_msg) override;
+	/// blocks calling thread until response or timeout, without nested event loop
+	/// can be called from any thread except the RPC driver thread
 	shv::chainpack::RpcResponse sendMessageSync(const shv::chainpack::RpcRequest &rpc_request, int time_out_ms = DEFAULT_RPC_TIMEOUT) override;
+	/// response is resolved in RPC driver thread, callback is called in this object thread
+	void sendMessageAsync(const shv::chainpack::RpcRequest &rpc_request, ResponseCallback &&callback, int time_out_ms = DEFAULT_RPC_TIMEOUT) override;
+	void cancelMessageAsync(unsigned request_id) override;
+	/// pipelined blocking version of callShvMethodsAsync(), same thread restrictions as sendMessageSync()
+	std::vector<shv::chainpack::RpcBatchCall::Result> callShvMethodsSync(const std::vector<shv::chainpack::RpcBatchCall::Request> &requests
+																		 , size_t max_in_flight = shv::chainpack::RpcBatchCall::DEFAULT_MAX_IN_FLIGHT
+																		 , int time_out_ms = DEFAULT_RPC_TIMEOUT);
 	void onRpcMessageReceived(const shv::chainpack::RpcMessage &msg) override;
 protected:
 	Q_SIGNAL void setProtocolTypeRequest(int ver);
+	Q_SIGNAL void setSendQueueWatermarksRequest(int low_watermark, int high_watermark);
+	Q_SIGNAL void setSendQueueOverflowPolicyRequest(int policy);
+	Q_SIGNAL void setNotifyCoalescingWindowRequest(int msec);
 	Q_SIGNAL void sendMessageRequest(const shv::chainpack::RpcValue& msg);
 
-	Q_SIGNAL void sendMessageSyncRequest(const shv::chainpack::RpcRequest &request, shv::chainpack::RpcResponse *presponse, int time_out_ms);
-
 	// host_name is QString to avoid qRegisterMetatype<std::string>() for queued connection
 	Q_SIGNAL void connectToHostRequest(const QString &host_name, quint16 port);
 	Q_SIGNAL void closeConnectionRequest();
@@ -83,6 +102,7 @@ protected:
 	virtual shv::chainpack::RpcValue createLoginParams(const shv::chainpack::RpcValue &server_hello);
 
 	virtual std::string passwordHash(const std::string &user);
+	static std::string sha1Hex(const std::string &s);
 	virtual void onSocketConnectedChanged(bool is_connected);
 	void sendHello();
 	void sendLogin(const shv::chainpack::RpcValue &server_hello);
@@ -93,6 +113,12 @@ public:
 	bool isBrokerConnected() const {return m_connectionState.isBrokerConnected;}
 	Q_SIGNAL void brokerConnectedChanged(bool is_connected);
 	const shv::chainpack::RpcValue& loginResult() const {return m_connectionState.loginResult;}
+	/// session token from the last login result, it is sent with next login to resume the server side session
+	const std::string& sessionToken() const {return m_sessionToken;}
+	/// next login will start new session
+	void resetSession() {m_sessionToken.clear();}
+	/// true if broker restored session state of previous connection, subscriptions need not to be renewed then
+	bool isSessionResumed() const;
 	unsigned brokerClientId() const;
 private:
 	SocketRpcDriver *m_rpcDriver = nullptr;
@@ -101,6 +127,7 @@ private:
 	QThread *m_rpcDriverThread = nullptr;
 	int m_connectionId;
 	SyncCalls m_syncCalls;
+	bool m_isSendQueueFull = false;
 
 	QTimer *m_checkConnectedTimer;
 	QTimer *m_pingTimer = nullptr;
@@ -116,6 +143,8 @@ private:
 	};
 
 	ConnectionState m_connectionState;
+	/// survives reconnect, unlike m_connectionState
+	std::string m_sessionToken;
 	int m_checkBrokerConnectedInterval = 0;
 };
 
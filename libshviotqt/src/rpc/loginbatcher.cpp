@@ -0,0 +1,50 @@
+#include "loginbatcher.h"
+
+#include <shv/coreqt/log.h>
+
+#include <QTimer>
+
+namespace cp = shv::chainpack;
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+LoginBatcher::LoginBatcher(VerifyFunction &&verify_function, QObject *parent)
+	: QObject(parent)
+	, m_verifyFunction(std::move(verify_function))
+{
+}
+
+void LoginBatcher::verify(const cp::RpcValue &auth_params, LoginCallback &&callback)
+{
+	m_pendingParams.push_back(auth_params);
+	m_pendingCallbacks.push_back(std::move(callback));
+	if(m_pendingParams.size() >= m_maxBatchSize) {
+		flush();
+		return;
+	}
+	if(!m_flushScheduled) {
+		m_flushScheduled = true;
+		QTimer::singleShot(m_maxDelay, this, &LoginBatcher::flush);
+	}
+}
+
+void LoginBatcher::flush()
+{
+	m_flushScheduled = false;
+	if(m_pendingParams.empty())
+		return;
+	std::vector<cp::RpcValue> params;
+	std::vector<LoginCallback> callbacks;
+	params.swap(m_pendingParams);
+	callbacks.swap(m_pendingCallbacks);
+	std::vector<cp::RpcValue> results = m_verifyFunction(params);
+	if(results.size() != params.size())
+		shvError() << "Login batch verification returned" << results.size() << "results for" << params.size() << "logins.";
+	// callbacks can start new batch
+	for(size_t i = 0; i < callbacks.size(); i++)
+		callbacks[i](i < results.size()? results[i]: cp::RpcValue());
+}
+
+}}}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../shviotqtglobal.h"
+
+#include <shv/chainpack/rpcvalue.h>
+
+#include <QObject>
+
+#include <functional>
+#include <vector>
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+/// Collects logins arriving within maxDelay() msec (by default those processed in one event loop iteration)
+/// and verifies them with single VerifyFunction call, so credentials lookup can be done in bulk
+/// after mass reconnect. Use it from ServerConnection::loginAsync(), one batcher per connections thread.
+class SHVIOTQT_DECL_EXPORT LoginBatcher : public QObject
+{
+	Q_OBJECT
+public:
+	/// returns login result for each auth params item, invalid RpcValue means authentication failure
+	using VerifyFunction = std::function<std::vector<shv::chainpack::RpcValue> (const std::vector<shv::chainpack::RpcValue> &auth_params)>;
+	using LoginCallback = std::function<void (const shv::chainpack::RpcValue &login_result)>;
+public:
+	explicit LoginBatcher(VerifyFunction &&verify_function, QObject *parent = nullptr);
+
+	size_t maxBatchSize() const {return m_maxBatchSize;}
+	void setMaxBatchSize(size_t n) {m_maxBatchSize = n > 0? n: 1;}
+	int maxDelay() const {return m_maxDelay;}
+	void setMaxDelay(int msec) {m_maxDelay = msec;}
+
+	void verify(const shv::chainpack::RpcValue &auth_params, LoginCallback &&callback);
+	void flush();
+private:
+	VerifyFunction m_verifyFunction;
+	std::vector<shv::chainpack::RpcValue> m_pendingParams;
+	std::vector<LoginCallback> m_pendingCallbacks;
+	size_t m_maxBatchSize = 256;
+	int m_maxDelay = 0;
+	bool m_flushScheduled = false;
+};
+
+}}}
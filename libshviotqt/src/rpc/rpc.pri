@@ -8,7 +8,11 @@ SOURCES += \
     $$PWD/deviceconnection.cpp \
     $$PWD/clientappclioptions.cpp \
     $$PWD/tunnelconnection.cpp \
-    $$PWD/tunnelhandle.cpp
+    $$PWD/tunnelhandle.cpp \
+    $$PWD/sharedtimerwheel.cpp \
+    $$PWD/loginbatcher.cpp \
+    $$PWD/sessionstore.cpp \
+    $$PWD/subscriptionindex.cpp
 
 HEADERS += \
     $$PWD/rpc.h \
@@ -20,5 +24,9 @@ HEADERS += \
     $$PWD/deviceconnection.h \
     $$PWD/clientappclioptions.h \
     $$PWD/tunnelconnection.h \
-    $$PWD/tunnelhandle.h
+    $$PWD/tunnelhandle.h \
+    $$PWD/sharedtimerwheel.h \
+    $$PWD/loginbatcher.h \
+    $$PWD/sessionstore.h \
+    $$PWD/subscriptionindex.h
 
@@ -1,5 +1,8 @@
 ﻿#include "serverconnection.h"
 #include "socketrpcconnection.h"
+#include "sharedtimerwheel.h"
+#include "sessionstore.h"
+#include "subscriptionindex.h"
 
 #include <shv/coreqt/log.h>
 
@@ -8,11 +11,14 @@
 //#include <shv/chainpack/chainpackprotocol.h>
 #include <shv/chainpack/rpcmessage.h>
 
+#include <QPointer>
 #include <QTcpSocket>
 #include <QTimer>
 #include <QCryptographicHash>
 
-#define logRpcMsg() shvCDebug("RpcMsg")
+#include <random>
+
+#define logRpcMsg() shvCDebugLazy("RpcMsg")
 
 namespace cp = shv::chainpack;
 
@@ -22,6 +28,8 @@ namespace rpc {
 
 static int s_initPhaseTimeout = 10000;
 
+constexpr size_t ServerConnection::NONCE_LENGTH;
+
 ServerConnection::ServerConnection(QTcpSocket *socket, QObject *parent)
 	: Super(parent)
 {
@@ -31,18 +39,30 @@ ServerConnection::ServerConnection(QTcpSocket *socket, QObject *parent)
 		if(is_connected) {
 			setConnectionName(peerAddress() + ':' + std::to_string(peerPort()));
 		}
+		else {
+			suspendSession();
+			removeSubscriptions();
+		}
 	});
-	QTimer::singleShot(s_initPhaseTimeout, this, [this]() {
-		if(isInitPhase()) {
+	QPointer<ServerConnection> self(this);
+	SharedTimerWheel::instance()->addTimer(s_initPhaseTimeout, [self]() {
+		if(self && self->isInitPhase()) {
 			shvWarning() << "Client should login in" << (s_initPhaseTimeout/1000) << "seconds, dropping out connection.";
-			abort();
+			self->abort();
 		}
 	});
 }
 
 ServerConnection::~ServerConnection()
 {
+	releaseCallHandle();
 	shvInfo() << "Destroying Connection ID:" << connectionId() << "name:" << connectionName();
+	// connection deleted before socket is disconnected cannot provide its state anymore
+	if(m_sessionStore && !m_sessionToken.empty()) {
+		m_sessionStore->removeSession(m_sessionToken, connectionId());
+		m_sessionToken.clear();
+	}
+	removeSubscriptions();
 	abort();
 }
 
@@ -59,8 +79,76 @@ chainpack::RpcResponse ServerConnection::sendMessageSync(const chainpack::RpcReq
 	return chainpack::RpcResponse();
 }
 
+void ServerConnection::sendMessageAsync(const chainpack::RpcRequest &rpc_request, ResponseCallback &&callback, int time_out_ms)
+{
+	sendRpcRequest(rpc_request, std::move(callback), time_out_ms);
+}
+
+void ServerConnection::cancelMessageAsync(unsigned request_id)
+{
+	pendingRequests().cancelRequest(request_id);
+}
+
+bool ServerConnection::subscribe(const std::string &path, const std::string &method)
+{
+	if(!m_subscriptionIndex)
+		return false;
+	return m_subscriptionIndex->subscribe(connectionId(), path, method);
+}
+
+bool ServerConnection::unsubscribe(const std::string &path, const std::string &method)
+{
+	if(!m_subscriptionIndex)
+		return false;
+	return m_subscriptionIndex->unsubscribe(connectionId(), path, method);
+}
+
+void ServerConnection::removeSubscriptions()
+{
+	if(m_subscriptionIndex)
+		m_subscriptionIndex->removeConnection(connectionId());
+}
+
+void ServerConnection::setIdleWatchDogTimeOut(int sec)
+{
+	m_idleWatchDogTimeOut = sec;
+	m_lastActivityMsec = cp::TimerWheel::monotonicMsec();
+	if(sec > 0)
+		scheduleIdleWatchDog(sec * 1000);
+}
+
+void ServerConnection::scheduleIdleWatchDog(int msec)
+{
+	if(m_idleWatchDogScheduled)
+		return;
+	m_idleWatchDogScheduled = true;
+	// activity does not touch the timer, watchdog reschedules itself for the rest of the idle period instead
+	QPointer<ServerConnection> self(this);
+	SharedTimerWheel::instance()->addTimer(msec, [self]() {
+		if(self)
+			self->checkIdleWatchDog();
+	});
+}
+
+void ServerConnection::checkIdleWatchDog()
+{
+	m_idleWatchDogScheduled = false;
+	if(m_idleWatchDogTimeOut <= 0)
+		return;
+	const int64_t timeout_msec = m_idleWatchDogTimeOut * 1000;
+	int64_t idle_msec = cp::TimerWheel::monotonicMsec() - m_lastActivityMsec;
+	if(idle_msec >= timeout_msec) {
+		shvWarning() << "Connection ID:" << connectionId() << "name:" << connectionName() << "was idle for more than" << m_idleWatchDogTimeOut << "seconds, dropping out connection.";
+		abort();
+		return;
+	}
+	scheduleIdleWatchDog(static_cast<int>(timeout_msec - idle_msec));
+}
+
 void ServerConnection::onRpcDataReceived(shv::chainpack::Rpc::ProtocolType protocol_version, shv::chainpack::RpcValue::MetaData &&md, const std::string &data, size_t start_pos, size_t data_len)
 {
+	if(m_idleWatchDogTimeOut > 0)
+		m_lastActivityMsec = cp::TimerWheel::monotonicMsec();
 	//shvInfo() << __FILE__ << RCV_LOG_ARROW << md.toStdString() << shv::chainpack::Utils::toHexElided(data, start_pos, 100);
 	if(isInitPhase()) {
 		shv::chainpack::RpcValue rpc_val = decodeData(protocol_version, data, start_pos);
@@ -84,6 +172,104 @@ void ServerConnection::onRpcMessageReceived(const chainpack::RpcMessage &msg)
 	emit rpcMessageReceived(msg);
 }
 
+std::string ServerConnection::createNonce()
+{
+	// unlike std::rand(), random_device output cannot be predicted from previous nonces
+	static thread_local std::random_device s_randomDevice;
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+	std::string ret(NONCE_LENGTH, '0');
+	for(size_t i = 0; i < ret.size(); ) {
+		uint32_t r = s_randomDevice();
+		for(int j = 0; j < 8 && i < ret.size(); j++, i++) {
+			ret[i] = HEX_DIGITS[r & 0xF];
+			r >>= 4;
+		}
+	}
+	return ret;
+}
+
+void ServerConnection::loginAsync(const chainpack::RpcValue &auth_params, LoginCallback &&callback)
+{
+	callback(login(auth_params));
+}
+
+void ServerConnection::finishLogin(const chainpack::RpcValue &request_id, const chainpack::RpcValue &auth_params, const chainpack::RpcValue &login_resp)
+{
+	m_loginPending = false;
+	if(!login_resp.isValid()) {
+		shvError() << "Invalid authentication for user:" << m_user << "at:" << connectionName() << "Dropping client connection.";
+		sendError(request_id, cp::RpcResponse::Error::create(cp::RpcResponse::Error::MethodInvocationException
+															 , "Invalid authentication for user: " + m_user + " at: " + connectionName()));
+		QTimer::singleShot(100, this, &ServerConnection::abort); // need some time to send error to client
+		return;
+	}
+	shvInfo().nospace() << "Client logged in user: " << m_user << " from: " << peerAddress() << ':' << peerPort();
+	if(m_sessionStore && !m_sessionResumed)
+		sendResponse(request_id, addSessionToLoginResult(login_resp));
+	else
+		sendResponse(request_id, login_resp);
+	m_loginReceived = true;
+	cp::RpcValue opts = auth_params.toMap().value("options");
+	setIdleWatchDogTimeOut(opts.toMap().value(cp::Rpc::OPT_IDLE_WD_TIMEOUT).toInt());
+}
+
+bool ServerConnection::resumeSession(const chainpack::RpcValue &request_id, const chainpack::RpcValue &auth_params)
+{
+	if(!m_sessionStore)
+		return false;
+	const cp::RpcValue::Map session_params = auth_params.toMap().value(cp::Rpc::KEY_SESSION).toMap();
+	std::string session_id = session_params.value("id").toString();
+	std::string proof = session_params.value("password").toString();
+	if(session_id.empty() || proof.empty())
+		return false;
+	// resumed session gets new token, replayed proof of the old one is refused
+	std::string new_token = createNonce();
+	SessionStore::Session session;
+	if(!m_sessionStore->resumeSession(session_id, m_pendingAuthNonce, proof, m_user, connectionId(), new_token, session)) {
+		shvInfo() << "Session of user:" << m_user << "cannot be resumed, full login required.";
+		return false;
+	}
+	m_sessionToken = new_token;
+	m_sessionResumed = true;
+	cp::RpcValue::Map login_result = session.loginResult.toMap();
+	login_result[cp::Rpc::KEY_SESSION_TOKEN] = m_sessionToken;
+	login_result[cp::Rpc::KEY_SESSION_RESUMED] = true;
+	finishLogin(request_id, auth_params, login_result);
+	// client of resumed session expects signals subscribed by previous connection
+	if(m_subscriptionIndex) {
+		for(const SubscriptionIndex::Subscription &s : session.subscriptions)
+			m_subscriptionIndex->subscribe(connectionId(), s.path, s.method);
+	}
+	restoreSessionState(session.state);
+	return true;
+}
+
+chainpack::RpcValue ServerConnection::addSessionToLoginResult(const chainpack::RpcValue &login_resp)
+{
+	if(!login_resp.isMap()) {
+		shvWarning() << "Session cannot be stored for login result which is not a map:" << login_resp.toCpon();
+		return login_resp;
+	}
+	m_sessionToken = createNonce();
+	m_sessionStore->addSession(m_sessionToken, connectionId(), m_user, login_resp);
+	cp::RpcValue::Map login_result = login_resp.toMap();
+	login_result[cp::Rpc::KEY_SESSION_TOKEN] = m_sessionToken;
+	login_result[cp::Rpc::KEY_SESSION_RESUMED] = false;
+	return login_result;
+}
+
+void ServerConnection::suspendSession()
+{
+	if(!m_sessionStore || m_sessionToken.empty())
+		return;
+	shvDebug() << "Suspending session of connection ID:" << connectionId() << "user:" << m_user;
+	std::vector<SubscriptionIndex::Subscription> subscriptions;
+	if(m_subscriptionIndex)
+		subscriptions = m_subscriptionIndex->subscriptionsForConnection(connectionId());
+	m_sessionStore->suspendSession(m_sessionToken, connectionId(), sessionState(), std::move(subscriptions));
+	m_sessionToken.clear();
+}
+
 void ServerConnection::processInitPhase(const chainpack::RpcMessage &msg)
 {
 	cp::RpcRequest rq(msg);
@@ -109,7 +295,7 @@ void ServerConnection::processInitPhase(const chainpack::RpcMessage &msg)
 			//m_profile = profile;
 			m_helloReceived = true;
 			shvInfo() << "sending hello response:" << connectionName();// << "profile:" << m_profile;
-			m_pendingAuthNonce = std::to_string(std::rand());
+			m_pendingAuthNonce = createNonce();
 			cp::RpcValue::Map params {
 				//{"protocol", cp::RpcValue::Map{{"version", protocol_version}}},
 				{"nonce", m_pendingAuthNonce}
@@ -117,16 +303,21 @@ void ServerConnection::processInitPhase(const chainpack::RpcMessage &msg)
 			sendResponse(rq.requestId(), params);
 			return;
 		}
-		if(m_helloReceived && !m_loginReceived && rq.method() == shv::chainpack::Rpc::METH_LOGIN) {
+		if(m_helloReceived && !m_loginReceived && !m_loginPending && rq.method() == shv::chainpack::Rpc::METH_LOGIN) {
 			shvInfo() << "Client login received";// << profile;// << "device id::" << m.value("deviceId").toStdString();
 			//cp::RpcValue::Map params = rq.params().toMap();
 			//const cp::RpcValue login = params.value("login");
-			cp::RpcValue login_resp = login(rq.params());
-			if(!login_resp.isValid())
-				SHV_EXCEPTION("Invalid authentication for user: " + m_user + " at: " + connectionName());
-			shvInfo().nospace() << "Client logged in user: " << m_user << " from: " << peerAddress() << ':' << peerPort();
-			sendResponse(rq.requestId(), login_resp);
-			m_loginReceived = true;
+			cp::RpcValue request_id = rq.requestId();
+			cp::RpcValue login_params = rq.params();
+			m_user = login_params.toMap().value("login").toMap().value("user").toString();
+			if(resumeSession(request_id, login_params))
+				return;
+			m_loginPending = true;
+			QPointer<ServerConnection> self(this);
+			loginAsync(login_params, [self, request_id, login_params](const cp::RpcValue &login_resp) {
+				if(self)
+					self->finishLogin(request_id, login_params, login_resp);
+			});
 			return;
 		}
 	}
@@ -10,6 +10,8 @@
 
 #include <QObject>
 
+#include <functional>
+#include <memory>
 #include <string>
 
 class QTcpSocket;
@@ -21,6 +23,9 @@ namespace shv {
 namespace iotqt {
 namespace rpc {
 
+class SessionStore;
+class SubscriptionIndex;
+
 class SHVIOTQT_DECL_EXPORT ServerConnection : public SocketRpcDriver, public shv::chainpack::AbstractRpcConnection
 {
 	Q_OBJECT
@@ -34,18 +39,44 @@ public:
 	~ServerConnection() Q_DECL_OVERRIDE;
 
 	const std::string& connectionName() {return m_connectionName;}
-	void setConnectionName(const std::string &n) {m_connectionName = n; setObjectName(QString::fromStdString(n));}
+	void setConnectionName(const std::string &n)
+	{
+		m_connectionName = n;
+		setObjectName(QString::fromStdString(n));
+		metrics().setLabel(std::to_string(connectionId()) + ' ' + n);
+	}
 
 	void close() Q_DECL_OVERRIDE {closeConnection();}
 	void abort() Q_DECL_OVERRIDE {abortConnection();}
 
 	bool isBrokerConnected() const {return isSocketConnected() && !isInitPhase();}
 
+	/// connection is aborted when no message is received for sec seconds, 0 disables watchdog
+	/// set from client login options (OPT_IDLE_WD_TIMEOUT) automatically
+	int idleWatchDogTimeOut() const {return m_idleWatchDogTimeOut;}
+	void setIdleWatchDogTimeOut(int sec);
+
+	/// enables session resumption, session token is added to login result then
+	/// and sessionState() is saved to store when connection is closed
+	void setSessionStore(const std::shared_ptr<SessionStore> &store) {m_sessionStore = store;}
+	const std::string& sessionToken() const {return m_sessionToken;}
+	/// true if client was logged in with session token of previous connection
+	bool isSessionResumed() const {return m_sessionResumed;}
+
+	/// subscriptions of connection are removed from index, when connection is closed
+	void setSubscriptionIndex(const std::shared_ptr<SubscriptionIndex> &index) {m_subscriptionIndex = index;}
+	/// subscribe signal method emitted on path and all the paths below it, empty method means all the signals
+	/// @return false if subscription exists already or there is no subscription index
+	bool subscribe(const std::string &path, const std::string &method);
+	bool unsubscribe(const std::string &path, const std::string &method);
+
 	Q_SIGNAL void rpcMessageReceived(const shv::chainpack::RpcMessage &msg);
 
 	/// AbstractRpcConnection interface implementation
 	void sendMessage(const shv::chainpack::RpcMessage &rpc_msg) override;
 	shv::chainpack::RpcResponse sendMessageSync(const shv::chainpack::RpcRequest &rpc_request, int time_out_ms = DEFAULT_RPC_TIMEOUT) override;
+	void sendMessageAsync(const shv::chainpack::RpcRequest &rpc_request, ResponseCallback &&callback, int time_out_ms = DEFAULT_RPC_TIMEOUT) override;
+	void cancelMessageAsync(unsigned request_id) override;
 	void onRpcMessageReceived(const shv::chainpack::RpcMessage &msg) override;
 protected:
 	void onRpcDataReceived(shv::chainpack::Rpc::ProtocolType protocol_version, shv::chainpack::RpcValue::MetaData &&md, const std::string &data, size_t start_pos, size_t data_len) override;
@@ -56,12 +87,42 @@ protected:
 	virtual void processInitPhase(const chainpack::RpcMessage &msg);
 	virtual shv::chainpack::RpcValue login(const shv::chainpack::RpcValue &auth_params) = 0;
 	//virtual shv::chainpack::RpcValue createLoginResult() = 0;
+	/// invalid login result means authentication failure
+	using LoginCallback = std::function<void (const shv::chainpack::RpcValue &login_result)>;
+	/// default implementation calls login() synchronously, reimplement to verify logins
+	/// asynchronously or in batches, see LoginBatcher, callback must be called in this object thread
+	virtual void loginAsync(const shv::chainpack::RpcValue &auth_params, LoginCallback &&callback);
+
+	/// reimplement to save subscriptions, mount points, etc. for connection resumed later
+	virtual shv::chainpack::RpcValue sessionState() {return shv::chainpack::RpcValue();}
+	/// called after login with valid session token, instead of login()
+	virtual void restoreSessionState(const shv::chainpack::RpcValue &state) {Q_UNUSED(state)}
+
+	static constexpr size_t NONCE_LENGTH = 32;
+	/// 128 bit random hex string
+	static std::string createNonce();
+private:
+	void finishLogin(const shv::chainpack::RpcValue &request_id, const shv::chainpack::RpcValue &auth_params, const shv::chainpack::RpcValue &login_resp);
+	bool resumeSession(const shv::chainpack::RpcValue &request_id, const shv::chainpack::RpcValue &auth_params);
+	shv::chainpack::RpcValue addSessionToLoginResult(const shv::chainpack::RpcValue &login_resp);
+	void suspendSession();
+	void removeSubscriptions();
+	void scheduleIdleWatchDog(int msec);
+	void checkIdleWatchDog();
 protected:
 	std::string m_connectionName;
 	std::string m_user;
 	std::string m_pendingAuthNonce;
 	bool m_helloReceived = false;
 	bool m_loginReceived = false;
+	bool m_loginPending = false;
+	int m_idleWatchDogTimeOut = 0;
+	bool m_idleWatchDogScheduled = false;
+	int64_t m_lastActivityMsec = 0;
+	std::shared_ptr<SessionStore> m_sessionStore;
+	std::string m_sessionToken;
+	bool m_sessionResumed = false;
+	std::shared_ptr<SubscriptionIndex> m_subscriptionIndex;
 	//int m_sessionClientId = 0;
 	//bool m_sessionValidated = false;
 };
@@ -0,0 +1,124 @@
+#include "sessionstore.h"
+
+#include <shv/chainpack/timerwheel.h>
+
+#include <QCryptographicHash>
+
+namespace cp = shv::chainpack;
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+namespace {
+
+/// comparison time does not depend on position of first different character
+bool equal_secrets(const std::string &s1, const std::string &s2)
+{
+	if(s1.size() != s2.size())
+		return false;
+	unsigned char diff = 0;
+	for (size_t i = 0; i < s1.size(); ++i)
+		diff |= static_cast<unsigned char>(s1[i] ^ s2[i]);
+	return diff == 0;
+}
+
+}
+
+void SessionStore::addSession(const std::string &token, int connection_id, const std::string &user, const cp::RpcValue &login_result)
+{
+	int64_t now = cp::TimerWheel::monotonicMsec();
+	std::string id = sessionId(token);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	purgeExpired(now);
+	m_sessions[id] = Entry{token, Session{user, login_result, cp::RpcValue(), {}}, connection_id, 0};
+}
+
+void SessionStore::suspendSession(const std::string &token, int connection_id, const cp::RpcValue &state
+								  , std::vector<SubscriptionIndex::Subscription> &&subscriptions)
+{
+	int64_t now = cp::TimerWheel::monotonicMsec();
+	std::string id = sessionId(token);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_sessions.find(id);
+	if(it == m_sessions.end() || it->second.connectionId != connection_id)
+		return;
+	if(m_timeToLive <= 0) {
+		m_sessions.erase(it);
+		return;
+	}
+	it->second.session.state = state;
+	it->second.session.subscriptions = std::move(subscriptions);
+	it->second.connectionId = 0;
+	it->second.expireMsec = now + m_timeToLive * 1000;
+}
+
+bool SessionStore::resumeSession(const std::string &session_id, const std::string &nonce, const std::string &proof
+								 , const std::string &user, int connection_id, const std::string &new_token, Session &session)
+{
+	int64_t now = cp::TimerWheel::monotonicMsec();
+	std::string new_id = sessionId(new_token);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	purgeExpired(now);
+	auto it = m_sessions.find(session_id);
+	if(it == m_sessions.end())
+		return false;
+	Entry &e = it->second;
+	if(e.connectionId != 0 || e.session.user != user)
+		return false;
+	if(e.expireMsec <= now) {
+		m_sessions.erase(it);
+		return false;
+	}
+	if(nonce.empty() || !equal_secrets(proof, sessionProof(nonce, e.token)))
+		return false;
+	session = std::move(e.session);
+	m_sessions.erase(it);
+	m_sessions[new_id] = Entry{new_token, Session{session.user, session.loginResult, cp::RpcValue(), {}}, connection_id, 0};
+	return true;
+}
+
+void SessionStore::removeSession(const std::string &token, int connection_id)
+{
+	std::string id = sessionId(token);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_sessions.find(id);
+	if(it != m_sessions.end() && it->second.connectionId == connection_id)
+		m_sessions.erase(it);
+}
+
+size_t SessionStore::sessionCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_sessions.size();
+}
+
+std::string SessionStore::sessionId(const std::string &token)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(token.data(), static_cast<int>(token.size()));
+	return hash.result().toHex().toStdString();
+}
+
+std::string SessionStore::sessionProof(const std::string &nonce, const std::string &token)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(nonce.data(), static_cast<int>(nonce.size()));
+	hash.addData(token.data(), static_cast<int>(token.size()));
+	return hash.result().toHex().toStdString();
+}
+
+void SessionStore::purgeExpired(int64_t now_msec)
+{
+	if(now_msec - m_lastPurgeMsec < 1000)
+		return;
+	m_lastPurgeMsec = now_msec;
+	for(auto it = m_sessions.begin(); it != m_sessions.end(); ) {
+		if(it->second.connectionId == 0 && it->second.expireMsec <= now_msec)
+			it = m_sessions.erase(it);
+		else
+			++it;
+	}
+}
+
+}}}
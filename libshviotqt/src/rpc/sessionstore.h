@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../shviotqtglobal.h"
+#include "subscriptionindex.h"
+
+#include <shv/chainpack/rpcvalue.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+/// Keeps server side state of closed connections for timeToLive() seconds,
+/// client reconnecting with session token from its login result gets the state back
+/// without authentication and without rebuilding subscriptions, mount points, etc.
+/// Token itself is never sent back, client proves it knows the token by sessionProof() bound
+/// to hello nonce, sessions are looked up by sessionId() and each resume issues new token.
+/// Class is thread safe, one store can be shared by connections from all worker threads.
+class SHVIOTQT_DECL_EXPORT SessionStore
+{
+public:
+	struct Session
+	{
+		std::string user;
+		shv::chainpack::RpcValue loginResult;
+		/// application defined, see ServerConnection::sessionState()
+		shv::chainpack::RpcValue state;
+		/// signals subscribed by connection, resumed connection does not subscribe them again
+		std::vector<SubscriptionIndex::Subscription> subscriptions;
+	};
+public:
+	explicit SessionStore(int time_to_live_sec = 60) : m_timeToLive(time_to_live_sec) {}
+
+	int timeToLive() const {return m_timeToLive;}
+	void setTimeToLive(int sec) {m_timeToLive = sec;}
+
+	/// registers session of logged in connection
+	void addSession(const std::string &token, int connection_id, const std::string &user, const shv::chainpack::RpcValue &login_result);
+	/// called when connection is closed, session can be resumed within timeToLive() seconds then
+	void suspendSession(const std::string &token, int connection_id, const shv::chainpack::RpcValue &state
+						, std::vector<SubscriptionIndex::Subscription> &&subscriptions);
+	/// session of other live connection cannot be resumed, its state is not saved yet
+	/// @param proof sessionProof() of nonce sent in hello response and of session token
+	/// @return true if suspended session for user exists and proof matches, session is attached
+	/// to connection_id under new_token then and the old token is not valid anymore
+	bool resumeSession(const std::string &session_id, const std::string &nonce, const std::string &proof
+					   , const std::string &user, int connection_id, const std::string &new_token, Session &session);
+	/// removes session when it is owned by connection_id
+	void removeSession(const std::string &token, int connection_id);
+	size_t sessionCount() const;
+
+	/// session lookup key sent by client instead of token
+	static std::string sessionId(const std::string &token);
+	static std::string sessionProof(const std::string &nonce, const std::string &token);
+private:
+	/// expired sessions are removed at most once per second
+	void purgeExpired(int64_t now_msec);
+private:
+	struct Entry
+	{
+		std::string token;
+		Session session;
+		/// 0 when suspended
+		int connectionId;
+		int64_t expireMsec;
+	};
+	mutable std::mutex m_mutex;
+	/// by session id
+	std::unordered_map<std::string, Entry> m_sessions;
+	int m_timeToLive;
+	int64_t m_lastPurgeMsec = 0;
+};
+
+}}}
@@ -0,0 +1,53 @@
+#include "sharedtimerwheel.h"
+
+#include <QThreadStorage>
+#include <QTimer>
+
+namespace cp = shv::chainpack;
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+constexpr SharedTimerWheel::TimerId SharedTimerWheel::INVALID_TIMER_ID;
+constexpr int SharedTimerWheel::TICK_MSEC;
+
+static QThreadStorage<SharedTimerWheel*> s_threadTimerWheels;
+
+SharedTimerWheel *SharedTimerWheel::instance()
+{
+	if(!s_threadTimerWheels.hasLocalData())
+		s_threadTimerWheels.setLocalData(new SharedTimerWheel());
+	return s_threadTimerWheels.localData();
+}
+
+SharedTimerWheel::SharedTimerWheel(QObject *parent)
+	: QObject(parent)
+	, m_timerWheel(TICK_MSEC)
+{
+	m_tickTimer = new QTimer(this);
+	m_tickTimer->setInterval(TICK_MSEC);
+	connect(m_tickTimer, &QTimer::timeout, this, &SharedTimerWheel::onTick);
+}
+
+SharedTimerWheel::TimerId SharedTimerWheel::addTimer(int timeout_msec, cp::TimerWheel::Callback &&callback)
+{
+	TimerId id = m_timerWheel.addTimer(cp::TimerWheel::monotonicMsec(), timeout_msec, std::move(callback));
+	if(!m_tickTimer->isActive())
+		m_tickTimer->start();
+	return id;
+}
+
+bool SharedTimerWheel::cancelTimer(TimerId id)
+{
+	return m_timerWheel.cancelTimer(id);
+}
+
+void SharedTimerWheel::onTick()
+{
+	m_timerWheel.advance(cp::TimerWheel::monotonicMsec());
+	if(m_timerWheel.isEmpty())
+		m_tickTimer->stop();
+}
+
+}}}
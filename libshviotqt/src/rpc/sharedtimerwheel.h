@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../shviotqtglobal.h"
+
+#include <shv/chainpack/timerwheel.h>
+
+#include <QObject>
+
+class QTimer;
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+/// Timer wheel shared by all the connections living in one thread,
+/// single QTimer ticks while there are any timers in the wheel.
+/// Used for login timeouts, idle watchdogs and RPC request timeouts checking,
+/// so thousands of connections do not need thousands of QTimers.
+class SHVIOTQT_DECL_EXPORT SharedTimerWheel : public QObject
+{
+	Q_OBJECT
+public:
+	using TimerId = shv::chainpack::TimerWheel::TimerId;
+	static constexpr TimerId INVALID_TIMER_ID = shv::chainpack::TimerWheel::INVALID_TIMER_ID;
+	static constexpr int TICK_MSEC = 100;
+public:
+	/// wheel of the current thread, created on first use and deleted when thread exits
+	static SharedTimerWheel* instance();
+
+	/// callback is called once in this object thread, add and cancel must be called in this thread too
+	TimerId addTimer(int timeout_msec, shv::chainpack::TimerWheel::Callback &&callback);
+	bool cancelTimer(TimerId id);
+	size_t timerCount() const {return m_timerWheel.timerCount();}
+private:
+	explicit SharedTimerWheel(QObject *parent = nullptr);
+	void onTick();
+private:
+	shv::chainpack::TimerWheel m_timerWheel;
+	QTimer *m_tickTimer;
+};
+
+}}}
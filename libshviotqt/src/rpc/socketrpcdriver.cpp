@@ -1,5 +1,6 @@
 #include "socketrpcdriver.h"
 #include "rpc.h"
+#include "sharedtimerwheel.h"
 
 #include <shv/coreqt/log.h>
 
@@ -7,12 +8,13 @@
 
 #include <shv/core/exception.h>
 
+#include <QPointer>
 #include <QTimer>
-#include <QElapsedTimer>
-#include <QEventLoop>
 #include <QTcpSocket>
 #include <QHostAddress>
 
+#include <atomic>
+
 //#define DUMP_DATA_FILE
 
 #ifdef DUMP_DATA_FILE
@@ -20,11 +22,8 @@
 #endif
 
 
-#define smcDebug QNoDebug
-
-#define logRpcMsg() shvCDebug("RpcMsg")
-#define logRpcData() shvCDebug("RpcData")
-#define logRpcSyncCalls() shvCDebug("RpcSyncCalls")
+#define logRpcMsg() shvCDebugLazy("RpcMsg")
+#define logRpcData() shvCDebugLazy("RpcData")
 
 namespace cp = shv::chainpack;
 //namespace cpq = shv::iotqt::rpc;
@@ -33,13 +32,21 @@ namespace shv {
 namespace iotqt {
 namespace rpc {
 
-static int s_connectionId = 0;
+// connections can be created in more threads
+static std::atomic<int> s_connectionId(0);
 
 SocketRpcDriver::SocketRpcDriver(QObject *parent)
 	: QObject(parent)
 	, m_connectionId(++s_connectionId)
 {
 	Rpc::registerMetatTypes();
+	metrics().setLabel(std::to_string(m_connectionId));
+
+	// timer must be started in this object thread
+	connect(this, &SocketRpcDriver::requestsPending, this, &SocketRpcDriver::schedulePendingRequestsCheck, Qt::QueuedConnection);
+	pendingRequests().setRequestsPendingCallback([this]() {
+		emit requestsPending();
+	});
 	/*
 	setMessageReceivedCallback([this](const shv::shv::chainpack::RpcValue &msg) {
 		emit messageReceived(msg);
@@ -59,6 +66,8 @@ SocketRpcDriver::SocketRpcDriver(QObject *parent)
 SocketRpcDriver::~SocketRpcDriver()
 {
 	shvDebug() << __FUNCTION__;
+	pendingRequests().setRequestsPendingCallback(nullptr);
+	pendingRequests().cancelAll("Connection destroyed");
 	abortConnection();
 }
 
@@ -81,6 +90,7 @@ void SocketRpcDriver::setSocket(QTcpSocket *socket)
 	});
 	connect(socket, &QTcpSocket::disconnected, [this]() {
 		shvDebug() << this << "Socket disconnected!!!";
+		pendingRequests().cancelAll("Socket disconnected");
 		emit socketConnectedChanged(isSocketConnected());
 	});
 }
@@ -143,84 +153,49 @@ bool SocketRpcDriver::flush()
 	return false;
 }
 
-namespace {
-class ConnectionScope
+bool SocketRpcDriver::isWriteBufferFull()
 {
-public:
-	explicit ConnectionScope(QMetaObject::Connection &c) : m_connection(c) {}
-	~ConnectionScope() {if(m_connection) QObject::disconnect(m_connection);}
-private:
-	QMetaObject::Connection &m_connection;
-};
+	return m_socket && m_maxWriteBufferLength > 0 && m_socket->bytesToWrite() >= m_maxWriteBufferLength;
 }
 
-void SocketRpcDriver:: sendRpcRequestSync_helper(const shv::chainpack::RpcRequest &request, shv::chainpack::RpcResponse *presponse, int time_out_ms)
+void SocketRpcDriver::onSendQueueFullChanged(bool is_full)
 {
-	namespace cp = shv::chainpack;
-	smcDebug() << Q_FUNC_INFO << "timeout ms:" << time_out_ms;
-	if(time_out_ms == 0) {
-		smcDebug() << "sendMessageSync called with invalid timeout:" << time_out_ms << "," << defaultRpcTimeout() << "msec will be used instead.";
-		time_out_ms = defaultRpcTimeout();
-	}
-	shv::chainpack::RpcResponse resp_msg;
-	do {
-		const cp::RpcValue msg_id = request.requestId();
-		if(!msg_id.isValid()) {
-			shvWarning() << "Attempt to send RPC request with ID not set, message will be ignored";
-			break;
-		}
-		smcDebug() << "sending message:" << request.toCpon();
-		logRpcSyncCalls() << SND_LOG_ARROW << "SEND SYNC message id:" << msg_id.toCpon() << "msg:" << request.toCpon();
-		sendRpcValue(request.value());
-		QElapsedTimer tm_elapsed;
-		tm_elapsed.start();
-		QEventLoop eloop;
-		QMetaObject::Connection lambda_connection;
-		lambda_connection = connect(this, &SocketRpcDriver::rpcValueReceived, [&eloop, &resp_msg, &lambda_connection, msg_id](const shv::chainpack::RpcValue &msg_val)
-		{
-			shv::chainpack::RpcMessage msg(msg_val);
-			smcDebug() << &eloop << "New RPC message id:" << msg.requestId();
-			if(msg.requestId() == msg_id) {
-				QObject::disconnect(lambda_connection);
-				lambda_connection = QMetaObject::Connection();
-				resp_msg = msg;
-				smcDebug() << "\tID MATCH stopping event loop ..." << &eloop;
-				eloop.quit();
-			}
-			else if(msg.requestId() == 0) {
-				//logRpcSyncCalls() << "<=== RECEIVE NOTIFY while waiting for SYNC response:" << msg.jsonRpcMessage().toString();
-			}
-			else {
-				logRpcSyncCalls() << "RECV other message while waiting for SYNC response id:" << msg.requestId().toCpon() << "json:" << msg.toCpon();
-			}
-		});
-		ConnectionScope cscp(lambda_connection);
-		if(time_out_ms > 0)
-			QTimer::singleShot(time_out_ms, &eloop, &QEventLoop::quit);
-
-		smcDebug() << "\t entering event loop ..." << &eloop;
-		eloop.exec();
-		smcDebug() << "\t event loop" << &eloop << "exec exit, message received:" << resp_msg.isValid();
-		logRpcSyncCalls() << RCV_LOG_ARROW << "RECV SYNC message id:" << resp_msg.requestId().toCpon() << "msg:" << resp_msg.toCpon();
-		int elapsed = (int)tm_elapsed.elapsed();
-		if(elapsed >= time_out_ms) {
-			cp::RpcValue::String err_msg = "Receive message timeout after: " + std::to_string(elapsed) + " msec!";
-			shvError() << err_msg;
-			auto err = cp::RpcResponse::Error::createInternalError(err_msg);
-			resp_msg.setRequestId(msg_id);
-			resp_msg.setError(err);
-		}
-		if(!resp_msg.isValid()) {
-			cp::RpcValue::String err_msg = "Invalid mesage returned from sync call!";
-			shvError() << err_msg;
-
-			auto err = cp::RpcResponse::Error::createInternalError(err_msg);
-			resp_msg.setRequestId(msg_id);
-			resp_msg.setError(err);
-		}
-	} while(false);
-	if(presponse)
-		*presponse = resp_msg;
+	Super::onSendQueueFullChanged(is_full);
+	emit sendQueueFullChanged(is_full);
+}
+
+void SocketRpcDriver::schedulePendingRequestsCheck()
+{
+	if(m_pendingRequestsCheckScheduled)
+		return;
+	m_pendingRequestsCheckScheduled = true;
+	// driver can be destroyed from other thread after its thread is finished, timer cannot be cancelled then
+	QPointer<SocketRpcDriver> self(this);
+	SharedTimerWheel::instance()->addTimer(pendingRequests().tickMsec(), [self]() {
+		if(self)
+			self->checkPendingRequestsTimeouts();
+	});
+}
+
+void SocketRpcDriver::checkPendingRequestsTimeouts()
+{
+	m_pendingRequestsCheckScheduled = false;
+	pendingRequests().checkTimeouts();
+	if(!pendingRequests().isEmpty())
+		schedulePendingRequestsCheck();
+}
+
+void SocketRpcDriver::onCoalescedNotifyPending(int msec)
+{
+	QTimer::singleShot(msec, this, [this]() {
+		flushCoalescedNotifies();
+	});
+}
+
+void SocketRpcDriver::onSendQueueOverflow()
+{
+	shvWarning() << "Connection ID:" << connectionId() << "send queue overflow, aborting connection.";
+	abortConnection();
 }
 
 void SocketRpcDriver::closeConnection()
@@ -27,6 +27,12 @@ public:
 	void setSocket(QTcpSocket *socket);
 	bool hasSocket() const {return m_socket != nullptr;}
 	void setProtocolTypeAsInt(int v) {Super::setProtocolType((shv::chainpack::Rpc::ProtocolType)v);}
+	void setSendQueueWatermarksAsInt(int low_watermark, int high_watermark) {Super::setSendQueueWatermarks(low_watermark, high_watermark);}
+	void setSendQueueOverflowPolicyAsInt(int p) {Super::setSendQueueOverflowPolicy((SendQueueOverflowPolicy)p);}
+
+	/// socket write buffer length, above which data are held in the RpcDriver send queue
+	qint64 maxWriteBufferLength() const {return m_maxWriteBufferLength;}
+	void setMaxWriteBufferLength(qint64 n) {m_maxWriteBufferLength = n;}
 
 	void connectToHost(const QString &host_name, quint16 port);
 
@@ -39,17 +45,26 @@ public:
 	bool isSocketConnected() const;
 	Q_SIGNAL void socketConnectedChanged(bool is_connected);
 
+	Q_SIGNAL void sendQueueFullChanged(bool is_full);
+
 	int connectionId() const {return m_connectionId;}
 
 	std::string peerAddress() const;
 	int peerPort() const;
-public:
-	Q_SLOT void sendRpcRequestSync_helper(const shv::chainpack::RpcRequest& request, shv::chainpack::RpcResponse *presponse, int time_out_ms);
 protected:
+	/// emitted from any thread, when the pending requests table becomes non-empty
+	Q_SIGNAL void requestsPending();
+	void schedulePendingRequestsCheck();
+	void checkPendingRequestsTimeouts();
+
 	// RpcDriver interface
 	bool isOpen() Q_DECL_OVERRIDE;
 	int64_t writeBytes(const char *bytes, size_t length) Q_DECL_OVERRIDE;
 	bool flush() Q_DECL_OVERRIDE;
+	bool isWriteBufferFull() Q_DECL_OVERRIDE;
+	void onSendQueueFullChanged(bool is_full) Q_DECL_OVERRIDE;
+	void onSendQueueOverflow() Q_DECL_OVERRIDE;
+	void onCoalescedNotifyPending(int msec) Q_DECL_OVERRIDE;
 
 	QTcpSocket* socket();
 	void onReadyRead();
@@ -60,6 +75,8 @@ protected:
 	QTcpSocket *m_socket = nullptr;
 private:
 	int m_connectionId;
+	qint64 m_maxWriteBufferLength = 64 * 1024;
+	bool m_pendingRequestsCheckScheduled = false;
 };
 
 }}}
@@ -0,0 +1,199 @@
+#include "subscriptionindex.h"
+
+#include <algorithm>
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+namespace {
+
+/// subscription of all the signals
+const std::string ANY_METHOD;
+
+/// iterates path segments, leading, trailing and double slashes are ignored
+template<typename F>
+bool for_each_segment(const std::string &path, std::string &segment, F &&fn)
+{
+	size_t pos = 0;
+	while(pos < path.size()) {
+		size_t end = path.find('/', pos);
+		if(end == std::string::npos)
+			end = path.size();
+		if(end > pos) {
+			segment.assign(path, pos, end - pos);
+			if(!fn(segment))
+				return false;
+		}
+		pos = end + 1;
+	}
+	return true;
+}
+
+/// path without leading, trailing and double slashes, the same way as trie sees it
+std::string normalized_path(const std::string &path)
+{
+	std::string ret;
+	ret.reserve(path.size());
+	std::string segment;
+	for_each_segment(path, segment, [&ret](const std::string &s) {
+		if(!ret.empty())
+			ret += '/';
+		ret += s;
+		return true;
+	});
+	return ret;
+}
+
+}
+
+bool SubscriptionIndex::subscribe(unsigned connection_id, const std::string &shv_path, const std::string &method)
+{
+	const std::string path = normalized_path(shv_path);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Node *nd = findNode(path, true);
+	if(!nd->subscribers[method].insert(connection_id).second)
+		return false;
+	m_connectionSubscriptions[connection_id].push_back(Subscription{path, method});
+	m_subscriptionCount++;
+	return true;
+}
+
+bool SubscriptionIndex::unsubscribe(unsigned connection_id, const std::string &shv_path, const std::string &method)
+{
+	const std::string path = normalized_path(shv_path);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(!unsubscribe_helper(connection_id, path, method))
+		return false;
+	auto it = m_connectionSubscriptions.find(connection_id);
+	if(it != m_connectionSubscriptions.end()) {
+		std::vector<Subscription> &subscriptions = it->second;
+		auto it2 = std::find_if(subscriptions.begin(), subscriptions.end(), [&path, &method](const Subscription &s) {
+			return s.path == path && s.method == method;
+		});
+		if(it2 != subscriptions.end())
+			subscriptions.erase(it2);
+		if(subscriptions.empty())
+			m_connectionSubscriptions.erase(it);
+	}
+	return true;
+}
+
+void SubscriptionIndex::removeConnection(unsigned connection_id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_connectionSubscriptions.find(connection_id);
+	if(it == m_connectionSubscriptions.end())
+		return;
+	for(const Subscription &s : it->second)
+		unsubscribe_helper(connection_id, s.path, s.method);
+	m_connectionSubscriptions.erase(it);
+}
+
+std::vector<SubscriptionIndex::Subscription> SubscriptionIndex::subscriptionsForConnection(unsigned connection_id) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_connectionSubscriptions.find(connection_id);
+	if(it == m_connectionSubscriptions.end())
+		return std::vector<Subscription>();
+	return it->second;
+}
+
+std::vector<unsigned> SubscriptionIndex::subscribers(const std::string &shv_path, const std::string &method) const
+{
+	std::vector<unsigned> ret;
+	auto collect = [&ret, &method](const Node *nd) {
+		if(nd->subscribers.empty())
+			return;
+		auto it = nd->subscribers.find(method);
+		if(it != nd->subscribers.end())
+			ret.insert(ret.end(), it->second.begin(), it->second.end());
+		if(!method.empty()) {
+			it = nd->subscribers.find(ANY_METHOD);
+			if(it != nd->subscribers.end())
+				ret.insert(ret.end(), it->second.begin(), it->second.end());
+		}
+	};
+	std::string segment;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Node *nd = &m_root;
+	collect(nd);
+	for_each_segment(shv_path, segment, [&nd, &collect](const std::string &s) {
+		auto it = nd->children.find(s);
+		if(it == nd->children.end())
+			return false;
+		nd = it->second.get();
+		collect(nd);
+		return true;
+	});
+	// connection subscribed on more levels of the path is notified once
+	std::sort(ret.begin(), ret.end());
+	ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+	return ret;
+}
+
+size_t SubscriptionIndex::subscriptionCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_subscriptionCount;
+}
+
+SubscriptionIndex::Node *SubscriptionIndex::findNode(const std::string &path, bool create)
+{
+	Node *nd = &m_root;
+	std::string segment;
+	for_each_segment(path, segment, [&nd, create](const std::string &s) {
+		auto it = nd->children.find(s);
+		if(it == nd->children.end()) {
+			if(!create) {
+				nd = nullptr;
+				return false;
+			}
+			it = nd->children.emplace(s, std::unique_ptr<Node>(new Node())).first;
+		}
+		nd = it->second.get();
+		return true;
+	});
+	return nd;
+}
+
+void SubscriptionIndex::prune(const std::string &path)
+{
+	std::vector<std::pair<Node*, std::string>> nodes;
+	Node *nd = &m_root;
+	std::string segment;
+	for_each_segment(path, segment, [&nd, &nodes](const std::string &s) {
+		auto it = nd->children.find(s);
+		if(it == nd->children.end())
+			return false;
+		nodes.emplace_back(nd, s);
+		nd = it->second.get();
+		return true;
+	});
+	// from the leaf up, parent keeps the node while it has children or subscribers
+	for(auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+		Node *parent = it->first;
+		auto child_it = parent->children.find(it->second);
+		const Node *child = child_it->second.get();
+		if(!child->children.empty() || !child->subscribers.empty())
+			break;
+		parent->children.erase(child_it);
+	}
+}
+
+bool SubscriptionIndex::unsubscribe_helper(unsigned connection_id, const std::string &path, const std::string &method)
+{
+	Node *nd = findNode(path, false);
+	if(!nd)
+		return false;
+	auto it = nd->subscribers.find(method);
+	if(it == nd->subscribers.end() || it->second.erase(connection_id) == 0)
+		return false;
+	if(it->second.empty())
+		nd->subscribers.erase(it);
+	m_subscriptionCount--;
+	prune(path);
+	return true;
+}
+
+}}}
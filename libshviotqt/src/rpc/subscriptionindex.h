@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../shviotqtglobal.h"
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace shv {
+namespace iotqt {
+namespace rpc {
+
+/// Subscriptions of server connections to signals (typically chng) emitted on shv path and all the paths below it.
+/// Subscriptions are kept in path trie, each node has connection sets per signal method,
+/// so recipients of notification are found in O(path depth) regardless of the number of subscriptions.
+/// Class is thread safe, one index can be shared by connections from all worker threads.
+class SHVIOTQT_DECL_EXPORT SubscriptionIndex
+{
+public:
+	struct Subscription
+	{
+		std::string path;
+		std::string method;
+	};
+public:
+	/// empty path subscribes all the paths, empty method subscribes all the signals,
+	/// leading, trailing and double slashes in path are ignored
+	/// @return false if subscription exists already
+	bool subscribe(unsigned connection_id, const std::string &path, const std::string &method);
+	/// @return false if subscription does not exist
+	bool unsubscribe(unsigned connection_id, const std::string &path, const std::string &method);
+	/// removes all the subscriptions of closed connection
+	void removeConnection(unsigned connection_id);
+	/// subscriptions in the order they were made, to be saved in suspended session
+	std::vector<Subscription> subscriptionsForConnection(unsigned connection_id) const;
+
+	/// @return sorted ids of connections subscribed to signal method on shv_path
+	std::vector<unsigned> subscribers(const std::string &shv_path, const std::string &method) const;
+	size_t subscriptionCount() const;
+private:
+	struct Node
+	{
+		std::unordered_map<std::string, std::unique_ptr<Node>> children;
+		/// signal method -> subscribed connections
+		std::unordered_map<std::string, std::set<unsigned>> subscribers;
+	};
+	Node* findNode(const std::string &path, bool create);
+	/// removes nodes without subscribers on the path
+	void prune(const std::string &path);
+	bool unsubscribe_helper(unsigned connection_id, const std::string &path, const std::string &method);
+private:
+	mutable std::mutex m_mutex;
+	Node m_root;
+	/// subscriptions of each connection, they are removed when connection is closed
+	std::unordered_map<unsigned, std::vector<Subscription>> m_connectionSubscriptions;
+	size_t m_subscriptionCount = 0;
+};
+
+}}}
@@ -1,16 +1,102 @@
 #include "serverconnection.h"
+#include "sessionstore.h"
+#include "subscriptionindex.h"
 #include "tcpserver.h"
 
 #include <shv/coreqt/log.h>
 
+#include <shv/chainpack/chainpackreader.h>
+#include <shv/chainpack/chainpackwriter.h>
+#include <shv/chainpack/encodedmessage.h>
+#include <shv/chainpack/rpcmessage.h>
+
 #include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <sstream>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace cp = shv::chainpack;
 
 namespace shv {
 namespace iotqt {
 namespace rpc {
 
+/// accepts connections directly in worker thread
+class TcpServer::WorkerListener : public QTcpServer
+{
+public:
+	WorkerListener(TcpServer *server, Worker *worker, QObject *parent)
+		: QTcpServer(parent), m_server(server), m_worker(worker) {}
+protected:
+	void incomingConnection(qintptr socket_descriptor) override
+	{
+		m_worker->connectionCount++;
+		m_server->addWorkerConnection(socket_descriptor, m_worker);
+	}
+private:
+	TcpServer *m_server;
+	Worker *m_worker;
+};
+
+namespace {
+#if defined Q_OS_UNIX && defined SO_REUSEPORT
+/// @return listening socket descriptor or -1 on error, port is updated when 0 is passed
+int open_reuse_port_socket(int &port)
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0)
+		return -1;
+	int on = 1;
+	::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if(::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+		::close(fd);
+		return -1;
+	}
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(static_cast<uint16_t>(port));
+	if(::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+		::close(fd);
+		return -1;
+	}
+	if(port == 0) {
+		socklen_t len = sizeof(addr);
+		if(::getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0)
+			port = ntohs(addr.sin_port);
+	}
+	return fd;
+}
+#endif
+
+/// meta values are shared by RpcValue copies, meta data used in other threads must not share them with caller
+cp::RpcValue::MetaData detached_meta_data(const cp::RpcValue::MetaData &meta_data)
+{
+	std::ostringstream out;
+	{
+		cp::ChainPackWriter wr(out);
+		wr << meta_data;
+	}
+	std::istringstream in(out.str());
+	cp::ChainPackReader rd(in);
+	cp::RpcValue::MetaData ret;
+	rd.read(ret);
+	return ret;
+}
+}
+
 TcpServer::TcpServer(QObject *parent)
 	: Super(parent)
+	, m_subscriptionIndex(std::make_shared<SubscriptionIndex>())
 {
 	connect(this, &QTcpServer::newConnection, this, &TcpServer::onNewConnection);
 }
@@ -18,11 +104,59 @@ TcpServer::TcpServer(QObject *parent)
 TcpServer::~TcpServer()
 {
 	shvInfo() << "Destroying SHV TcpServer";
+	stopWorkers();
+}
+
+void TcpServer::setWorkerThreadCount(int n)
+{
+	if(isListening()) {
+		shvError() << "Worker thread count cannot be changed when server is listening.";
+		return;
+	}
+	stopWorkers();
+	for(int i = 0; i < n; i++) {
+		std::unique_ptr<Worker> w(new Worker());
+		w->thread = new QThread();
+		w->thread->setObjectName("TcpServerWorker" + QString::number(i));
+		w->context = new QObject();
+		w->context->moveToThread(w->thread);
+		w->thread->start();
+		m_workers.push_back(std::move(w));
+	}
+}
+
+void TcpServer::setSessionTimeToLive(int time_to_live_sec)
+{
+	if(time_to_live_sec <= 0)
+		m_sessionStore.reset();
+	else if(m_sessionStore)
+		m_sessionStore->setTimeToLive(time_to_live_sec);
+	else
+		m_sessionStore = std::make_shared<SessionStore>(time_to_live_sec);
+}
+
+void TcpServer::stopWorkers()
+{
+	for(const std::unique_ptr<Worker> &w : m_workers) {
+		// context is deleted with its connections when thread finishes
+		w->context->deleteLater();
+		w->thread->quit();
+	}
+	for(const std::unique_ptr<Worker> &w : m_workers) {
+		w->thread->wait();
+		delete w->thread;
+	}
+	m_workers.clear();
 }
 
 bool TcpServer::start(int port)
 {
-	shvInfo() << "Starting RPC server on port:" << port;
+	shvInfo() << "Starting RPC server on port:" << port << "worker threads:" << workerThreadCount();
+	if(m_reusePortListeners && !m_workers.empty()) {
+		if(startReusePortListeners(port))
+			return true;
+		shvWarning() << "Cannot open SO_REUSEPORT listeners, falling back to single listener.";
+	}
 	if (!listen(QHostAddress::AnyIPv4, port)) {
 		shvError() << tr("Unable to start the server: %1.").arg(errorString());
 		close();
@@ -34,37 +168,243 @@ bool TcpServer::start(int port)
 
 std::vector<unsigned> TcpServer::connectionIds() const
 {
+	std::lock_guard<std::mutex> lock(m_connectionsMutex);
 	std::vector<unsigned> ret;
+	ret.reserve(m_connections.size());
 	for(const auto &pair : m_connections)
 		ret.push_back(pair.first);
+	std::sort(ret.begin(), ret.end());
 	return ret;
 }
 
 ServerConnection *TcpServer::connectionById(unsigned connection_id)
 {
+	std::lock_guard<std::mutex> lock(m_connectionsMutex);
 	auto it = m_connections.find(connection_id);
 	if(it == m_connections.end())
 		return nullptr;
 	return it->second;
 }
 
+bool TcpServer::sendMessageToConnection(unsigned connection_id, const cp::RpcMessage &msg)
+{
+	QObject *context;
+	{
+		std::lock_guard<std::mutex> lock(m_connectionsMutex);
+		auto it = m_connectionContexts.find(connection_id);
+		if(it == m_connectionContexts.end())
+			return false;
+		context = it->second;
+	}
+	if(context->thread() == QThread::currentThread()) {
+		ServerConnection *c = connectionById(connection_id);
+		if(c)
+			c->sendMessage(msg);
+		return c != nullptr;
+	}
+	// connection is looked up again in its own thread, where it cannot be deleted meanwhile
+	// context lives as long as its thread, so it is valid even if connection is gone already
+	// msg shares data with the caller, it is deep copied to be read in the other thread
+	std::shared_ptr<const cp::EncodedMessage> encoded_msg = std::make_shared<const cp::EncodedMessage>(msg.value());
+	QTimer::singleShot(0, context, [this, connection_id, encoded_msg]() {
+		ServerConnection *c = connectionById(connection_id);
+		if(c)
+			c->sendEncodedMessage(*encoded_msg);
+	});
+	return true;
+}
+
+size_t TcpServer::sendMessageToConnections(const std::vector<unsigned> &connection_ids, const cp::RpcMessage &msg)
+{
+	std::shared_ptr<const cp::EncodedMessage> encoded_msg = std::make_shared<const cp::EncodedMessage>(msg.value());
+	return forEachConnection(connection_ids, [encoded_msg](ServerConnection *c) {
+		c->sendEncodedMessage(*encoded_msg);
+	});
+}
+
+size_t TcpServer::sendRawDataToConnections(const std::vector<unsigned> &connection_ids, const cp::RpcValue::MetaData &meta_data, const std::string &data)
+{
+	// copied once, shared by all the connection threads and never modified
+	auto shared_meta_data = std::make_shared<const cp::RpcValue::MetaData>(detached_meta_data(meta_data));
+	auto shared_data = std::make_shared<const std::string>(data);
+	return forEachConnection(connection_ids, [shared_meta_data, shared_data](ServerConnection *c) {
+		c->sendRawData(*shared_meta_data, std::string(*shared_data));
+	});
+}
+
+size_t TcpServer::sendSignalToSubscribers(const cp::RpcMessage &signal)
+{
+	std::vector<unsigned> connection_ids = m_subscriptionIndex->subscribers(signal.shvPath().toString(), signal.method().toString());
+	if(connection_ids.empty())
+		return 0;
+	return sendMessageToConnections(connection_ids, signal);
+}
+
+size_t TcpServer::sendRawSignalToSubscribers(const cp::RpcValue::MetaData &meta_data, const std::string &data)
+{
+	std::vector<unsigned> connection_ids = m_subscriptionIndex->subscribers(cp::RpcMessage::shvPath(meta_data).toString()
+																			, cp::RpcMessage::method(meta_data).toString());
+	if(connection_ids.empty())
+		return 0;
+	return sendRawDataToConnections(connection_ids, meta_data, data);
+}
+
+size_t TcpServer::forEachConnection(const std::vector<unsigned> &connection_ids, const ConnectionFunction &fn)
+{
+	// connections grouped by their thread, one call is posted per thread
+	std::map<QObject*, std::vector<unsigned>> context_connections;
+	{
+		std::lock_guard<std::mutex> lock(m_connectionsMutex);
+		for(unsigned connection_id : connection_ids) {
+			auto it = m_connectionContexts.find(connection_id);
+			if(it != m_connectionContexts.end())
+				context_connections[it->second].push_back(connection_id);
+		}
+	}
+	size_t n = 0;
+	for(const auto &kv : context_connections) {
+		QObject *context = kv.first;
+		const std::vector<unsigned> &ids = kv.second;
+		n += ids.size();
+		if(context->thread() == QThread::currentThread()) {
+			forEachConnection_helper(ids, fn);
+		}
+		else {
+			QTimer::singleShot(0, context, [this, ids, fn]() {
+				forEachConnection_helper(ids, fn);
+			});
+		}
+	}
+	return n;
+}
+
+void TcpServer::forEachConnection_helper(const std::vector<unsigned> &connection_ids, const ConnectionFunction &fn)
+{
+	// notification transcoded for the first connection is reused by the others
+	cp::RpcDriver::NotifyFanOutScope fan_out_scope;
+	for(unsigned connection_id : connection_ids) {
+		ServerConnection *c = connectionById(connection_id);
+		if(c)
+			fn(c);
+	}
+}
+
+bool TcpServer::startReusePortListeners(int port)
+{
+#if defined Q_OS_UNIX && defined SO_REUSEPORT
+	std::vector<int> fds;
+	for(size_t i = 0; i <= m_workers.size(); i++) {
+		int fd = open_reuse_port_socket(port);
+		if(fd < 0) {
+			shvError() << "Cannot open SO_REUSEPORT listening socket on port:" << port << "errno:" << errno;
+			for(int fd2 : fds)
+				::close(fd2);
+			return false;
+		}
+		fds.push_back(fd);
+	}
+	// the first listener accepts in server thread and shards connections as usual
+	if(!setSocketDescriptor(fds[0])) {
+		shvError() << tr("Unable to start the server: %1.").arg(errorString());
+		for(int fd : fds)
+			::close(fd);
+		return false;
+	}
+	for(size_t i = 0; i < m_workers.size(); i++) {
+		Worker *w = m_workers[i].get();
+		int fd = fds[i + 1];
+		QTimer::singleShot(0, w->context, [this, w, fd]() {
+			WorkerListener *listener = new WorkerListener(this, w, w->context);
+			if(!listener->setSocketDescriptor(fd)) {
+				shvError() << "Unable to start worker listener:" << listener->errorString();
+				delete listener;
+				::close(fd);
+			}
+		});
+	}
+	shvInfo().nospace() << "RPC server is listenning on " << serverAddress().toString() << ":" << serverPort()
+						<< " with " << fds.size() << " SO_REUSEPORT listeners";
+	return true;
+#else
+	Q_UNUSED(port)
+	return false;
+#endif
+}
+
+TcpServer::Worker *TcpServer::selectWorker()
+{
+	if(m_workerAssignment == WorkerAssignment::LeastLoaded) {
+		Worker *ret = m_workers[0].get();
+		for(const std::unique_ptr<Worker> &w : m_workers) {
+			if(w->connectionCount < ret->connectionCount)
+				ret = w.get();
+		}
+		return ret;
+	}
+	Worker *ret = m_workers[m_nextWorkerIndex].get();
+	m_nextWorkerIndex = (m_nextWorkerIndex + 1) % m_workers.size();
+	return ret;
+}
+
+void TcpServer::incomingConnection(qintptr socket_descriptor)
+{
+	if(m_workers.empty()) {
+		Super::incomingConnection(socket_descriptor);
+		return;
+	}
+	Worker *w = selectWorker();
+	// count connection immediately, so the next least loaded selection sees it
+	w->connectionCount++;
+	QTimer::singleShot(0, w->context, [this, w, socket_descriptor]() {
+		addWorkerConnection(socket_descriptor, w);
+	});
+}
+
+void TcpServer::addWorkerConnection(qintptr socket_descriptor, Worker *worker)
+{
+	QTcpSocket *sock = new QTcpSocket();
+	if(!sock->setSocketDescriptor(socket_descriptor)) {
+		shvError() << "Cannot set socket descriptor:" << sock->errorString();
+		delete sock;
+		worker->connectionCount--;
+		return;
+	}
+	addConnection(sock, worker->context, worker);
+}
+
 void TcpServer::onNewConnection()
 {
 	QTcpSocket *sock = nextPendingConnection();
-	if(sock) {
-		shvInfo().nospace() << "client connected: " << sock->peerAddress().toString() << ':' << sock->peerPort();// << "socket:" << sock << sock->socketDescriptor() << "state:" << sock->state();
-		ServerConnection *c = createServerConnection(sock, this);
-		m_connections[c->connectionId()] = c;
-		int cid = c->connectionId();
-		connect(c, &ServerConnection::destroyed, [this, cid]() {
-			onConnectionDeleted(cid);
-		});
+	if(sock)
+		addConnection(sock, this, nullptr);
+}
+
+void TcpServer::addConnection(QTcpSocket *socket, QObject *context, Worker *worker)
+{
+	shvInfo().nospace() << "client connected: " << socket->peerAddress().toString() << ':' << socket->peerPort();// << "socket:" << sock << sock->socketDescriptor() << "state:" << sock->state();
+	ServerConnection *c = createServerConnection(socket, context);
+	if(m_sessionStore)
+		c->setSessionStore(m_sessionStore);
+	c->setSubscriptionIndex(m_subscriptionIndex);
+	int cid = c->connectionId();
+	{
+		std::lock_guard<std::mutex> lock(m_connectionsMutex);
+		m_connections[cid] = c;
+		m_connectionContexts[cid] = context;
 	}
+	// destroyed is emitted in connection thread, registry must be updated before the connection is gone
+	connect(c, &ServerConnection::destroyed, this, [this, cid, worker]() {
+		if(worker)
+			worker->connectionCount--;
+		onConnectionDeleted(cid);
+	}, Qt::DirectConnection);
 }
 
 void TcpServer::onConnectionDeleted(int connection_id)
 {
+	std::lock_guard<std::mutex> lock(m_connectionsMutex);
 	m_connections.erase(connection_id);
+	m_connectionContexts.erase(connection_id);
 }
 
 }}}
@@ -7,13 +7,25 @@
 
 #include <QTcpServer>
 
-namespace shv { namespace chainpack { class RpcMessage; }}
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class QThread;
+
+namespace shv { namespace chainpack { class RpcMessage; class EncodedMessage; }}
 
 namespace shv {
 namespace iotqt {
 namespace rpc {
 
 class ServerConnection;
+class SessionStore;
+class SubscriptionIndex;
 
 class SHVIOTQT_DECL_EXPORT TcpServer : public QTcpServer
 {
@@ -23,20 +35,95 @@ class SHVIOTQT_DECL_EXPORT TcpServer : public QTcpServer
 	using Super = QTcpServer;
 
 	//SHV_FIELD_IMPL(int, p, P, ort)
+public:
+	enum class WorkerAssignment {RoundRobin, LeastLoaded};
 public:
 	explicit TcpServer(QObject *parent = 0);
 	~TcpServer() override;
 
+	/// connections are distributed to worker threads, each running its own event loop
+	/// 0 (default) means that all the connections live in the server thread
+	/// must be set before start()
+	void setWorkerThreadCount(int n);
+	int workerThreadCount() const {return static_cast<int>(m_workers.size());}
+	void setWorkerAssignment(WorkerAssignment wa) {m_workerAssignment = wa;}
+	WorkerAssignment workerAssignment() const {return m_workerAssignment;}
+	/// start() opens one listening socket with SO_REUSEPORT per worker thread plus one for server thread,
+	/// kernel balances new connections between them and accept runs in parallel,
+	/// ignored without worker threads or on platforms not supporting SO_REUSEPORT
+	void setReusePortListeners(bool on) {m_reusePortListeners = on;}
+	bool isReusePortListeners() const {return m_reusePortListeners;}
+
+	/// clients reconnecting within time_to_live_sec can resume their session, see ServerConnection::sessionState()
+	/// 0 (default) disables session resumption, must be set before start()
+	void setSessionTimeToLive(int time_to_live_sec);
+	const std::shared_ptr<SessionStore>& sessionStore() const {return m_sessionStore;}
+
 	bool start(int port);
+	/// connectionIds() and connectionById() are thread safe,
+	/// but the connection returned can be used in its own thread only
 	std::vector<unsigned> connectionIds() const;
 	ServerConnection* connectionById(unsigned connection_id);
+	/// thread safe, message is sent from the connection thread
+	/// @return false if connection does not exist
+	bool sendMessageToConnection(unsigned connection_id, const shv::chainpack::RpcMessage &msg);
+	/// thread safe, message is encoded once per protocol and shared by all the connections, see EncodedMessage
+	/// @return number of existing connections the message is sent to
+	size_t sendMessageToConnections(const std::vector<unsigned> &connection_ids, const shv::chainpack::RpcMessage &msg);
+	/// thread safe, forwards message data encoded in meta data protocol type without building RpcValue,
+	/// notification transcoded for one connection is reused by the other connections in the same thread
+	/// @return number of existing connections the data are sent to
+	size_t sendRawDataToConnections(const std::vector<unsigned> &connection_ids, const shv::chainpack::RpcValue::MetaData &meta_data, const std::string &data);
+
+	/// subscriptions of all the connections, see ServerConnection::subscribe()
+	const std::shared_ptr<SubscriptionIndex>& subscriptionIndex() const {return m_subscriptionIndex;}
+	/// thread safe, signal is sent to connections subscribed to its shv path and method
+	/// @return number of connections the signal is sent to
+	size_t sendSignalToSubscribers(const shv::chainpack::RpcMessage &signal);
+	/// thread safe, signal data are forwarded like in sendRawDataToConnections()
+	size_t sendRawSignalToSubscribers(const shv::chainpack::RpcValue::MetaData &meta_data, const std::string &data);
 protected:
+	/// called in the thread where connection will live, it is a worker thread in multi-threaded mode
 	virtual ServerConnection* createServerConnection(QTcpSocket *socket, QObject *parent) = 0;
+	void incomingConnection(qintptr socket_descriptor) override;
 	void onNewConnection();
 	void onConnectionDeleted(int connection_id);
+private:
+	struct Worker
+	{
+		QThread *thread = nullptr;
+		/// object living in worker thread, parent of worker connections and listener
+		QObject *context = nullptr;
+		std::atomic<int> connectionCount;
+
+		Worker() : connectionCount(0) {}
+	};
+	class WorkerListener;
+
+	Worker* selectWorker();
+	void addConnection(QTcpSocket *socket, QObject *context, Worker *worker);
+	using ConnectionFunction = std::function<void (ServerConnection *connection)>;
+	/// fn is called for every existing connection in the connection thread, one call is posted per thread
+	size_t forEachConnection(const std::vector<unsigned> &connection_ids, const ConnectionFunction &fn);
+	void forEachConnection_helper(const std::vector<unsigned> &connection_ids, const ConnectionFunction &fn);
+	void addWorkerConnection(qintptr socket_descriptor, Worker *worker);
+	bool startReusePortListeners(int port);
+	void stopWorkers();
 protected:
-	std::map<unsigned, ServerConnection*> m_connections;
+	/// guarded by m_connectionsMutex when worker threads are used
+	/// hashed, connection is looked up for every message routed by broker
+	std::unordered_map<unsigned, ServerConnection*> m_connections;
+	mutable std::mutex m_connectionsMutex;
+private:
+	/// object living in the connection thread, messages for connection are posted to it
+	std::unordered_map<unsigned, QObject*> m_connectionContexts;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	WorkerAssignment m_workerAssignment = WorkerAssignment::RoundRobin;
+	size_t m_nextWorkerIndex = 0;
+	bool m_reusePortListeners = false;
+	/// shared with connections, which can outlive the server members during destruction
+	std::shared_ptr<SessionStore> m_sessionStore;
+	std::shared_ptr<SubscriptionIndex> m_subscriptionIndex;
 };
 
 }}}
-
@@ -1,5 +1,7 @@
 #include "tunnelconnection.h"
 
+#include <shv/chainpack/metastruct.h>
+
 namespace cp = shv::chainpack;
 
 namespace shv {
@@ -19,33 +21,43 @@ TunnelConnection::TunnelConnection(QObject *parent)
 	setConnectionType(cp::Rpc::TYPE_TUNNEL);
 }
 
+namespace {
+
+using Key = TunnelParams::MetaType::Key;
+
+constexpr cp::meta::MetaInfo tunnel_params_keys[] = {
+	RPC_META_KEY_INFO(Host),
+	RPC_META_KEY_INFO(Port),
+	RPC_META_KEY_INFO(User),
+	RPC_META_KEY_INFO(Password),
+	RPC_META_KEY_INFO(ParentClientId),
+	RPC_META_KEY_INFO(CallerClientIds),
+	//RPC_META_KEY_INFO(TunName),
+	//RPC_META_KEY_INFO(TunnelResponseRequestId),
+};
+static_assert(cp::meta::MetaInfoTable(tunnel_params_keys, Key::Host).isConsecutive(), "TunnelParams keys table is not consecutive");
+
+using FieldsSchema = cp::meta::StructSchema<
+	SHV_META_FIELD(Key::Host, TunnelParams::Fields, host),
+	SHV_META_FIELD(Key::Port, TunnelParams::Fields, port),
+	SHV_META_FIELD(Key::User, TunnelParams::Fields, user),
+	SHV_META_FIELD(Key::Password, TunnelParams::Fields, password),
+	SHV_META_FIELD(Key::ParentClientId, TunnelParams::Fields, parentClientId),
+	SHV_META_FIELD(Key::CallerClientIds, TunnelParams::Fields, callerClientIds)
+>;
+
+}
+
 TunnelParams::MetaType::MetaType()
-	: Super("TunnelParams")
+	: Super("TunnelParams", cp::meta::MetaInfoTable(), cp::meta::MetaInfoTable(tunnel_params_keys, Key::Host))
 {
-	m_keys = {
-		RPC_META_KEY_DEF(Host),
-		RPC_META_KEY_DEF(Port),
-		RPC_META_KEY_DEF(User),
-		RPC_META_KEY_DEF(Password),
-		RPC_META_KEY_DEF(ParentClientId),
-		RPC_META_KEY_DEF(CallerClientIds),
-		//RPC_META_KEY_DEF(TunName),
-		//RPC_META_KEY_DEF(TunnelResponseRequestId),
-	};
-	//m_tags = {
-	//	{(int)Tag::RequestId, {(int)Tag::RequestId, "id"}},
-	//	{(int)Tag::ShvPath, {(int)Tag::ShvPath, "shvPath"}},
-	//};
 }
 
 void TunnelParams::MetaType::registerMetaType()
 {
-	static bool is_init = false;
-	if(!is_init) {
-		is_init = true;
-		static MetaType s;
-		shv::chainpack::meta::registerType(shv::chainpack::meta::GlobalNS::ID, MetaType::ID, &s);
-	}
+	static MetaType s;
+	static const bool is_init = (cp::meta::registerType(cp::meta::GlobalNS::ID, MetaType::ID, &s), true);
+	(void)is_init;
 }
 
 TunnelParams::TunnelParams()
@@ -60,6 +72,40 @@ TunnelParams::TunnelParams(const IMap &m)
 	MetaType::registerMetaType();
 }
 
+TunnelParams::TunnelParams(const TunnelParams::Fields &fields)
+	: Super(fields.toIMap())
+{
+	MetaType::registerMetaType();
+}
+
+TunnelParams::Fields TunnelParams::Fields::fromIMap(const chainpack::RpcValue::IMap &m)
+{
+	Fields ret;
+	FieldsSchema::fromIMap(m, ret);
+	return ret;
+}
+
+chainpack::RpcValue::IMap TunnelParams::Fields::toIMap() const
+{
+	return FieldsSchema::toIMap(*this);
+}
+
+void TunnelParams::Fields::write(chainpack::ChainPackWriter &wr) const
+{
+	wr.writeMetaDataBegin();
+	wr.writeIMapKey(cp::meta::Tag::MetaTypeId);
+	wr.writeInt(MetaType::ID);
+	wr.writeContainerEnd();
+	FieldsSchema::write(wr, *this);
+}
+
+TunnelParams::Fields TunnelParams::Fields::read(chainpack::ChainPackReader &rd)
+{
+	Fields ret;
+	FieldsSchema::read(rd, ret);
+	return ret;
+}
+
 chainpack::RpcValue TunnelParams::toRpcValue() const
 {
 	cp::RpcValue ret(*this);
@@ -50,9 +50,28 @@ public:
 
 		static void registerMetaType();
 	};
+	/// typed content of TunnelParams, read and written from ChainPack without IMap
+	struct SHVIOTQT_DECL_EXPORT Fields
+	{
+		shv::chainpack::meta::Optional<std::string> host;
+		shv::chainpack::meta::Optional<shv::chainpack::RpcValue::Int> port;
+		shv::chainpack::meta::Optional<std::string> user;
+		shv::chainpack::meta::Optional<std::string> password;
+		shv::chainpack::RpcValue parentClientId;
+		shv::chainpack::meta::Optional<std::vector<shv::chainpack::RpcValue::UInt>> callerClientIds;
+
+		static Fields fromIMap(const shv::chainpack::RpcValue::IMap &m);
+		shv::chainpack::RpcValue::IMap toIMap() const;
+		/// written with meta type id as toRpcValue() is
+		void write(shv::chainpack::ChainPackWriter &wr) const;
+		static Fields read(shv::chainpack::ChainPackReader &rd);
+	};
 public:
 	TunnelParams();
 	TunnelParams(const shv::chainpack::RpcValue::IMap &m);
+	TunnelParams(const Fields &fields);
+
+	Fields fields() const {return Fields::fromIMap(*this);}
 	//TunnelParams& operator=(TunnelParams &&o) {Super::operator =(std::move(o)); return *this;}
 
 	shv::chainpack::RpcValue toRpcValue() const;
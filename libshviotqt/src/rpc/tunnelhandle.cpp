@@ -1,32 +1,40 @@
 #include "tunnelhandle.h"
 
+#include <shv/chainpack/metastruct.h>
+
 namespace cp = shv::chainpack;
 
 namespace shv {
 namespace iotqt {
 namespace rpc {
 
+namespace {
+
+using Key = TunnelHandle::MetaType::Key;
+
+constexpr cp::meta::MetaInfo tunnel_handle_keys[] = {
+	RPC_META_KEY_INFO(CallerClientIds),
+	RPC_META_KEY_INFO(TunnelClientId),
+};
+static_assert(cp::meta::MetaInfoTable(tunnel_handle_keys, Key::CallerClientIds).isConsecutive(), "TunnelHandle keys table is not consecutive");
+
+using FieldsSchema = cp::meta::StructSchema<
+	SHV_META_FIELD(Key::CallerClientIds, TunnelHandle::Fields, callerClientIds),
+	SHV_META_FIELD(Key::TunnelClientId, TunnelHandle::Fields, tunnelClientId)
+>;
+
+}
+
 TunnelHandle::MetaType::MetaType()
-	: Super("TunnelHandle")
+	: Super("TunnelHandle", cp::meta::MetaInfoTable(), cp::meta::MetaInfoTable(tunnel_handle_keys, Key::CallerClientIds))
 {
-	m_keys = {
-		RPC_META_KEY_DEF(CallerClientIds),
-		RPC_META_KEY_DEF(TunnelClientId),
-	};
-	//m_tags = {
-	//	{(int)Tag::RequestId, {(int)Tag::RequestId, "id"}},
-	//	{(int)Tag::ShvPath, {(int)Tag::ShvPath, "shvPath"}},
-	//};
 }
 
 void TunnelHandle::MetaType::registerMetaType()
 {
-	static bool is_init = false;
-	if(!is_init) {
-		is_init = true;
-		static MetaType s;
-		shv::chainpack::meta::registerType(shv::chainpack::meta::GlobalNS::ID, MetaType::ID, &s);
-	}
+	static MetaType s;
+	static const bool is_init = (cp::meta::registerType(cp::meta::GlobalNS::ID, MetaType::ID, &s), true);
+	(void)is_init;
 }
 
 TunnelHandle::TunnelHandle()
@@ -48,6 +56,40 @@ TunnelHandle::TunnelHandle(const chainpack::RpcValue &caller_ids, unsigned tun_i
 	(*this)[MetaType::Key::TunnelClientId] = tun_id;
 }
 
+TunnelHandle::TunnelHandle(const TunnelHandle::Fields &fields)
+	: Super(fields.toIMap())
+{
+	MetaType::registerMetaType();
+}
+
+TunnelHandle::Fields TunnelHandle::Fields::fromIMap(const chainpack::RpcValue::IMap &m)
+{
+	Fields ret;
+	FieldsSchema::fromIMap(m, ret);
+	return ret;
+}
+
+chainpack::RpcValue::IMap TunnelHandle::Fields::toIMap() const
+{
+	return FieldsSchema::toIMap(*this);
+}
+
+void TunnelHandle::Fields::write(chainpack::ChainPackWriter &wr) const
+{
+	wr.writeMetaDataBegin();
+	wr.writeIMapKey(cp::meta::Tag::MetaTypeId);
+	wr.writeInt(MetaType::ID);
+	wr.writeContainerEnd();
+	FieldsSchema::write(wr, *this);
+}
+
+TunnelHandle::Fields TunnelHandle::Fields::read(chainpack::ChainPackReader &rd)
+{
+	Fields ret;
+	FieldsSchema::read(rd, ret);
+	return ret;
+}
+
 chainpack::RpcValue TunnelHandle::toRpcValue() const
 {
 	cp::RpcValue ret(*this);
@@ -4,6 +4,10 @@
 
 #include <shv/chainpack/rpcvalue.h>
 
+#include <vector>
+
+namespace shv { namespace chainpack { class ChainPackReader; class ChainPackWriter; }}
+
 namespace shv {
 namespace iotqt {
 namespace rpc {
@@ -24,10 +28,25 @@ public:
 		MetaType();
 		static void registerMetaType();
 	};
+	/// typed content of TunnelHandle, read and written from ChainPack without IMap
+	struct SHVIOTQT_DECL_EXPORT Fields
+	{
+		shv::chainpack::meta::Optional<std::vector<shv::chainpack::RpcValue::UInt>> callerClientIds;
+		shv::chainpack::meta::Optional<shv::chainpack::RpcValue::UInt> tunnelClientId;
+
+		static Fields fromIMap(const shv::chainpack::RpcValue::IMap &m);
+		shv::chainpack::RpcValue::IMap toIMap() const;
+		/// written with meta type id as toRpcValue() is
+		void write(shv::chainpack::ChainPackWriter &wr) const;
+		static Fields read(shv::chainpack::ChainPackReader &rd);
+	};
 public:
 	TunnelHandle();
 	TunnelHandle(const shv::chainpack::RpcValue::IMap &m);
 	TunnelHandle(const shv::chainpack::RpcValue &caller_ids, unsigned tun_id);
+	TunnelHandle(const Fields &fields);
+
+	Fields fields() const {return Fields::fromIMap(*this);}
 
 	shv::chainpack::RpcValue toRpcValue() const;
 };
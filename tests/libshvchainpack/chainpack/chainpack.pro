@@ -4,4 +4,10 @@ CONFIG += ordered
 SUBDIRS += \
 	rpcvalue \
 	rpcmessage \
+	rpcdriver \
+	cponreader \
+	cponwriter \
+	datetime \
+	timerwheel \
+	rpcbatchcall \
 
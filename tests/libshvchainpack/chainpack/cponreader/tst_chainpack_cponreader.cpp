@@ -0,0 +1,201 @@
+#include <shv/chainpack/cponbufferreader.h>
+#include <shv/chainpack/cponreader.h>
+#include <shv/chainpack/rpcmessage.h>
+
+#include <sstream>
+#include <string>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+
+namespace {
+
+RpcValue read_stream(const std::string &cpon)
+{
+	std::istringstream in(cpon);
+	CponReader rd(in);
+	return rd.read();
+}
+
+RpcValue read_buffer(const std::string &cpon)
+{
+	CponBufferReader rd(cpon);
+	return rd.read();
+}
+
+bool buffer_read_fails(const std::string &cpon)
+{
+	std::string err;
+	CponBufferReader rd(cpon);
+	RpcValue val;
+	rd.read(val, err);
+	return !err.empty();
+}
+
+/// response to ls with attributes, as it is sent to web UI
+std::string ls_payload(unsigned n)
+{
+	RpcValue::List nodes;
+	for (unsigned i = 0; i < n; ++i) {
+		nodes.push_back(RpcValue::Map{
+							{"name", "node_" + std::to_string(i)},
+							{"hasChildren", i % 3 == 0},
+							{"description", "Disconnector " + std::to_string(i) + " status, \"ready\" when closed"},
+							{"accessLevel", 8},
+						});
+	}
+	RpcResponse resp;
+	resp.setRequestId(123);
+	resp.setResult(nodes);
+	return resp.value().toCpon();
+}
+
+/// history log, rows of [date_time, shv_path, value]
+std::string history_payload(unsigned n)
+{
+	RpcValue::List rows;
+	for (unsigned i = 0; i < n; ++i) {
+		rows.push_back(RpcValue::List{
+						   RpcValue::DateTime::fromMSecsSinceEpoch(1546300800000LL + i * 1000LL),
+						   "shv/eu/pl/lublin/odpojovace/" + std::to_string(i % 100) + "/status",
+						   1234.5 + i,
+					   });
+	}
+	RpcResponse resp;
+	resp.setRequestId(124);
+	resp.setResult(rows);
+	return resp.value().toCpon();
+}
+
+}
+
+class TestCponReader: public QObject
+{
+	Q_OBJECT
+private slots:
+	void sameResultAsStreamReader()
+	{
+		const std::string samples[] = {
+			"null",
+			"true",
+			"[false, true]",
+			"123",
+			"-123",
+			"123u",
+			"0x1f",
+			"1.5",
+			"1e3",
+			"12.25n",
+			"\"foo\"",
+			"\"a\\\"b\\\\c\\n\\t/\\u00e1\\ud83d\\ude00 a long tail to scan in words\"",
+			"b\"a\\x00b\\\"\\\\\"",
+			"x\"616263\"",
+			"d\"2018-01-02T03:04:05.678Z\"",
+			"[1, \"two\", [3], {\"four\": 4}]",
+			"a[1, 2, 3]",
+			"i{1: \"a\", 2: [1, 2]}",
+			"{\"b\": 1, \"a\": 2, \"c\": {}}",
+			"<1:1, 8:\"foo\", \"bar\":true>i{1: <\"md\":2>[]}",
+			"// comment\n[1, /* inline */ 2]",
+		};
+		for (const std::string &sample : samples) {
+			std::string expected = read_stream(sample).toCpon();
+			std::string actual = read_buffer(sample).toCpon();
+			QCOMPARE(actual, expected);
+		}
+		for (const std::string &payload : {ls_payload(100), history_payload(100)}) {
+			QCOMPARE(read_buffer(payload).toCpon(), payload);
+			QCOMPARE(read_buffer(payload).toCpon(), read_stream(payload).toCpon());
+		}
+	}
+	void numbers()
+	{
+		QCOMPARE(read_buffer("0.1").toDouble(), 0.1);
+		QCOMPARE(read_buffer("-0.5").toDouble(), -0.5);
+		QCOMPARE(read_buffer("1.5e3").toDouble(), 1500.);
+		QCOMPARE(read_buffer("2.5E-3").toDouble(), 0.0025);
+		QCOMPARE(read_buffer("2147483647").toInt(), std::numeric_limits<RpcValue::Int>::max());
+		QCOMPARE(read_buffer("-2147483648").toInt(), std::numeric_limits<RpcValue::Int>::min());
+		QCOMPARE(read_buffer("0xffffffffu").toUInt(), std::numeric_limits<RpcValue::UInt>::max());
+		QCOMPARE(read_buffer("-14073748835532.7n").toDecimal().mantisa(), -140737488355327LL);
+		QCOMPARE(read_buffer("12345678901234567890123.0").toDouble(), 12345678901234567890123.0);
+		QCOMPARE(read_buffer("1e300").toDouble(), 1e300);
+		QCOMPARE(read_buffer("-1.25n").toDecimal().toDouble(), -1.25);
+		QCOMPARE(read_buffer("4294967295u").toUInt(), 4294967295u);
+		QCOMPARE(read_buffer("-2147483647").toInt(), -2147483647);
+	}
+	void parseErrors()
+	{
+		QVERIFY(buffer_read_fails(""));
+		QVERIFY(buffer_read_fails("\"unterminated"));
+		QVERIFY(buffer_read_fails("\"bad \\q escape\""));
+		QVERIFY(buffer_read_fails("\"bad \\u12 escape\""));
+		QVERIFY(buffer_read_fails("[1, 2"));
+		QVERIFY(buffer_read_fails("{1: 2}"));
+		QVERIFY(buffer_read_fails("a[1, \"2\"]"));
+		QVERIFY(buffer_read_fails("nul"));
+		QVERIFY(buffer_read_fails("1e"));
+		QVERIFY(buffer_read_fails("/* unclosed"));
+	}
+	void numberRangeErrors()
+	{
+		QVERIFY(buffer_read_fails("12345678901234567890123"));
+		QVERIFY(buffer_read_fails("2147483648"));
+		QVERIFY(buffer_read_fails("-2147483649"));
+		QVERIFY(buffer_read_fails("4294967296u"));
+		QVERIFY(buffer_read_fails("18446744073709551616u"));
+		QVERIFY(buffer_read_fails("0x100000000u"));
+		QVERIFY(buffer_read_fails("0x10000000000000000u"));
+		QVERIFY(buffer_read_fails("0x80000000"));
+		QVERIFY(buffer_read_fails("14073748835532.8n"));
+		QVERIFY(buffer_read_fails("12345678901234567890.5n"));
+		QVERIFY(buffer_read_fails("-5u"));
+		QVERIFY(buffer_read_fails("-0x5u"));
+		QVERIFY(buffer_read_fails("1e400"));
+		QVERIFY(buffer_read_fails("-1e400"));
+	}
+	void metaDataEndPos()
+	{
+		std::string data = "xx<1:1, 8:\"foo\">{\"a\": 1}";
+		CponBufferReader rd(data, 2);
+		RpcValue::MetaData md;
+		rd.read(md);
+		QCOMPARE(md.value(8).toString(), std::string("foo"));
+		QCOMPARE(rd.pos(), data.find('{'));
+		RpcValue val = rd.read();
+		QCOMPARE(val.toMap().value("a").toInt(), 1);
+		QCOMPARE(rd.pos(), data.size());
+	}
+	void benchStreamReaderLs()
+	{
+		std::string payload = ls_payload(1000);
+		QBENCHMARK {
+			read_stream(payload);
+		}
+	}
+	void benchBufferReaderLs()
+	{
+		std::string payload = ls_payload(1000);
+		QBENCHMARK {
+			read_buffer(payload);
+		}
+	}
+	void benchStreamReaderHistory()
+	{
+		std::string payload = history_payload(1000);
+		QBENCHMARK {
+			read_stream(payload);
+		}
+	}
+	void benchBufferReaderHistory()
+	{
+		std::string payload = history_payload(1000);
+		QBENCHMARK {
+			read_buffer(payload);
+		}
+	}
+};
+
+QTEST_MAIN(TestCponReader)
+#include "tst_chainpack_cponreader.moc"
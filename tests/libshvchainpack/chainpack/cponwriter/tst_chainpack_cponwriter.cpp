@@ -0,0 +1,135 @@
+#include <shv/chainpack/cponwriter.h>
+#include <shv/chainpack/rpcdriver.h>
+#include <shv/chainpack/rpcmessage.h>
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+
+namespace {
+
+template<typename T>
+std::string to_cpon(T val, bool json = false)
+{
+	std::ostringstream out;
+	CponWriterOptions opts;
+	opts.setJsonFormat(json);
+	CponWriter wr(out, opts);
+	wr.write(val);
+	return out.str();
+}
+
+/// exposes JSON-RPC coding of RpcDriver
+class JsonCoder : public RpcDriver
+{
+public:
+	using RpcDriver::codeRpcValue;
+};
+
+RpcValue ls_response(unsigned n)
+{
+	RpcValue::List nodes;
+	for (unsigned i = 0; i < n; ++i) {
+		nodes.push_back(RpcValue::Map{
+							{"name", "node_" + std::to_string(i)},
+							{"hasChildren", i % 3 == 0},
+							{"description", "Disconnector " + std::to_string(i) + " status, \"ready\" when closed"},
+							{"value", 1234.5678 + i},
+						});
+	}
+	RpcResponse resp;
+	resp.setRequestId(123);
+	resp.setResult(nodes);
+	return resp.value();
+}
+
+}
+
+class TestCponWriter: public QObject
+{
+	Q_OBJECT
+private slots:
+	void integers()
+	{
+		QCOMPARE(to_cpon(int64_t(0)), std::string("0"));
+		QCOMPARE(to_cpon(int64_t(-123)), std::string("-123"));
+		QCOMPARE(to_cpon(std::numeric_limits<int64_t>::min()), std::string("-9223372036854775808"));
+		QCOMPARE(to_cpon(std::numeric_limits<uint64_t>::max()), std::string("18446744073709551615u"));
+		QCOMPARE(to_cpon(uint32_t(7), true), std::string("7"));
+	}
+	void doubles()
+	{
+		QCOMPARE(to_cpon(0.1), std::string("0.1"));
+		QCOMPARE(to_cpon(-0.5), std::string("-0.5"));
+		QCOMPARE(to_cpon(223.), std::string("223."));
+		QCOMPARE(to_cpon(1234.5678), std::string("1234.5678"));
+		QCOMPARE(to_cpon(1e20), std::string("1e+20"));
+		QCOMPARE(to_cpon(std::numeric_limits<double>::infinity()), std::string("null"));
+		for (double d : {1. / 3, 2. / 3, 0.1 + 0.2, 1e-300, 123456789.123456789, std::numeric_limits<double>::max()}) {
+			std::string err;
+			RpcValue rv = RpcValue::fromCpon(to_cpon(d), &err);
+			QVERIFY(err.empty());
+			QCOMPARE(rv.toDouble(), d);
+		}
+	}
+	void strings()
+	{
+		QCOMPARE(to_cpon(std::string("plain text")), std::string("\"plain text\""));
+		QCOMPARE(to_cpon(std::string("a\"b\\c\nd\te\x01")), std::string("\"a\\\"b\\\\c\\nd\\te\\u0001\""));
+		QCOMPARE(to_cpon(std::string("line\xe2\x80\xa8sep\xe2\x80\xa9")), std::string("\"line\\u2028sep\\u2029\""));
+		QCOMPARE(to_cpon(std::string("\xc3\xa1\xe2\x82\xac\xe2\x80")), std::string("\"\xc3\xa1\xe2\x82\xac\xe2\x80\""));
+		QCOMPARE(to_cpon(RpcValue::Blob(std::string("a\x00\x1f\"\\", 5))), std::string("b\"a\\x00\\x1f\\\"\\\\\""));
+	}
+	void roundTrip()
+	{
+		RpcValue val = ls_response(100);
+		std::string err;
+		RpcValue val2 = RpcValue::fromCpon(val.toCpon(), &err);
+		QVERIFY(err.empty());
+		QVERIFY(val2 == val);
+		QCOMPARE(val2.toCpon(), val.toCpon());
+	}
+	void benchToCpon()
+	{
+		RpcValue val = ls_response(1000);
+		QBENCHMARK {
+			val.toCpon();
+		}
+	}
+	void benchJsonRpcResponse()
+	{
+		RpcValue val = ls_response(1000);
+		QBENCHMARK {
+			std::string out;
+			JsonCoder::codeRpcValue(Rpc::ProtocolType::JsonRpc, val, out);
+		}
+	}
+	void benchShortDoubles()
+	{
+		// measured values have few decimal places usually
+		RpcValue::List lst;
+		for (int i = 0; i < 1000; ++i)
+			lst.push_back(i / 100.);
+		RpcValue val(lst);
+		QBENCHMARK {
+			val.toCpon();
+		}
+	}
+	void benchFullPrecisionDoubles()
+	{
+		RpcValue::List lst;
+		for (int i = 0; i < 1000; ++i)
+			lst.push_back(i / 7.);
+		RpcValue val(lst);
+		QBENCHMARK {
+			val.toCpon();
+		}
+	}
+};
+
+QTEST_MAIN(TestCponWriter)
+#include "tst_chainpack_cponwriter.moc"
@@ -0,0 +1,7 @@
+include ( ../../test_libshvchainpack.pri )
+
+TARGET = tst_chainpack_datetime
+
+SOURCES += \
+    $${TARGET}.cpp \
+
@@ -0,0 +1,134 @@
+#include <shv/chainpack/rpcvalue.h>
+
+#include <ctime>
+#include <string>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+
+namespace {
+
+const int64_t MSEC_PER_DAY = 24 * 60 * 60 * 1000LL;
+
+bool round_trips(int64_t msec, int utc_offset_min)
+{
+	RpcValue::DateTime dt = RpcValue::DateTime::fromMSecsSinceEpoch(msec, utc_offset_min);
+	std::string s = dt.toUtcString();
+	bool ok;
+	RpcValue::DateTime dt2 = RpcValue::DateTime::fromUtcString(s.data(), s.size(), &ok);
+	return ok && dt2 == dt;
+}
+
+RpcValue::DateTime parse(const std::string &s, bool *ok = nullptr)
+{
+	return RpcValue::DateTime::fromUtcString(s.data(), s.size(), ok);
+}
+
+bool parse_fails(const std::string &s)
+{
+	bool ok;
+	parse(s, &ok);
+	return !ok;
+}
+
+std::string libc_format(int64_t msec)
+{
+	std::time_t tim = static_cast<std::time_t>(msec / 1000);
+	std::tm *tm = std::gmtime(&tim);
+	char buff[80];
+	std::strftime(buff, sizeof(buff), "%Y-%m-%dT%H:%M:%S", tm);
+	return buff;
+}
+
+}
+
+class TestDateTime: public QObject
+{
+	Q_OBJECT
+private slots:
+	void everyDayRoundTrip()
+	{
+		// each day of years -9999 .. 9999, with time of day moving
+		const int64_t first_day = -4371587;
+		const int64_t last_day = 2932896;
+		for (int64_t day = first_day; day <= last_day; ++day) {
+			int64_t msec = day * MSEC_PER_DAY + (day * 7919 * 1000 + day % 1000) % MSEC_PER_DAY;
+			QVERIFY(round_trips(msec, 0));
+		}
+		QCOMPARE(RpcValue::DateTime::fromMSecsSinceEpoch(first_day * MSEC_PER_DAY).toUtcString(), std::string("-9999-01-01T00:00:00Z"));
+		QCOMPARE(RpcValue::DateTime::fromMSecsSinceEpoch(last_day * MSEC_PER_DAY).toUtcString(), std::string("9999-12-31T00:00:00Z"));
+	}
+	void everyOffsetAndMsecRoundTrip()
+	{
+		const int64_t msec = 1517529600000LL;
+		for (int quarters = -63; quarters <= 63; ++quarters) {
+			for (int ms = 0; ms < 1000; ++ms)
+				QVERIFY(round_trips(msec + ms, quarters * 15));
+			QVERIFY(round_trips(-msec - 1, quarters * 15));
+		}
+	}
+	void sameAsLibc()
+	{
+		// each hour from 1970 to 2100
+		for (int64_t msec = 0; msec < 4102444800000LL; msec += 3600 * 1000 + 1) {
+			std::string s = RpcValue::DateTime::fromMSecsSinceEpoch(msec - msec % 1000).toUtcString();
+			QCOMPARE(s, libc_format(msec) + 'Z');
+		}
+	}
+	void parseFormats()
+	{
+		const int64_t msec = 1517529600000LL;
+		QCOMPARE(parse("2018-02-02T00:00:00Z").msecsSinceEpoch(), msec);
+		QCOMPARE(parse("2018-02-02T00:00:00").msecsSinceEpoch(), msec);
+		QCOMPARE(parse("2018-02-02 00:00:00.123Z").msecsSinceEpoch(), msec + 123);
+		QCOMPARE(parse("2018-02-02T00:00:00.5Z").msecsSinceEpoch(), msec + 500);
+		QCOMPARE(parse("2018-02-02T00:00:00.123456Z").msecsSinceEpoch(), msec + 123);
+		QCOMPARE(parse("2018-02-02T01:00:00+01").msecsSinceEpoch(), msec);
+		QCOMPARE(parse("2018-02-02T01:30:00+0130").msecsSinceEpoch(), msec);
+		QCOMPARE(parse("2018-02-02T01:30:00+01:30").offsetFromUtc(), 90);
+		QCOMPARE(parse("2018-02-01T22:00:00-02").msecsSinceEpoch(), msec);
+		QCOMPARE(parse("2018-02-01T22:00:00-02").offsetFromUtc(), -120);
+		QCOMPARE(parse("2018-2-2T0:0:0Z").msecsSinceEpoch(), msec);
+		QCOMPARE(parse("1969-12-31T23:59:59.999Z").msecsSinceEpoch(), -1LL);
+		QCOMPARE(RpcValue::DateTime::fromUtcString("2017-05-03T15:52:31.123+10").toUtcString(), std::string("2017-05-03T15:52:31.123+10"));
+		QCOMPARE(RpcValue::DateTime::fromUtcString("2017-05-03T15:52:31-0945").toUtcString(), std::string("2017-05-03T15:52:31-0945"));
+	}
+	void parseErrors()
+	{
+		QVERIFY(parse_fails(""));
+		QVERIFY(parse_fails("2018-02-02"));
+		QVERIFY(parse_fails("2018-13-02T00:00:00Z"));
+		QVERIFY(parse_fails("2018-02-32T00:00:00Z"));
+		QVERIFY(parse_fails("2018-02-02T24:00:00Z"));
+		QVERIFY(parse_fails("2018-02-02T00:00:00."));
+		QVERIFY(parse_fails("2018-02-02T00:00:00X"));
+		QVERIFY(parse_fails("2018-02-02T00:00:00Zjunk"));
+		QVERIFY(parse_fails("2018-02-02T00:00:00+01:3"));
+		QVERIFY(parse_fails("2018-02-02T00:00:00+20"));
+	}
+	void benchFormat()
+	{
+		RpcValue::DateTime dt = RpcValue::DateTime::fromMSecsSinceEpoch(1517529600123LL, 60);
+		QBENCHMARK {
+			dt.toUtcString();
+		}
+	}
+	void benchFormatLibc()
+	{
+		// what toUtcString() costed with gmtime() and strftime()
+		QBENCHMARK {
+			libc_format(1517529600123LL);
+		}
+	}
+	void benchParse()
+	{
+		const std::string s = "2018-02-02T01:00:00.123+01";
+		QBENCHMARK {
+			parse(s);
+		}
+	}
+};
+
+QTEST_MAIN(TestDateTime)
+#include "tst_chainpack_datetime.moc"
@@ -0,0 +1,162 @@
+#include <shv/chainpack/abstractrpcconnection.h>
+#include <shv/chainpack/rpcbatchcall.h>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+
+namespace {
+
+/// connection keeping async requests pending until respond() is called
+class MockConnection : public AbstractRpcConnection
+{
+public:
+	std::map<unsigned, ResponseCallback> pending;
+	/// sending request to this path throws, callback is registered before
+	std::string failingShvPath;
+
+	void close() override {}
+	void abort() override {}
+	void sendMessage(const RpcMessage &) override {}
+	RpcResponse sendMessageSync(const RpcRequest &, int) override {return RpcResponse();}
+	void onRpcMessageReceived(const RpcMessage &) override {}
+	void sendMessageAsync(const RpcRequest &rpc_request, ResponseCallback &&callback, int) override
+	{
+		pending[rpc_request.requestId().toUInt()] = std::move(callback);
+		if(!failingShvPath.empty() && rpc_request.shvPath().toString() == failingShvPath)
+			throw std::runtime_error("socket is not open");
+	}
+	void cancelMessageAsync(unsigned request_id) override
+	{
+		RpcResponse resp;
+		resp.setRequestId(request_id);
+		resp.setError(RpcResponse::Error::create(RpcResponse::Error::SyncMethodCallCancelled, "cancelled"));
+		respond(resp);
+	}
+
+	void respond(const RpcResponse &resp)
+	{
+		auto it = pending.find(resp.requestId().toUInt());
+		if(it == pending.end())
+			return;
+		ResponseCallback cb = std::move(it->second);
+		pending.erase(it);
+		cb(resp);
+	}
+	/// responds to the oldest pending request with its id as result
+	void respondFirst()
+	{
+		RpcResponse resp;
+		resp.setRequestId(pending.begin()->first);
+		resp.setResult(pending.begin()->first);
+		respond(resp);
+	}
+};
+
+std::vector<RpcBatchCall::Request> create_requests(int n)
+{
+	std::vector<RpcBatchCall::Request> ret;
+	for (int i = 0; i < n; ++i)
+		ret.emplace_back("node/" + std::to_string(i), "get");
+	return ret;
+}
+
+}
+
+class TestRpcBatchCall: public QObject
+{
+	Q_OBJECT
+private slots:
+	void allResponses()
+	{
+		MockConnection conn;
+		int finished_cnt = 0;
+		std::shared_ptr<RpcBatchCall> batch = RpcBatchCall::create(&conn, create_requests(10));
+		batch->setMaxInFlight(3);
+		batch->setFinishedCallback([&finished_cnt](const RpcBatchCall &) {finished_cnt++;});
+		batch->start();
+		QCOMPARE(batch->inFlightCount(), size_t(3));
+		QCOMPARE(conn.pending.size(), size_t(3));
+		while(!conn.pending.empty())
+			conn.respondFirst();
+		QCOMPARE(finished_cnt, 1);
+		QVERIFY(batch->isFinished());
+		QCOMPARE(batch->inFlightCount(), size_t(0));
+		QCOMPARE(batch->errorCount(), size_t(0));
+		QCOMPARE(batch->resultList().size(), size_t(10));
+	}
+	void sendException()
+	{
+		MockConnection conn;
+		conn.failingShvPath = "node/1";
+		int finished_cnt = 0;
+		std::vector<RpcBatchCall::Request> requests = create_requests(5);
+		std::shared_ptr<RpcBatchCall> batch = RpcBatchCall::create(&conn, std::move(requests));
+		batch->setMaxInFlight(2);
+		batch->setFinishedCallback([&finished_cnt](const RpcBatchCall &) {finished_cnt++;});
+		batch->start();
+		// failed call does not occupy in flight slot
+		QCOMPARE(batch->finishedCount(), size_t(1));
+		QCOMPARE(batch->inFlightCount(), size_t(2));
+		const RpcResponse &failed = batch->results()[1].response;
+		QCOMPARE(failed.error().code(), RpcResponse::Error::MethodInvocationException);
+		QCOMPARE(failed.error().message(), std::string("socket is not open"));
+		QCOMPARE(batch->results()[1].latencyMsec, -1);
+
+		// callback registered for failed call is ignored
+		unsigned failed_rq_id = conn.pending.begin()->first + 1;
+		QVERIFY(conn.pending.count(failed_rq_id) == 1);
+		RpcResponse late_resp;
+		late_resp.setRequestId(failed_rq_id);
+		late_resp.setError(RpcResponse::Error::createSyncMethodCallTimeout());
+		conn.respond(late_resp);
+		QCOMPARE(batch->finishedCount(), size_t(1));
+		QCOMPARE(batch->inFlightCount(), size_t(2));
+
+		while(!conn.pending.empty())
+			conn.respondFirst();
+		QCOMPARE(finished_cnt, 1);
+		QVERIFY(batch->isFinished());
+		QCOMPARE(batch->errorCount(), size_t(1));
+		RpcValue::List results = batch->resultList();
+		QVERIFY(results[1].isNull());
+		QVERIFY(!results[0].isNull());
+		QVERIFY(!results[4].isNull());
+	}
+	void singleCallThrows()
+	{
+		MockConnection conn;
+		conn.failingShvPath = "node/0";
+		int finished_cnt = 0;
+		std::shared_ptr<RpcBatchCall> batch = RpcBatchCall::create(&conn, create_requests(1));
+		batch->setFinishedCallback([&finished_cnt](const RpcBatchCall &) {finished_cnt++;});
+		batch->start();
+		QCOMPARE(finished_cnt, 1);
+		QVERIFY(batch->isFinished());
+		QCOMPARE(batch->inFlightCount(), size_t(0));
+		QCOMPARE(batch->errorCount(), size_t(1));
+	}
+	void cancel()
+	{
+		MockConnection conn;
+		int finished_cnt = 0;
+		std::shared_ptr<RpcBatchCall> batch = RpcBatchCall::create(&conn, create_requests(5));
+		batch->setMaxInFlight(2);
+		batch->setFinishedCallback([&finished_cnt](const RpcBatchCall &) {finished_cnt++;});
+		batch->start();
+		conn.respondFirst();
+		batch->cancel();
+		QCOMPARE(finished_cnt, 1);
+		QVERIFY(batch->isFinished());
+		QCOMPARE(batch->inFlightCount(), size_t(0));
+		QCOMPARE(batch->errorCount(), size_t(4));
+		QVERIFY(conn.pending.empty());
+	}
+};
+
+QTEST_MAIN(TestRpcBatchCall)
+#include "tst_chainpack_rpcbatchcall.moc"
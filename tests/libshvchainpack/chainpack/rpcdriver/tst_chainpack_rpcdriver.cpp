@@ -0,0 +1,771 @@
+#include <shv/chainpack/chainpackreader.h>
+#include <shv/chainpack/chainpackwriter.h>
+#include <shv/chainpack/cponwriter.h>
+#include <shv/chainpack/datatranscoder.h>
+#include <shv/chainpack/encodedmessage.h>
+#include <shv/chainpack/jsonrpctranscoder.h>
+#include <shv/chainpack/pendingrpcrequests.h>
+#include <shv/chainpack/rpcdriver.h>
+#include <shv/chainpack/rpclog.h>
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+
+namespace {
+
+/// driver writing to memory, bytes written can be read by another driver
+class LoopbackDriver : public RpcDriver
+{
+public:
+	using RpcDriver::BufferPool;
+
+	std::string written;
+	int receivedCount = 0;
+	RpcValue lastReceived;
+	std::vector<RpcValue> received;
+	/// nothing is written while set, messages stay in send queue
+	bool writeStalled = false;
+	bool open = true;
+	int overflowCount = 0;
+	int coalescedNotifyPendingCount = 0;
+
+	void receive(const std::string &data) {onBytesRead(std::string(data));}
+	/// writes one queued message like socket driver does when bytes are written
+	void writeNext() {enqueueDataToSend(Chunk());}
+protected:
+	bool isOpen() override {return open;}
+	int64_t writeBytes(const char *bytes, size_t length) override
+	{
+		written.append(bytes, length);
+		return static_cast<int64_t>(length);
+	}
+	bool flush() override {return false;}
+	bool isWriteBufferFull() override {return writeStalled;}
+	void onCoalescedNotifyPending(int msec) override
+	{
+		(void)msec;
+		coalescedNotifyPendingCount++;
+	}
+	void onSendQueueOverflow() override
+	{
+		overflowCount++;
+		open = false;
+	}
+	void onRpcValueReceived(const RpcValue &msg) override
+	{
+		lastReceived = msg;
+		received.push_back(msg);
+		receivedCount++;
+	}
+};
+
+RpcValue create_request(unsigned rq_id)
+{
+	RpcRequest rq;
+	rq.setRequestId(rq_id)
+			.setMethod("get")
+			.setParams(RpcValue::Map{
+						   {"a", 45},
+						   {"b", "bar"},
+						   {"c", RpcValue::List{1, 2, 3}},
+					   });
+	rq.setShvPath("shv/eu/pl/lublin/odpojovace/15/status");
+	return rq.value();
+}
+
+RpcValue create_notify(const std::string &value, const std::string &shv_path = "shv/eu/pl/lublin/odpojovace/15/status", const std::string &method = "chng")
+{
+	RpcNotify ntf;
+	ntf.setMethod(method);
+	ntf.setShvPath(shv_path);
+	ntf.setParams(RpcValue::Map{
+					  {"value", value},
+					  {"ts", RpcValue::DateTime::fromMSecsSinceEpoch(1517529600001)},
+					  {"flags", RpcValue::List{1, 2, 3}},
+				  });
+	return ntf.value();
+}
+
+int s_formatCount = 0;
+
+std::string counted_format(const RpcValue &val)
+{
+	s_formatCount++;
+	return val.toPrettyString();
+}
+
+}
+
+class TestRpcDriver: public QObject
+{
+	Q_OBJECT
+private slots:
+	void lazyLogArgumentsNotEvaluated()
+	{
+		// RpcMsg and RpcData topics are not enabled in tests
+		RpcValue msg = create_request(1);
+		s_formatCount = 0;
+		for (int i = 0; i < 1000; ++i) {
+			logRpcMsg() << RpcDriver::SND_LOG_ARROW << counted_format(msg);
+			logRpcData() << "packed data:" << counted_format(msg);
+		}
+		QCOMPARE(s_formatCount, 0);
+	}
+	void sendReceive()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		LoopbackDriver receiver;
+		for (unsigned i = 1; i <= 100; ++i)
+			sender.sendRpcValue(create_request(i));
+		receiver.receive(sender.written);
+		QCOMPARE(receiver.receivedCount, 100);
+	}
+	void jsonRpcSendReceive()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::JsonRpc);
+		LoopbackDriver receiver;
+		RpcValue rq = create_request(7);
+		RpcValue::MetaData md = rq.metaData();
+		RpcMessage::setCallerIds(md, RpcValue::Array{RpcValue::Type::UInt});
+		RpcMessage::pushCallerId(md, 3);
+		RpcMessage::pushCallerId(md, 5);
+		rq.setMetaData(std::move(md));
+		sender.sendRpcValue(rq);
+		RpcResponse resp = RpcResponse::forRequest(RpcRequest(RpcMessage(rq)));
+		resp.setError(RpcResponse::Error::create(RpcResponse::Error::MethodNotFound, "no such method"));
+		sender.sendRpcValue(resp.value());
+		receiver.receive(sender.written);
+		QCOMPARE(receiver.receivedCount, 2);
+		RpcResponse received_resp(RpcMessage(receiver.lastReceived));
+		QCOMPARE(received_resp.requestId().toUInt(), 7u);
+		QCOMPARE(received_resp.error().code(), RpcResponse::Error::MethodNotFound);
+		QCOMPARE(received_resp.error().message(), std::string("no such method"));
+		QCOMPARE(received_resp.callerIds().toCpon(), resp.callerIds().toCpon());
+	}
+	void jsonRpcTranscoding()
+	{
+		const std::string json = "{\"id\":7, \"callerId\":[3, 5], \"method\":\"get\", \"shvPath\":\"a/b\", \"params\":{\"x\":[1, 2]}}";
+		RpcValue::MetaData md;
+		RpcValue msg_data;
+		JsonRpcTranscoder::readJsonRpc(json, 0, md, msg_data);
+		RpcValue rq = msg_data;
+		rq.setMetaData(RpcValue::MetaData(md));
+		QCOMPARE(rq.toCpon(), RpcValue::fromCpon("<8:7u, 9:\"a/b\", 10:\"get\", 11:a[3u, 5u]>i{1:{\"x\":[1, 2]}}").toCpon());
+		std::ostringstream out;
+		JsonRpcTranscoder::writeJsonRpc(out, md, msg_data);
+		QCOMPARE(out.str(), std::string("{\"id\":7, \"shvPath\":\"a/b\", \"callerId\":[3, 5], \"method\":\"get\", \"params\":{\"x\":[1, 2]}}"));
+
+		const std::string json_error = "{\"id\":8, \"error\":{\"code\":-32600, \"message\":\"Invalid Request\"}}";
+		RpcValue::MetaData error_md;
+		RpcValue error_data;
+		JsonRpcTranscoder::readJsonRpc(json_error, 0, error_md, error_data);
+		RpcValue resp_val = error_data;
+		resp_val.setMetaData(RpcValue::MetaData(error_md));
+		RpcResponse resp(RpcMessage{resp_val});
+		QCOMPARE((int)resp.error().code(), -32600);
+		QCOMPARE(RpcValue(resp.error()).toCpon(), RpcValue::fromCpon("i{1:-32600, 2:\"Invalid Request\"}").toCpon());
+		std::ostringstream error_out;
+		JsonRpcTranscoder::writeJsonRpc(error_out, error_md, error_data);
+		QVERIFY(error_out.str().find("\"code\":-32600") != std::string::npos);
+	}
+	void dataTranscoding()
+	{
+		for(const char *cpon : {
+				"null",
+				"[1, 2u, -3, 12.5, 1e3, true, \"str\", b\"\\x01\\x02\", d\"2018-02-02T00:00:00.001Z\"]",
+				"<1:2, 8:7u, \"foo\":\"bar\">i{1:{\"a\":[1, <2:3>2]}, 2:a[1u, 2u, 3u]}",
+				"{\"ts\":d\"2020-01-02T03:04:05+01\", \"l\":[[], {}, i{}]}",
+			}) {
+			RpcValue val = RpcValue::fromCpon(cpon);
+			const std::string chainpack = val.toChainPack();
+			std::ostringstream cpon_out;
+			QCOMPARE(DataTranscoder::chainPackToCpon(chainpack, 0, cpon_out), chainpack.size());
+			QCOMPARE(cpon_out.str(), val.toCpon());
+			std::ostringstream chainpack_out;
+			DataTranscoder::cponToChainPack(val.toCpon(), 0, chainpack_out);
+			QCOMPARE(chainpack_out.str(), chainpack);
+		}
+		std::ostringstream out;
+		QVERIFY_EXCEPTION_THROWN(DataTranscoder::chainPackToCpon(RpcValue("truncated").toChainPack().substr(0, 5), 0, out), AbstractStreamReader::ParseException);
+		// long form integer with more than 8 data bytes
+		for(const RpcValue &num : {RpcValue(RpcValue::UInt(1000)), RpcValue(RpcValue::Int(1000))}) {
+			std::string too_long = num.toChainPack().substr(0, 1);
+			too_long += '\xff';
+			too_long += std::string(19, '\x01');
+			QVERIFY_EXCEPTION_THROWN(DataTranscoder::chainPackToCpon(too_long, 0, out), AbstractStreamReader::ParseException);
+		}
+	}
+	void transcodedNotifyFanOut()
+	{
+		RpcValue ntf = create_notify("fan-out");
+		RpcValue::MetaData md = ntf.metaData();
+		RpcMessage::setProtocolType(md, Rpc::ProtocolType::ChainPack);
+		const std::string data = RpcValue(ntf.toIMap()).toChainPack();
+		LoopbackDriver subscribers[3];
+		{
+			RpcDriver::NotifyFanOutScope fan_out_scope;
+			for(LoopbackDriver &subscriber : subscribers) {
+				subscriber.setProtocolType(Rpc::ProtocolType::Cpon);
+				subscriber.sendRawData(md, std::string(data));
+			}
+		}
+		QCOMPARE(subscribers[0].sendQueueStats().transcodeCacheHits, uint64_t(0));
+		QCOMPARE(subscribers[1].sendQueueStats().transcodeCacheHits, uint64_t(1));
+		QCOMPARE(subscribers[2].sendQueueStats().transcodeCacheHits, uint64_t(1));
+		QCOMPARE(subscribers[1].written, subscribers[0].written);
+		QCOMPARE(subscribers[2].written, subscribers[0].written);
+		LoopbackDriver receiver;
+		receiver.receive(subscribers[0].written);
+		QCOMPARE(RpcValue(receiver.lastReceived.toIMap()).toCpon(), RpcValue(ntf.toIMap()).toCpon());
+		// transcoded data are not kept after fan-out scope
+		subscribers[0].sendRawData(md, std::string(data));
+		QCOMPARE(subscribers[0].sendQueueStats().transcodeCacheHits, uint64_t(0));
+	}
+	void encodedMessageFanOut()
+	{
+		RpcValue ntf = create_notify("encoded");
+		EncodedMessage encoded_msg(ntf);
+		LoopbackDriver subscribers[3];
+		subscribers[0].setProtocolType(Rpc::ProtocolType::ChainPack);
+		subscribers[1].setProtocolType(Rpc::ProtocolType::Cpon);
+		subscribers[2].setProtocolType(Rpc::ProtocolType::ChainPack);
+		for(LoopbackDriver &subscriber : subscribers)
+			subscriber.sendEncodedMessage(encoded_msg);
+		QVERIFY(encoded_msg.data(Rpc::ProtocolType::ChainPack) == encoded_msg.data(Rpc::ProtocolType::ChainPack));
+		for(LoopbackDriver &subscriber : subscribers) {
+			LoopbackDriver driver;
+			driver.setProtocolType(subscriber.protocolType());
+			driver.sendRpcValue(ntf);
+			QCOMPARE(subscriber.written, driver.written);
+		}
+	}
+	void encodedMessageDetached()
+	{
+		RpcValue ntf = create_notify("encoded");
+		const std::string chainpack = ntf.toChainPack();
+		EncodedMessage encoded_msg(ntf);
+		// original message modified after encoded message is created
+		ntf.setMetaValue(RpcMessage::MetaType::Tag::ShvPath, "other/path");
+		ntf.set(RpcMessage::MetaType::Key::Params, "modified");
+		QCOMPARE(encoded_msg.value().toChainPack(), chainpack);
+		QCOMPARE(*encoded_msg.data(Rpc::ProtocolType::ChainPack), chainpack);
+		QVERIFY(encoded_msg.data(Rpc::ProtocolType::Cpon)->find("modified") == std::string::npos);
+	}
+	void bufferPoolReuse()
+	{
+		LoopbackDriver driver;
+		driver.setProtocolType(Rpc::ProtocolType::ChainPack);
+		for (unsigned i = 1; i <= 100; ++i)
+			driver.sendRpcValue(create_request(i));
+		// buffer of written message is taken again by the next one
+		const RpcDriver::SendQueueStats &stats = driver.sendQueueStats();
+		QCOMPARE(stats.bufferPoolMisses, uint64_t(1));
+		QCOMPARE(stats.bufferPoolHits, uint64_t(99));
+		QCOMPARE(driver.sendQueueBytes(), size_t(0));
+		LoopbackDriver receiver;
+		receiver.receive(driver.written);
+		QCOMPARE(receiver.receivedCount, 100);
+	}
+	void bufferPoolSizeCap()
+	{
+		RpcDriver::SendQueueStats stats;
+		LoopbackDriver::BufferPool pool(stats);
+		const size_t n = LoopbackDriver::BufferPool::MAX_CLASS_BUFFERS + 4;
+		for (size_t i = 0; i < n; ++i) {
+			std::string buff;
+			buff.reserve(LoopbackDriver::BufferPool::MIN_CLASS_CAPACITY);
+			pool.give(std::move(buff));
+		}
+		for (size_t i = 0; i < n; ++i) {
+			std::string buff = pool.take(LoopbackDriver::BufferPool::MIN_CLASS_CAPACITY);
+			QVERIFY(buff.empty());
+			QVERIFY(buff.capacity() >= LoopbackDriver::BufferPool::MIN_CLASS_CAPACITY);
+		}
+		QCOMPARE(stats.bufferPoolHits, uint64_t(LoopbackDriver::BufferPool::MAX_CLASS_BUFFERS));
+		QCOMPARE(stats.bufferPoolMisses, uint64_t(n - LoopbackDriver::BufferPool::MAX_CLASS_BUFFERS));
+		// huge buffers are not held
+		std::string huge;
+		huge.reserve(64 * 1024 * 1024);
+		pool.give(std::move(huge));
+		pool.take(1024 * 1024);
+		QCOMPARE(stats.bufferPoolMisses, uint64_t(n - LoopbackDriver::BufferPool::MAX_CLASS_BUFFERS + 1));
+	}
+	void sendQueueWatermarks()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		std::vector<bool> full_changes;
+		sender.setSendQueueFullChangedCallback([&full_changes](bool is_full) {
+			full_changes.push_back(is_full);
+		});
+		sender.writeStalled = true;
+		sender.sendRpcValue(create_request(1));
+		const size_t msg_size = sender.sendQueueBytes();
+		QVERIFY(msg_size > 0);
+		sender.setSendQueueWatermarks(msg_size, 3 * msg_size);
+		sender.sendRpcValue(create_request(2));
+		sender.sendRpcValue(create_request(3));
+		QVERIFY(!sender.isSendQueueFull());
+		QVERIFY(full_changes.empty());
+		// high watermark crossed
+		sender.sendRpcValue(create_request(4));
+		QVERIFY(sender.isSendQueueFull());
+		QCOMPARE(full_changes, std::vector<bool>{true});
+		QCOMPARE(sender.sendQueueStats().sendQueueFullCount, uint64_t(1));
+
+		sender.writeStalled = false;
+		sender.writeNext();
+		sender.writeNext();
+		QCOMPARE(sender.sendQueueBytes(), 2 * msg_size);
+		QVERIFY(sender.isSendQueueFull());
+		// low watermark reached
+		sender.writeNext();
+		QCOMPARE(sender.sendQueueBytes(), msg_size);
+		QVERIFY(!sender.isSendQueueFull());
+		QCOMPARE(full_changes, (std::vector<bool>{true, false}));
+		sender.writeNext();
+		QCOMPARE(sender.sendQueueDepth(), size_t(0));
+
+		LoopbackDriver receiver;
+		receiver.receive(sender.written);
+		QCOMPARE(receiver.receivedCount, 4);
+	}
+	void sendQueueOverflowDisconnect()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		sender.setSendQueueOverflowPolicy(RpcDriver::SendQueueOverflowPolicy::Disconnect);
+		sender.writeStalled = true;
+		sender.sendRpcValue(create_request(1));
+		const size_t msg_size = sender.sendQueueBytes();
+		sender.setSendQueueWatermarks(0, 3 * msg_size);
+		sender.sendRpcValue(create_request(2));
+		sender.sendRpcValue(create_request(3));
+		QCOMPARE(sender.overflowCount, 0);
+		sender.sendRpcValue(create_request(4));
+		QCOMPARE(sender.overflowCount, 1);
+		QVERIFY(!sender.open);
+		QCOMPARE(sender.sendQueueDepth(), size_t(0));
+		QCOMPARE(sender.sendQueueBytes(), size_t(0));
+		QVERIFY(!sender.isSendQueueFull());
+		QVERIFY(sender.written.empty());
+	}
+	void responseBeforeBulkResponses()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		sender.setBulkMessageSize(512);
+		sender.writeStalled = true;
+		for (unsigned i = 1; i <= 3; ++i) {
+			RpcResponse bulk_resp = RpcResponse::forRequest(RpcRequest(RpcMessage(create_request(i))));
+			bulk_resp.setResult(std::string(1024, 'x'));
+			sender.sendRpcValue(bulk_resp.value());
+		}
+		RpcResponse resp = RpcResponse::forRequest(RpcRequest(RpcMessage(create_request(7))));
+		resp.setResult(42);
+		sender.sendRpcValue(resp.value());
+		QCOMPARE(sender.sendQueueDepth(RpcDriver::MessagePriority::Bulk), size_t(3));
+		QCOMPARE(sender.sendQueueDepth(RpcDriver::MessagePriority::Response), size_t(1));
+
+		sender.writeStalled = false;
+		sender.writeNext();
+		QCOMPARE(sender.sendQueueDepth(RpcDriver::MessagePriority::Response), size_t(0));
+		QCOMPARE(sender.sendQueueDepth(RpcDriver::MessagePriority::Bulk), size_t(3));
+		LoopbackDriver receiver;
+		receiver.receive(sender.written);
+		QCOMPARE(receiver.receivedCount, 1);
+		RpcResponse received_resp(RpcMessage(receiver.lastReceived));
+		QVERIFY(received_resp.isResponse());
+		QCOMPARE(received_resp.requestId().toUInt(), 7u);
+		QCOMPARE(received_resp.result().toInt(), 42);
+
+		sender.writeNext();
+		sender.writeNext();
+		sender.writeNext();
+		QCOMPARE(sender.sendQueueDepth(), size_t(0));
+		LoopbackDriver receiver2;
+		receiver2.receive(sender.written);
+		QCOMPARE(receiver2.receivedCount, 4);
+		QCOMPARE(RpcResponse(RpcMessage(receiver2.lastReceived)).requestId().toUInt(), 3u);
+	}
+	void bigNotifyNotOvertaken()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		sender.setBulkMessageSize(512);
+		sender.writeStalled = true;
+		const std::string big_value(1024, 'x');
+		sender.sendRpcValue(create_notify(big_value));
+		sender.sendRpcValue(create_notify("small"));
+		QCOMPARE(sender.sendQueueDepth(RpcDriver::MessagePriority::Bulk), size_t(0));
+		QCOMPARE(sender.sendQueueDepth(RpcDriver::MessagePriority::Notify), size_t(2));
+
+		sender.writeStalled = false;
+		sender.writeNext();
+		sender.writeNext();
+		QCOMPARE(sender.sendQueueDepth(), size_t(0));
+		LoopbackDriver receiver;
+		receiver.receive(sender.written);
+		QCOMPARE(receiver.received.size(), size_t(2));
+		QCOMPARE(RpcRequest(RpcMessage(receiver.received[0])).params().toMap().value("value").toString(), big_value);
+		QCOMPARE(RpcRequest(RpcMessage(receiver.received[1])).params().toMap().value("value").toString(), std::string("small"));
+	}
+	void notifyCoalescing()
+	{
+		const std::string path1 = "shv/eu/pl/lublin/odpojovace/15/status";
+		const std::string path2 = "shv/eu/pl/lublin/odpojovace/16/status";
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		sender.setNotifyCoalescingWindow(100);
+		for (int i = 1; i <= 5; ++i)
+			sender.sendRpcValue(create_notify(std::to_string(i), path1));
+		sender.sendRpcValue(create_notify("a", path2));
+		// other signals are not coalesced
+		sender.sendRpcValue(create_notify("b", path1, "foo"));
+		QCOMPARE(sender.coalescedNotifyPendingCount, 1);
+		QCOMPARE(sender.coalescedNotifiesCount(), size_t(2));
+		QCOMPARE(sender.sendQueueStats().mergedNotifies, uint64_t(4));
+		{
+			LoopbackDriver receiver;
+			receiver.receive(sender.written);
+			QCOMPARE(receiver.receivedCount, 1);
+			QCOMPARE(RpcMessage(receiver.lastReceived).method().toString(), std::string("foo"));
+		}
+
+		sender.flushCoalescedNotifies();
+		QCOMPARE(sender.coalescedNotifiesCount(), size_t(0));
+		LoopbackDriver receiver;
+		receiver.receive(sender.written);
+		QCOMPARE(receiver.receivedCount, 3);
+		RpcNotify ntf1(RpcMessage(receiver.received[1]));
+		QCOMPARE(ntf1.shvPath().toString(), path1);
+		QCOMPARE(ntf1.params().toMap().value("value").toString(), std::string("5"));
+		RpcNotify ntf2(RpcMessage(receiver.received[2]));
+		QCOMPARE(ntf2.shvPath().toString(), path2);
+		QCOMPARE(ntf2.params().toMap().value("value").toString(), std::string("a"));
+
+		// new window is started after flush
+		sender.sendRpcValue(create_notify("6", path1));
+		QCOMPARE(sender.coalescedNotifyPendingCount, 2);
+		sender.setNotifyCoalescingWindow(0);
+		QCOMPARE(sender.coalescedNotifiesCount(), size_t(0));
+	}
+	void pendingRequestDuplicateId()
+	{
+		PendingRpcRequests pending;
+		int first_cnt = 0;
+		RpcResponse first_resp;
+		pending.addRequest(1, 0, [&first_cnt, &first_resp](const RpcResponse &resp) {
+			first_cnt++;
+			first_resp = resp;
+		});
+		int second_cnt = 0;
+		RpcResponse second_resp;
+		pending.addRequest(1, 0, [&second_cnt, &second_resp](const RpcResponse &resp) {
+			second_cnt++;
+			second_resp = resp;
+		});
+		QCOMPARE(second_cnt, 1);
+		QCOMPARE(second_resp.error().code(), RpcResponse::Error::InvalidRequest);
+		QCOMPARE(first_cnt, 0);
+		QCOMPARE(pending.count(), size_t(1));
+		RpcResponse resp;
+		resp.setRequestId(1);
+		resp.setResult(42);
+		QVERIFY(pending.processResponse(resp));
+		QCOMPARE(first_cnt, 1);
+		QCOMPARE(first_resp.result().toInt(), 42);
+		QCOMPARE(second_cnt, 1);
+		std::future<RpcResponse> f1 = pending.addRequest(2, 0);
+		std::future<RpcResponse> f2 = pending.addRequest(2, 0);
+		QCOMPARE(f2.get().error().code(), RpcResponse::Error::InvalidRequest);
+		pending.cancelAll();
+		QCOMPARE(f1.get().error().code(), RpcResponse::Error::SyncMethodCallCancelled);
+	}
+	void pendingRequestForwardedResponse()
+	{
+		LoopbackDriver driver;
+		driver.setProtocolType(Rpc::ProtocolType::ChainPack);
+		int callback_cnt = 0;
+		driver.sendRpcRequest(RpcRequest(RpcMessage(create_request(7))), [&callback_cnt](const RpcResponse &) {callback_cnt++;});
+		// response to forwarded request with the same request id
+		RpcResponse forwarded;
+		forwarded.setRequestId(7);
+		forwarded.setCallerIds(RpcValue::List{3, 5});
+		forwarded.setResult("forwarded");
+		LoopbackDriver peer;
+		peer.setProtocolType(Rpc::ProtocolType::ChainPack);
+		peer.sendRpcValue(forwarded.value());
+		driver.receive(peer.written);
+		QCOMPARE(callback_cnt, 0);
+		QCOMPARE(driver.receivedCount, 1);
+		QCOMPARE(driver.pendingRequests().count(), size_t(1));
+
+		RpcResponse own;
+		own.setRequestId(7);
+		own.setResult("own");
+		peer.written.clear();
+		peer.sendRpcValue(own.value());
+		driver.receive(peer.written);
+		QCOMPARE(callback_cnt, 1);
+		QCOMPARE(driver.receivedCount, 1);
+		QCOMPARE(driver.pendingRequests().count(), size_t(0));
+	}
+	void pendingRequestTimeout()
+	{
+		PendingRpcRequests pending;
+		int timed_out_cnt = 0;
+		RpcResponse timed_out_resp;
+		pending.addRequest(1, 50, [&timed_out_cnt, &timed_out_resp](const RpcResponse &resp) {
+			timed_out_cnt++;
+			timed_out_resp = resp;
+		});
+		int long_cnt = 0;
+		pending.addRequest(2, 60 * 1000, [&long_cnt](const RpcResponse &) {
+			long_cnt++;
+		});
+		int no_timeout_cnt = 0;
+		pending.addRequest(3, 0, [&no_timeout_cnt](const RpcResponse &) {
+			no_timeout_cnt++;
+		});
+		pending.checkTimeouts();
+		QCOMPARE(timed_out_cnt, 0);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50 + 3 * pending.tickMsec()));
+		pending.checkTimeouts();
+		QCOMPARE(timed_out_cnt, 1);
+		QCOMPARE(timed_out_resp.requestId().toUInt(), 1u);
+		QCOMPARE(timed_out_resp.error().code(), RpcResponse::Error::SyncMethodCallTimeout);
+		QCOMPARE(long_cnt, 0);
+		QCOMPARE(no_timeout_cnt, 0);
+		QCOMPARE(pending.count(), size_t(2));
+		// late response is ignored
+		RpcResponse resp;
+		resp.setRequestId(1);
+		resp.setResult(42);
+		QVERIFY(!pending.processResponse(resp));
+		QCOMPARE(timed_out_cnt, 1);
+	}
+	void pendingRequestCancelAll()
+	{
+		PendingRpcRequests pending;
+		std::map<unsigned, int> call_counts;
+		for (unsigned id = 1; id <= 3; ++id) {
+			pending.addRequest(id, 50, [&call_counts](const RpcResponse &resp) {
+				QCOMPARE(resp.error().code(), RpcResponse::Error::SyncMethodCallCancelled);
+				QCOMPARE(resp.error().message(), std::string("connection closed"));
+				call_counts[resp.requestId().toUInt()]++;
+			});
+		}
+		pending.cancelAll("connection closed");
+		QVERIFY(pending.isEmpty());
+		QCOMPARE(call_counts, (std::map<unsigned, int>{{1, 1}, {2, 1}, {3, 1}}));
+		// cancelled timers must not fire
+		std::this_thread::sleep_for(std::chrono::milliseconds(50 + 3 * pending.tickMsec()));
+		pending.checkTimeouts();
+		pending.cancelAll();
+		QCOMPARE(call_counts, (std::map<unsigned, int>{{1, 1}, {2, 1}, {3, 1}}));
+	}
+	void pendingRequestCompletedOnce()
+	{
+		PendingRpcRequests pending;
+		int cnt = 0;
+		pending.addRequest(1, 50, [&cnt](const RpcResponse &resp) {
+			QCOMPARE(resp.result().toInt(), 42);
+			cnt++;
+		});
+		RpcResponse resp;
+		resp.setRequestId(1);
+		resp.setResult(42);
+		QVERIFY(pending.processResponse(resp));
+		QVERIFY(!pending.processResponse(resp));
+		QVERIFY(!pending.cancelRequest(1));
+		std::this_thread::sleep_for(std::chrono::milliseconds(50 + 3 * pending.tickMsec()));
+		pending.checkTimeouts();
+		pending.cancelAll();
+		QCOMPARE(cnt, 1);
+		QVERIFY(pending.isEmpty());
+
+		std::future<RpcResponse> f = pending.addRequest(2, 0);
+		QVERIFY(pending.cancelRequest(2, "stop"));
+		QVERIFY(!pending.cancelRequest(2));
+		RpcResponse cancelled = f.get();
+		QCOMPARE(cancelled.error().code(), RpcResponse::Error::SyncMethodCallCancelled);
+		QCOMPARE(cancelled.error().message(), std::string("stop"));
+	}
+	void metricsRequestResponse()
+	{
+		LoopbackDriver client;
+		client.setProtocolType(Rpc::ProtocolType::ChainPack);
+		LoopbackDriver server;
+		int response_cnt = 0;
+		client.sendRpcRequest(RpcRequest(RpcMessage(create_request(1))), [&response_cnt](const RpcResponse &resp) {
+			QCOMPARE(resp.result().toInt(), 42);
+			response_cnt++;
+		});
+		const RpcMetrics &cm = client.metrics();
+		QCOMPARE(cm.counter(RpcMetrics::Counter::FramesOut), uint64_t(1));
+		QCOMPARE(cm.counter(RpcMetrics::Counter::BytesOut), uint64_t(client.written.size()));
+		QCOMPARE(cm.gauge(RpcMetrics::Gauge::PendingRequests), int64_t(1));
+		QCOMPARE(cm.gauge(RpcMetrics::Gauge::SendQueueDepth), int64_t(0));
+		RpcMetrics::Histogram::Snapshot size_out = cm.histogram(RpcMetrics::HistogramId::MessageSizeOut).snapshot();
+		QCOMPARE(size_out.count, uint64_t(1));
+
+		server.receive(client.written);
+		const RpcMetrics &sm = server.metrics();
+		QCOMPARE(sm.counter(RpcMetrics::Counter::FramesIn), uint64_t(1));
+		QCOMPARE(sm.counter(RpcMetrics::Counter::BytesIn), uint64_t(client.written.size()));
+		QCOMPARE(sm.counter(RpcMetrics::Counter::DecodeErrors), uint64_t(0));
+		RpcMetrics::Histogram::Snapshot size_in = sm.histogram(RpcMetrics::HistogramId::MessageSizeIn).snapshot();
+		QCOMPARE(size_in.count, uint64_t(1));
+		QCOMPARE(size_in.sum, size_out.sum);
+
+		RpcResponse resp = RpcResponse::forRequest(RpcRequest(RpcMessage(server.lastReceived)));
+		resp.setResult(42);
+		server.sendRpcValue(resp.value());
+		const int64_t delay_msec = 5;
+		std::this_thread::sleep_for(std::chrono::milliseconds(delay_msec));
+		client.receive(server.written);
+		QCOMPARE(response_cnt, 1);
+		QCOMPARE(client.receivedCount, 0);
+		QCOMPARE(cm.counter(RpcMetrics::Counter::FramesIn), uint64_t(1));
+		QCOMPARE(cm.counter(RpcMetrics::Counter::BytesIn), uint64_t(server.written.size()));
+		QCOMPARE(cm.gauge(RpcMetrics::Gauge::PendingRequests), int64_t(0));
+		RpcMetrics::Histogram::Snapshot latency = cm.histogram(RpcMetrics::HistogramId::RequestLatencyUsec).snapshot();
+		QCOMPARE(latency.count, uint64_t(1));
+		QVERIFY(latency.sum >= uint64_t(delay_msec * 1000));
+		QCOMPARE(latency.max, latency.sum);
+		QCOMPARE(sm.histogram(RpcMetrics::HistogramId::RequestLatencyUsec).snapshot().count, uint64_t(0));
+	}
+	void metricsDecodeError()
+	{
+		const std::string invalid_json = "{\"id\":";
+		std::ostringstream os;
+		ChainPackWriter wr(os);
+		wr.writeUIntData(invalid_json.size() + 1);
+		wr.writeUIntData((unsigned)Rpc::ProtocolType::JsonRpc);
+		os << invalid_json;
+		LoopbackDriver receiver;
+		receiver.receive(os.str());
+		QCOMPARE(receiver.receivedCount, 0);
+		QCOMPARE(receiver.metrics().counter(RpcMetrics::Counter::FramesIn), uint64_t(1));
+		QCOMPARE(receiver.metrics().counter(RpcMetrics::Counter::DecodeErrors), uint64_t(1));
+	}
+	void benchFanOutEncodedMessage()
+	{
+		std::vector<LoopbackDriver> subscribers(100);
+		for(LoopbackDriver &subscriber : subscribers)
+			subscriber.setProtocolType(Rpc::ProtocolType::ChainPack);
+		RpcValue ntf = create_notify("bench");
+		QBENCHMARK {
+			EncodedMessage encoded_msg(ntf);
+			for(LoopbackDriver &subscriber : subscribers) {
+				subscriber.sendEncodedMessage(encoded_msg);
+				subscriber.written.clear();
+			}
+		}
+	}
+	void benchFanOutRpcValue()
+	{
+		// what the fan-out cost, when every connection encoded the message
+		std::vector<LoopbackDriver> subscribers(100);
+		for(LoopbackDriver &subscriber : subscribers)
+			subscriber.setProtocolType(Rpc::ProtocolType::ChainPack);
+		RpcValue ntf = create_notify("bench");
+		QBENCHMARK {
+			for(LoopbackDriver &subscriber : subscribers) {
+				subscriber.sendRpcValue(ntf);
+				subscriber.written.clear();
+			}
+		}
+	}
+	void benchTranscodeChainPackToCpon()
+	{
+		const std::string data = RpcValue(create_notify("bench").toIMap()).toChainPack();
+		QBENCHMARK {
+			std::ostringstream out;
+			DataTranscoder::chainPackToCpon(data, 0, out);
+		}
+	}
+	void benchRecodeChainPackToCpon()
+	{
+		// what the recoding cost, when data were decoded to RpcValue
+		const std::string data = RpcValue(create_notify("bench").toIMap()).toChainPack();
+		QBENCHMARK {
+			std::istringstream in(data);
+			ChainPackReader rd(in);
+			RpcValue val;
+			rd.read(val);
+			std::ostringstream out;
+			CponWriter wr(out);
+			wr << val;
+		}
+	}
+	void benchSendTopicsOff()
+	{
+		LoopbackDriver driver;
+		driver.setProtocolType(Rpc::ProtocolType::ChainPack);
+		RpcValue msg = create_request(1);
+		QBENCHMARK {
+			driver.sendRpcValue(msg);
+			driver.written.clear();
+		}
+	}
+	void benchSendEagerFormatting()
+	{
+		// what the send path cost, when log arguments were formatted regardless of topic
+		LoopbackDriver driver;
+		driver.setProtocolType(Rpc::ProtocolType::ChainPack);
+		RpcValue msg = create_request(1);
+		QBENCHMARK {
+			std::string pretty = msg.toPrettyString();
+			driver.sendRpcValue(msg);
+			std::string hex = Utils::toHex(driver.written, 0, 250);
+			driver.written.clear();
+			Q_UNUSED(pretty)
+			Q_UNUSED(hex)
+		}
+	}
+	void benchReceiveTopicsOff()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::ChainPack);
+		sender.sendRpcValue(create_request(1));
+		LoopbackDriver receiver;
+		QBENCHMARK {
+			receiver.receive(sender.written);
+		}
+	}
+	void benchReceiveJsonRpc()
+	{
+		LoopbackDriver sender;
+		sender.setProtocolType(Rpc::ProtocolType::JsonRpc);
+		sender.sendRpcValue(create_request(1));
+		LoopbackDriver receiver;
+		QBENCHMARK {
+			receiver.receive(sender.written);
+		}
+	}
+	void benchSendJsonRpc()
+	{
+		LoopbackDriver driver;
+		driver.setProtocolType(Rpc::ProtocolType::JsonRpc);
+		RpcValue msg = create_request(1);
+		QBENCHMARK {
+			driver.sendRpcValue(msg);
+			driver.written.clear();
+		}
+	}
+};
+
+QTEST_MAIN(TestRpcDriver)
+#include "tst_chainpack_rpcdriver.moc"
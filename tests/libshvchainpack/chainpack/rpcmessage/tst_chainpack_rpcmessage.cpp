@@ -1,6 +1,7 @@
 #include <shv/chainpack/chainpackreader.h>
 #include <shv/chainpack/chainpackwriter.h>
 #include <shv/chainpack/rpcmessage.h>
+#include <shv/chainpack/metatypes.h>
 //#include <shv/chainpack/chainpackprotocol.h>
 
 #include <cassert>
@@ -149,6 +150,17 @@ private:
 		QCOMPARE(rq2.params(), rq.params());
 	}
 }
+	static RpcRequest sampleRequest()
+	{
+		RpcRequest rq;
+		rq.setRequestId(123).setMethod("get").setParams(RpcValue::List{1, "foo"});
+		rq.setShvPath("shv/dev/temp");
+		RpcValue::Array caller_ids{RpcValue::Type::UInt};
+		caller_ids.push_back(RpcValue::ArrayElement(3u));
+		caller_ids.push_back(RpcValue::ArrayElement(300u));
+		rq.setCallerIds(caller_ids);
+		return rq;
+	}
 private slots:
 	void initTestCase()
 	{
@@ -159,6 +171,204 @@ private slots:
 		rpcmessageTest();
 	}
 
+	void callerIds()
+	{
+		RpcValue::MetaData md;
+		RpcMessage::pushCallerId(md, 1);
+		QCOMPARE(RpcMessage::callerIds(md).toUInt(), 1u);
+		RpcMessage::pushCallerId(md, 2);
+		RpcMessage::pushCallerId(md, 3);
+		QCOMPARE(RpcMessage::callerIds(md).toCpon(), std::string("a[1u, 2u, 3u]"));
+		// caller ids shared with another meta data must not be modified in place
+		RpcValue::MetaData md2(md);
+		QCOMPARE(RpcMessage::popCallerId(md), 3u);
+		RpcMessage::pushCallerId(md2, 4);
+		QCOMPARE(RpcMessage::callerIds(md).toCpon(), std::string("a[1u, 2u]"));
+		QCOMPARE(RpcMessage::callerIds(md2).toCpon(), std::string("a[1u, 2u, 3u, 4u]"));
+		QCOMPARE(RpcMessage::popCallerId(md), 2u);
+		QCOMPARE(RpcMessage::popCallerId(md), 1u);
+		QCOMPARE(RpcMessage::popCallerId(md), 0u);
+	}
+	void benchCallerIdsPushPop()
+	{
+		RpcValue::MetaData md;
+		RpcMessage::setCallerIds(md, RpcValue::Array{RpcValue::Type::UInt});
+		QBENCHMARK {
+			for (RpcValue::UInt i = 1; i <= 8; ++i)
+				RpcMessage::pushCallerId(md, i);
+			for (int i = 0; i < 8; ++i)
+				RpcMessage::popCallerId(md);
+		}
+	}
+
+	void metaTypeTranslateIds()
+	{
+		const meta::MetaType &mt = meta::registeredType(meta::GlobalNS::ID, RpcMessage::MetaType::ID);
+		QCOMPARE(std::string(mt.name()), std::string("RpcMessage"));
+		QCOMPARE(std::string(mt.tagById(RpcMessage::MetaType::Tag::Method).name), std::string("method"));
+		QCOMPARE(std::string(mt.tagById(meta::Tag::MetaTypeId).name), std::string("T"));
+		QCOMPARE(std::string(mt.keyById(RpcMessage::MetaType::Key::Params).name), std::string("params"));
+		QVERIFY(!mt.tagById(RpcMessage::MetaType::Tag::MAX).isValid());
+		QVERIFY(!mt.keyById(0).isValid());
+
+		RpcRequest rq;
+		rq.setRequestId(1).setMethod("get").setParams(42);
+		rq.setMetaValue(meta::Tag::MetaTypeId, RpcMessage::MetaType::ID);
+		QCOMPARE(rq.value().toPrettyString(), std::string("<T:RpcMessage, id:1u, method:\"get\">i{params:42}"));
+
+		// runtime registration of user types
+		struct TestType : public meta::MetaType
+		{
+			TestType() : meta::MetaType("TestType") { m_keys = {{1, {1, "foo"}}}; }
+		};
+		static TestType test_type;
+		static meta::MetaNameSpace test_ns("TestNS");
+		const int test_type_id = 100;
+		meta::registerType(meta::GlobalNS::ID, test_type_id, &test_type);
+		meta::registerNameSpace(7, &test_ns);
+		meta::registerType(7, test_type_id, &test_type);
+		QCOMPARE(std::string(meta::registeredType(meta::GlobalNS::ID, test_type_id).keyById(1).name), std::string("foo"));
+		QCOMPARE(std::string(meta::registeredType(7, test_type_id).name()), std::string("TestType"));
+		meta::registerType(meta::GlobalNS::ID, test_type_id, nullptr);
+		meta::registerNameSpace(7, nullptr);
+		QVERIFY(!meta::registeredType(meta::GlobalNS::ID, test_type_id).isValid());
+		QVERIFY(!meta::registeredType(7, test_type_id).isValid());
+	}
+	void benchMetaTypeLookup()
+	{
+		int n = 0;
+		QBENCHMARK {
+			const meta::MetaType &mt = meta::registeredType(meta::GlobalNS::ID, RpcMessage::MetaType::ID);
+			for (int tag = RpcMessage::MetaType::Tag::RequestId; tag < RpcMessage::MetaType::Tag::MAX; ++tag)
+				n += mt.tagById(tag).id;
+		}
+		QVERIFY(n > 0);
+	}
+	void typedHeader()
+	{
+		RpcRequest rq = sampleRequest();
+
+		std::ostringstream out;
+		ChainPackWriter wr(out);
+		wr << rq.value();
+		std::string data = out.str();
+
+		{
+			std::istringstream in(data);
+			ChainPackReader rd(in);
+			RpcMessage::Header h = RpcMessage::Header::read(rd);
+			QCOMPARE(h.requestId.value(), 123u);
+			QCOMPARE(h.method.value(), std::string("get"));
+			QCOMPARE(h.shvPath.value(), std::string("shv/dev/temp"));
+			QVERIFY(h.callerIds.value() == (std::vector<RpcValue::UInt>{3, 300}));
+			QVERIFY(h.isRequest());
+			// message data follows meta data read
+			RpcValue msg_data = rd.read();
+			QCOMPARE(msg_data.toCpon(), RpcValue(rq.value().toIMap()).toCpon());
+
+			// typed write produces the same ChainPack as meta data write
+			std::ostringstream out2;
+			ChainPackWriter wr2(out2);
+			h.write(wr2);
+			wr2 << msg_data;
+			QCOMPARE(out2.str(), data);
+			QCOMPARE(h.toMetaData().iValues().size(), rq.metaData().iValues().size());
+			QVERIFY(RpcMessage::Header::fromMetaData(rq.metaData()).callerIds == h.callerIds);
+		}
+		{
+			// single caller id and unknown tags
+			RpcValue::MetaData md2;
+			RpcMessage::setMethod(md2, "chng");
+			RpcMessage::pushCallerId(md2, 7);
+			md2.setValue(100, RpcValue::Map{{"a", 1}});
+			md2.setValue("foo", "bar");
+			std::ostringstream out2;
+			ChainPackWriter wr2(out2);
+			wr2 << md2;
+			wr2 << RpcValue(42);
+			std::istringstream in(out2.str());
+			ChainPackReader rd(in);
+			RpcMessage::Header h = RpcMessage::Header::read(rd);
+			QVERIFY(h.isNotify());
+			QVERIFY(h.callerIds.value() == std::vector<RpcValue::UInt>{7});
+			QCOMPARE(rd.read().toInt(), 42);
+		}
+		{
+			// zero request and caller id are values, not missing fields
+			RpcRequest rq0;
+			rq0.setRequestId(0u).setMethod("ls");
+			RpcValue::MetaData md0 = rq0.metaData();
+			RpcMessage::pushCallerId(md0, 0);
+			RpcMessage::Header h = RpcMessage::Header::fromMetaData(md0);
+			QVERIFY(h.requestId.isSet());
+			QVERIFY(h.isRequest());
+			QVERIFY(!h.protocolType.isSet());
+			QCOMPARE(h.toMetaData().iValues().size(), md0.iValues().size());
+			std::ostringstream out2;
+			ChainPackWriter wr2(out2);
+			h.write(wr2);
+			wr2 << RpcValue(42);
+			std::istringstream in(out2.str());
+			ChainPackReader rd(in);
+			RpcMessage::Header h2 = RpcMessage::Header::read(rd);
+			QVERIFY(h2.requestId.isSet());
+			QCOMPARE(h2.requestId.value(), 0u);
+			QVERIFY(h2.callerIds.value() == std::vector<RpcValue::UInt>{0});
+			QVERIFY(h2.isRequest());
+			QCOMPARE(rd.read().toInt(), 42);
+		}
+		{
+			// meta data IMap following SMap
+			RpcValue::MetaData smd;
+			smd.setValue("foo", "bar");
+			RpcValue::MetaData imd;
+			RpcMessage::setRequestId(imd, 5u);
+			RpcMessage::setMethod(imd, "get");
+			std::ostringstream out2;
+			ChainPackWriter wr2(out2);
+			wr2 << smd;
+			wr2 << imd;
+			wr2 << RpcValue(42);
+			std::istringstream in(out2.str());
+			ChainPackReader rd(in);
+			RpcMessage::Header h = RpcMessage::Header::read(rd);
+			QCOMPARE(h.requestId.value(), 5u);
+			QCOMPARE(h.method.value(), std::string("get"));
+			QCOMPARE(rd.read().toInt(), 42);
+		}
+	}
+	void benchTypedHeaderRead()
+	{
+		std::ostringstream out;
+		ChainPackWriter wr(out);
+		sampleRequest().write(wr);
+		std::string data = out.str();
+		size_t n = 0;
+		QBENCHMARK {
+			std::istringstream in(data);
+			ChainPackReader rd(in);
+			RpcMessage::Header h = RpcMessage::Header::read(rd);
+			n += h.requestId.value() + h.method.value().size() + h.shvPath.value().size();
+		}
+		QVERIFY(n > 0);
+	}
+	void benchMetaDataRead()
+	{
+		std::ostringstream out;
+		ChainPackWriter wr(out);
+		sampleRequest().write(wr);
+		std::string data = out.str();
+		size_t n = 0;
+		QBENCHMARK {
+			std::istringstream in(data);
+			ChainPackReader rd(in);
+			RpcValue::MetaData md;
+			rd.read(md);
+			n += RpcMessage::requestId(md).toUInt() + RpcMessage::method(md).toString().size() + RpcMessage::shvPath(md).toString().size();
+		}
+		QVERIFY(n > 0);
+	}
+
 	void cleanupTestCase()
 	{
 		//qDebug("called after firstTest and secondTest");
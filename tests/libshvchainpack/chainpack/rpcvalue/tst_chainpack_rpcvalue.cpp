@@ -831,6 +831,32 @@ private:
 			QVERIFY(cp1.type() == cp2.type());
 			QVERIFY(cp1.metaData() == cp2.metaData());
 		}
+		{
+			qDebug() << "------------- encodedSize";
+			for(const std::string &cpon : {"null", "true", "63u", "64u", "-1", "123456789", "1.5", "-12.345", "\"foo\"", "b\"a\\x01\"",
+				"d\"2018-02-02T00:00:00Z\"", "d\"2017-05-03T15:52:31.123+10\"", "[1,[2,{\"a\":3}],i{1:4}]",
+				"<1:2,\"foo\":\"bar\">{\"x\":<8:3>[1u,2u]}"}) {
+				std::string err;
+				RpcValue cp1 = RpcValue::fromCpon(cpon, &err);
+				QVERIFY(err.empty());
+				std::stringstream out;
+				ChainPackWriter wr(out); size_t len = wr.write(cp1);
+				QCOMPARE(ChainPackWriter::encodedSize(cp1), len);
+				QCOMPARE(ChainPackWriter::encodedSize(cp1.metaData()), wr.write(cp1.metaData()));
+			}
+			RpcValue::Array array(RpcValue::Type::Int);
+			for (int i = 0; i < 100; ++i)
+				array.push_back(RpcValue::Array::makeElement(RpcValue(i * i * 1000 - 5)));
+			RpcValue cp1{array};
+			std::stringstream out;
+			ChainPackWriter wr(out); size_t len = wr.write(cp1);
+			QCOMPARE(ChainPackWriter::encodedSize(cp1), len);
+			for (uint64_t n : {0ULL, 127ULL, 128ULL, 1ULL << 40}) {
+				std::stringstream out;
+				ChainPackWriter::writeUIntData(out, n);
+				QCOMPARE(ChainPackWriter::uIntDataSize(n), out.str().size());
+			}
+		}
 	}
 
 private slots:
@@ -0,0 +1,6 @@
+include ( ../../test_libshvchainpack.pri )
+
+TARGET = tst_chainpack_timerwheel
+
+SOURCES += \
+    $${TARGET}.cpp \
@@ -0,0 +1,71 @@
+#include <shv/chainpack/timerwheel.h>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+
+namespace {
+
+const int64_t MSEC_PER_DAY = 24 * 60 * 60 * 1000LL;
+
+}
+
+class TestTimerWheel: public QObject
+{
+	Q_OBJECT
+private slots:
+	void expiration()
+	{
+		TimerWheel wheel(10);
+		int fired = 0;
+		wheel.addTimer(1000, 100, [&fired]() {fired++;});
+		QCOMPARE(wheel.advance(1099), size_t(0));
+		QCOMPARE(wheel.advance(1100), size_t(1));
+		QCOMPARE(fired, 1);
+		QVERIFY(wheel.isEmpty());
+	}
+	void cancel()
+	{
+		TimerWheel wheel(10);
+		int fired = 0;
+		TimerWheel::TimerId id = wheel.addTimer(0, 100, [&fired]() {fired++;});
+		QVERIFY(wheel.cancelTimer(id));
+		QVERIFY(!wheel.cancelTimer(id));
+		QCOMPARE(wheel.advance(1000), size_t(0));
+		QCOMPARE(fired, 0);
+	}
+	void longTimeouts()
+	{
+		// timers spanning higher levels are cascaded and they fire on their tick
+		TimerWheel wheel(10);
+		for(int timeout : {650, 41000, 2700000}) {
+			int fired = 0;
+			wheel.addTimer(0, timeout, [&fired]() {fired++;});
+			QCOMPARE(wheel.advance(timeout - 10), size_t(0));
+			QCOMPARE(wheel.advance(timeout), size_t(1));
+			QCOMPARE(fired, 1);
+			wheel = TimerWheel(10);
+		}
+	}
+	void emptyWheelRebased()
+	{
+		// wheel not advanced for days, timer added then fires after its timeout, not sooner
+		for(bool cancelled : {false, true}) {
+			TimerWheel wheel(10);
+			TimerWheel::TimerId id = wheel.addTimer(0, 10, []() {});
+			if(cancelled)
+				wheel.cancelTimer(id);
+			else
+				QCOMPARE(wheel.advance(10), size_t(1));
+			const int64_t now = 3 * MSEC_PER_DAY;
+			int fired = 0;
+			wheel.addTimer(now, 1000, [&fired]() {fired++;});
+			QCOMPARE(wheel.advance(now + 990), size_t(0));
+			QCOMPARE(wheel.advance(now + 1000), size_t(1));
+			QCOMPARE(fired, 1);
+		}
+	}
+};
+
+QTEST_MAIN(TestTimerWheel)
+#include "tst_chainpack_timerwheel.moc"
@@ -0,0 +1,6 @@
+include ( ../../test_libshviotqt.pri )
+
+TARGET = tst_rpc_tcpserver
+
+SOURCES += \
+    $${TARGET}.cpp \
@@ -0,0 +1,119 @@
+#include <shv/iotqt/rpc/serverconnection.h>
+#include <shv/iotqt/rpc/tcpserver.h>
+
+#include <shv/chainpack/rpcmessage.h>
+
+#include <QTcpSocket>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QtTest/QtTest>
+
+using namespace shv::chainpack;
+using namespace shv::iotqt::rpc;
+
+namespace {
+
+/// connection sending Cpon without hello and login
+class CponServerConnection : public ServerConnection
+{
+public:
+	CponServerConnection(QTcpSocket *socket, QObject *parent) : ServerConnection(socket, parent)
+	{
+		setProtocolType(Rpc::ProtocolType::Cpon);
+	}
+protected:
+	RpcValue login(const RpcValue &) override {return RpcValue();}
+};
+
+class CponTcpServer : public TcpServer
+{
+protected:
+	ServerConnection* createServerConnection(QTcpSocket *socket, QObject *parent) override
+	{
+		return new CponServerConnection(socket, parent);
+	}
+};
+
+/// clients connected to server, the received data are kept in sockets
+std::vector<std::unique_ptr<QTcpSocket>> connect_clients(TcpServer &server, int n)
+{
+	std::vector<std::unique_ptr<QTcpSocket>> ret;
+	for (int i = 0; i < n; ++i) {
+		std::unique_ptr<QTcpSocket> socket(new QTcpSocket());
+		socket->connectToHost(QHostAddress::LocalHost, server.serverPort());
+		ret.push_back(std::move(socket));
+	}
+	return ret;
+}
+
+/// notification data encoded in ChainPack, protocol type is set in meta data
+std::string create_notify(const std::string &value, RpcValue::MetaData &meta_data)
+{
+	RpcNotify ntf;
+	ntf.setMethod("chng");
+	ntf.setShvPath("shv/eu/pl/lublin/odpojovace/15/status");
+	ntf.setParams(RpcValue::Map{
+					  {"value", value},
+					  {"flags", RpcValue::List{1, 2, 3}},
+				  });
+	meta_data = ntf.value().metaData();
+	RpcMessage::setProtocolType(meta_data, Rpc::ProtocolType::ChainPack);
+	return RpcValue(ntf.value().toIMap()).toChainPack();
+}
+
+}
+
+class TestTcpServer: public QObject
+{
+	Q_OBJECT
+private slots:
+	void rawNotifyTranscodedOnce()
+	{
+		CponTcpServer server;
+		QVERIFY(server.start(0));
+		auto clients = connect_clients(server, 3);
+		QTRY_COMPARE(server.connectionIds().size(), size_t(3));
+
+		RpcValue::MetaData md;
+		const std::string data = create_notify("fan-out", md);
+		QCOMPARE(server.sendRawDataToConnections(server.connectionIds(), md, data), size_t(3));
+		uint64_t cache_hits = 0;
+		for(unsigned connection_id : server.connectionIds())
+			cache_hits += server.connectionById(connection_id)->sendQueueStats().transcodeCacheHits;
+		QCOMPARE(cache_hits, uint64_t(2));
+
+		std::vector<QByteArray> received(clients.size());
+		for (size_t i = 0; i < clients.size(); ++i) {
+			QTRY_VERIFY(clients[i]->bytesAvailable() > 0);
+			received[i] = clients[i]->readAll();
+		}
+		QCOMPARE(received[1], received[0]);
+		QCOMPARE(received[2], received[0]);
+		QVERIFY(received[0].contains("fan-out"));
+	}
+	void rawNotifyFanOutWorkerThreads()
+	{
+		CponTcpServer server;
+		server.setWorkerThreadCount(2);
+		QVERIFY(server.start(0));
+		auto clients = connect_clients(server, 4);
+		QTRY_COMPARE(server.connectionIds().size(), size_t(4));
+
+		RpcValue::MetaData md;
+		const std::string data = create_notify("worker fan-out", md);
+		QCOMPARE(server.sendRawDataToConnections(server.connectionIds(), md, data), size_t(4));
+		std::vector<QByteArray> received(clients.size());
+		for (size_t i = 0; i < clients.size(); ++i) {
+			QTRY_VERIFY(clients[i]->bytesAvailable() > 0);
+			received[i] = clients[i]->readAll();
+			QCOMPARE(received[i], received[0]);
+		}
+		QVERIFY(received[0].contains("worker fan-out"));
+	}
+};
+
+QTEST_MAIN(TestTcpServer)
+#include "tst_rpc_tcpserver.moc"
@@ -0,0 +1,30 @@
+include ( $$PWD/../test.pri )
+
+QT += network
+QT -= gui
+
+INCLUDEPATH += \
+	$$PWD/../../libshvcore/include \
+	$$PWD/../../libshvcoreqt/include \
+	$$PWD/../../libshvchainpack/include \
+	$$PWD/../../libshviotqt/include \
+	$$PWD/../../3rdparty/necrolog/include \
+
+win32:LIB_DIR = $$DESTDIR
+else:LIB_DIR = $$SHV_PROJECT_TOP_BUILDDIR/lib
+
+message (LIB_DIR $$LIB_DIR)
+message (DESTDIR $$DESTDIR)
+
+LIBS += \
+    -L$$LIB_DIR \
+    -lnecrolog \
+    -lshvchainpack \
+    -lshvcore \
+    -lshvcoreqt \
+    -lshviotqt \
+
+unix {
+    LIBS += \
+        -Wl,-rpath,\'$${LIB_DIR}\'
+}
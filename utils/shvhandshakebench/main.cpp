@@ -0,0 +1,116 @@
+#include <necrolog.h>
+
+#include <shv/iotqt/rpc/clientconnection.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace cp = shv::chainpack;
+namespace rpc = shv::iotqt::rpc;
+
+static const char *shvhandshakebench_help =
+R"( Connects N clients to SHV broker at once and reports hello/login handshakes per second
+
+USAGE:
+-s host
+	broker host (default localhost)
+-p port
+	broker port (default 3755)
+-u user
+	login user
+--password password
+	login password
+-n count
+	number of clients (default 100)
+-t seconds
+	give up after timeout (default 60)
+
+)";
+
+void help(const std::string &app_name)
+{
+	std::cout << app_name << shvhandshakebench_help;
+	std::cout << NecroLog::cliHelp();
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	std::vector<std::string> args = NecroLog::setCLIOptions(argc, argv);
+
+	if(std::find(args.begin(), args.end(), "--help") != args.end()) {
+		help(argv[0]);
+	}
+
+	std::string o_host = "localhost";
+	int o_port = cp::AbstractRpcConnection::DEFAULT_RPC_BROKER_PORT;
+	std::string o_user;
+	std::string o_password;
+	int o_count = 100;
+	int o_timeout = 60;
+
+	for (size_t i = 1; i < args.size(); ++i) {
+		const std::string &arg = args[i];
+		bool has_value = i < args.size() - 1;
+		if(arg == "-s" && has_value)
+			o_host = args[++i];
+		else if(arg == "-p" && has_value)
+			o_port = std::stoi(args[++i]);
+		else if(arg == "-u" && has_value)
+			o_user = args[++i];
+		else if(arg == "--password" && has_value)
+			o_password = args[++i];
+		else if(arg == "-n" && has_value)
+			o_count = std::stoi(args[++i]);
+		else if(arg == "-t" && has_value)
+			o_timeout = std::stoi(args[++i]);
+		else if(arg == "-h")
+			help(argv[0]);
+	}
+	if(o_count <= 0)
+		help(argv[0]);
+
+	nInfo() << "connecting" << o_count << "clients to" << o_host << ":" << o_port;
+
+	std::vector<qint64> latencies;
+	latencies.reserve(static_cast<size_t>(o_count));
+	QElapsedTimer elapsed;
+	elapsed.start();
+
+	for (int i = 0; i < o_count; ++i) {
+		// no driver thread per client, all the handshakes run in this thread
+		rpc::ClientConnection *c = new rpc::ClientConnection(rpc::ClientConnection::SyncCalls::Disabled, &app);
+		c->setHost(o_host);
+		c->setPort(o_port);
+		c->setUser(o_user);
+		c->setPassword(o_password);
+		c->setCheckBrokerConnectedInterval(0);
+		QObject::connect(c, &rpc::ClientConnection::brokerConnectedChanged, &app, [&latencies, &elapsed, o_count](bool is_connected) {
+			if(!is_connected)
+				return;
+			latencies.push_back(elapsed.elapsed());
+			if(latencies.size() == static_cast<size_t>(o_count))
+				QCoreApplication::quit();
+		});
+		c->open();
+	}
+	QTimer::singleShot(o_timeout * 1000, &app, &QCoreApplication::quit);
+	app.exec();
+
+	qint64 total_msec = latencies.empty()? elapsed.elapsed(): latencies.back();
+	std::cout << "handshakes: " << latencies.size() << " of " << o_count << " in " << total_msec << " msec" << std::endl;
+	if(!latencies.empty()) {
+		double per_sec = total_msec > 0? 1000. * latencies.size() / total_msec: 0;
+		std::cout << "handshakes/s: " << per_sec << std::endl;
+		std::cout << "first: " << latencies.front() << " msec"
+				  << ", median: " << latencies[latencies.size() / 2] << " msec"
+				  << ", last: " << latencies.back() << " msec" << std::endl;
+	}
+	return latencies.size() == static_cast<size_t>(o_count)? 0: 1;
+}
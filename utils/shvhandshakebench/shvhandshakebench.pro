@@ -0,0 +1,42 @@
+TEMPLATE = app
+
+QT += network
+QT -= gui
+
+CONFIG += C++11
+CONFIG += console
+
+isEmpty(SHV_PROJECT_TOP_BUILDDIR) {
+	SHV_PROJECT_TOP_BUILDDIR=$$shadowed($$PWD)/..
+}
+message ( SHV_PROJECT_TOP_BUILDDIR: '$$SHV_PROJECT_TOP_BUILDDIR' )
+
+DESTDIR = $$SHV_PROJECT_TOP_BUILDDIR/bin
+unix:LIBDIR = $$SHV_PROJECT_TOP_BUILDDIR/lib
+win32:LIBDIR = $$SHV_PROJECT_TOP_BUILDDIR/bin
+
+LIBS += \
+    -L$$LIBDIR \
+    -lnecrolog \
+    -lshvchainpack \
+    -lshvcore \
+    -lshvcoreqt \
+    -lshviotqt \
+
+unix {
+    LIBS += \
+        -Wl,-rpath,\'\$\$ORIGIN/../lib\'
+}
+
+INCLUDEPATH += \
+	../../3rdparty/necrolog/include \
+	../../libshvchainpack/include \
+	../../libshvcore/include \
+	../../libshvcoreqt/include \
+	../../libshviotqt/include \
+
+SOURCES += \
+	main.cpp \
+
+HEADERS += \
+
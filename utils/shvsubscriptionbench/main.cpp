@@ -0,0 +1,148 @@
+#include <necrolog.h>
+
+#include <shv/chainpack/rpc.h>
+#include <shv/iotqt/rpc/subscriptionindex.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cp = shv::chainpack;
+namespace rpc = shv::iotqt::rpc;
+
+static const char *shvsubscriptionbench_help =
+R"( Measures lookup of notification recipients in SubscriptionIndex and compares it
+with scanning of all the subscriptions
+
+USAGE:
+-n count
+	number of subscriptions (default 100000)
+-c count
+	number of connections (default 1000)
+-m count
+	number of notifications looked up (default 100000)
+
+)";
+
+void help(const std::string &app_name)
+{
+	std::cout << app_name << shvsubscriptionbench_help;
+	std::cout << NecroLog::cliHelp();
+	exit(0);
+}
+
+namespace {
+
+struct Subscription
+{
+	unsigned connectionId;
+	std::string path;
+	std::string method;
+};
+
+std::string random_path(std::mt19937 &rng)
+{
+	// shv/site/device/property tree with 100 * 100 * 10 leaves
+	return "shv/site" + std::to_string(rng() % 100)
+			+ "/dev" + std::to_string(rng() % 100)
+			+ "/prop" + std::to_string(rng() % 10);
+}
+
+/// subscription to path matches the path and all the paths below it
+bool is_subscribed(const Subscription &s, const std::string &path, const std::string &method)
+{
+	if(!s.method.empty() && s.method != method)
+		return false;
+	if(path.compare(0, s.path.size(), s.path) != 0)
+		return false;
+	return path.size() == s.path.size() || path[s.path.size()] == '/';
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	std::vector<std::string> args = NecroLog::setCLIOptions(argc, argv);
+
+	if(std::find(args.begin(), args.end(), "--help") != args.end()) {
+		help(argv[0]);
+	}
+
+	int o_subscriptions = 100000;
+	int o_connections = 1000;
+	int o_notifies = 100000;
+
+	for (size_t i = 1; i < args.size(); ++i) {
+		const std::string &arg = args[i];
+		bool has_value = i < args.size() - 1;
+		if(arg == "-n" && has_value)
+			o_subscriptions = std::stoi(args[++i]);
+		else if(arg == "-c" && has_value)
+			o_connections = std::stoi(args[++i]);
+		else if(arg == "-m" && has_value)
+			o_notifies = std::stoi(args[++i]);
+		else if(arg == "-h")
+			help(argv[0]);
+	}
+	if(o_subscriptions <= 0 || o_connections <= 0 || o_notifies <= 0)
+		help(argv[0]);
+
+	std::mt19937 rng(1);
+	std::vector<Subscription> subscriptions;
+	subscriptions.reserve(static_cast<size_t>(o_subscriptions));
+	rpc::SubscriptionIndex index;
+	QElapsedTimer elapsed;
+	elapsed.start();
+	for (int i = 0; i < o_subscriptions; ++i) {
+		Subscription s{static_cast<unsigned>(i % o_connections), random_path(rng), cp::Rpc::NTF_VAL_CHANGED};
+		if(index.subscribe(s.connectionId, s.path, s.method))
+			subscriptions.push_back(std::move(s));
+	}
+	qint64 subscribe_nsec = elapsed.nsecsElapsed();
+	std::cout << "subscriptions: " << index.subscriptionCount()
+			  << ", subscribe: " << subscribe_nsec / 1000. / o_subscriptions << " usec" << std::endl;
+
+	std::vector<std::string> paths;
+	paths.reserve(static_cast<size_t>(o_notifies));
+	for (int i = 0; i < o_notifies; ++i)
+		paths.push_back(random_path(rng) + "/value");
+	const std::string method = cp::Rpc::NTF_VAL_CHANGED;
+
+	size_t index_recipients = 0;
+	elapsed.restart();
+	for(const std::string &path : paths)
+		index_recipients += index.subscribers(path, method).size();
+	qint64 index_nsec = elapsed.nsecsElapsed();
+	std::cout << "index lookup: " << index_nsec / 1000. / o_notifies << " usec per notify"
+			  << ", recipients: " << index_recipients << std::endl;
+
+	// scan is much slower, measure part of notifications only
+	size_t scan_count = std::min(paths.size(), size_t(1000));
+	std::vector<std::vector<unsigned>> scan_recipients(scan_count);
+	elapsed.restart();
+	for (size_t i = 0; i < scan_count; ++i) {
+		std::vector<unsigned> &recipients = scan_recipients[i];
+		for(const Subscription &s : subscriptions) {
+			if(is_subscribed(s, paths[i], method))
+				recipients.push_back(s.connectionId);
+		}
+		std::sort(recipients.begin(), recipients.end());
+		recipients.erase(std::unique(recipients.begin(), recipients.end()), recipients.end());
+	}
+	qint64 scan_nsec = elapsed.nsecsElapsed();
+	std::cout << "scan lookup: " << scan_nsec / 1000. / scan_count << " usec per notify" << std::endl;
+
+	for (size_t i = 0; i < scan_count; ++i) {
+		if(scan_recipients[i] != index.subscribers(paths[i], method)) {
+			nError() << "recipients differ for path:" << paths[i];
+			return 1;
+		}
+	}
+	return 0;
+}
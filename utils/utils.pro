@@ -3,4 +3,6 @@ CONFIG += ordered
 
 SUBDIRS += \
 	cp2cp \
+	shvhandshakebench \
+	shvsubscriptionbench \
 